@@ -118,9 +118,17 @@ const pathtracer_objects = [
 	maek.CPP("src/pathtracer/bvh.cpp"),
 	maek.CPP("src/pathtracer/samplers.cpp"),
 	maek.CPP("src/pathtracer/aperture_shape.cpp"),
+	maek.CPP("src/pathtracer/stats.cpp"),
+	maek.CPP("src/pathtracer/checkpoint.cpp"),
+	maek.CPP("src/pathtracer/denoiser.cpp"),
+	maek.CPP("src/pathtracer/aov.cpp"),
+	maek.CPP("src/pathtracer/session.cpp"),
+	maek.CPP("src/pathtracer/env_map.cpp"),
+	maek.CPP("src/pathtracer/light_grid.cpp"),
 ];
 const util_objects = [
 	maek.CPP("src/util/hdr_image.cpp"),
+	maek.CPP("src/util/packed_image.cpp"),
 	maek.CPP("src/util/viewer.cpp"),
 	maek.CPP("src/util/thread_pool.cpp"),
 	maek.CPP("src/util/rand.cpp"),
@@ -1359,6 +1359,13 @@ void Widget_Render::begin_window(Scene& scene, Undo& undo, Manager& manager, Vie
 
 	if (method == Method::path_trace) {
 		Checkbox("Use BVH", &use_bvh);
+		SameLine();
+		Checkbox("Keep Built Scene", &keep_session);
+		if (IsItemHovered()) {
+			SetTooltip("Reuse the meshes, BVHs, and lights built for the last render.\n"
+			           "Much faster when only the render camera changes, but other scene edits\n"
+			           "won't show up until this is unchecked.");
+		}
 	}
 }
 
@@ -1421,7 +1428,7 @@ void Widget_Render::ui_animate(Scene& scene, Manager& manager, Undo& undo, View_
 				if (method == Method::path_trace) {
 					pathtracer.render(scene, render_cam.lock(), std::move(report_callback), &quit);
 				} else if(method == Method::software_raster) {
-					rasterizer.reset(new Rasterizer(scene, *render_cam.lock(), std::move(report_callback)));
+					rasterizer.reset(new Rasterizer(scene, *render_cam.lock(), std::move(report_callback), raster_threads()));
 				}
 			}
 		}
@@ -1478,15 +1485,21 @@ bool Widget_Render::ui_render(Scene& scene, Manager& manager, Undo& undo, View_3
 				has_rendered = true;
 				rebuild_ray_log = true;
 				pathtracer.use_bvh(use_bvh);
-				pathtracer.render(scene, render_cam.lock(), [this, report_callback](PT::Pathtracer::Render_Report &&report){
+				auto report = [this, report_callback](PT::Pathtracer::Render_Report &&report){
 					report_callback(std::move(report));
 					rebuild_ray_log = true;
-				}, &quit);
+				};
+				std::shared_ptr< PT::Render_Session const > session = pathtracer.current_session();
+				if (keep_session && session && session->use_bvh == use_bvh) {
+					pathtracer.render(session, render_cam.lock(), std::move(report), &quit);
+				} else {
+					pathtracer.render(scene, render_cam.lock(), std::move(report), &quit);
+				}
 
 			} else if (method == Method::software_raster) {
 
 				has_rendered = true;
-				rasterizer.reset(new Rasterizer(scene, *render_cam.lock(), std::move(report_callback)));
+				rasterizer.reset(new Rasterizer(scene, *render_cam.lock(), std::move(report_callback), raster_threads()));
 
 			} else {
 
@@ -1577,12 +1590,18 @@ void Widget_Render::display_output() {
 			if (!pathtracer.in_progress() && has_rendered) {
 				auto [build, render] = pathtracer.completion_time();
 				Text("Scene built in %.2fs, rendered in %.2fs.", build, render);
+				auto plan = pathtracer.tile_plan();
+				Text("Traced %u tiles of %ux%u pixels, %u samples (%u split) on %u threads.",
+				     plan.tiles, plan.tile_width, plan.tile_height, plan.tile_samples, plan.split_tiles, plan.threads);
 			}
 		} else if (method == Method::software_raster) {
 			Image(to_id(display.get_id()), {w, h}, {0.0f, 1.0f}, {1.0f, 0.0f});
 
 			if (rasterizer && !rasterizer->in_progress() && has_rendered) {
 				Text("Scene rendered in %.2fs.", rasterizer->completion_time);
+				Rasterizer::Cull_Stats const& culled = rasterizer->cull_stats;
+				Text("Culled %u of %u instances (%u triangles) outside the view, and %u back-facing triangles.",
+				     culled.culled_instances, culled.instances, culled.culled_triangles, culled.backfacing_triangles);
 			}
 		} else {
 			Image(to_id(Renderer::get().saved()), {w, h}, {0.0f, 1.0f}, {1.0f, 0.0f});
@@ -1696,7 +1715,8 @@ std::string Widget_Render::step_animation(Scene& scene, Animator& animator, Mana
 
 				{
 					std::lock_guard<std::mutex> lock(report_mut);
-					display_hdr.tonemap_to(data, exposure);
+					//(the rasterizer's threads are idle between frames)
+					display_hdr.tonemap_to(data, exposure, raster_threads());
 				}
 				std::stringstream str;
 				str << std::setfill('0') << std::setw(4) << next_frame;
@@ -1714,7 +1734,7 @@ std::string Widget_Render::step_animation(Scene& scene, Animator& animator, Mana
 				}
 
 				render_progress = 0.0f;
-				rasterizer.reset(new Rasterizer(scene, *render_cam.lock(), std::move(report_callback)));
+				rasterizer.reset(new Rasterizer(scene, *render_cam.lock(), std::move(report_callback), raster_threads()));
 				next_frame++;
 			}
 		}
@@ -1726,6 +1746,13 @@ PT::Pathtracer& Widget_Render::tracer() {
 	return pathtracer;
 }
 
+Thread_Pool* Widget_Render::raster_threads() {
+	if (!raster_pool && std::thread::hardware_concurrency() > 1) {
+		raster_pool = std::make_unique< Thread_Pool >(std::thread::hardware_concurrency());
+	}
+	return raster_pool.get();
+}
+
 void Widget_Render::render_log(const Mat4& view) {
 	if (rebuild_ray_log) {
 		rebuild_ray_log = false;
@@ -233,6 +233,7 @@ public:
 private:
 	void begin_window(Scene& scene, Undo& undo, Manager& manager, View_3D& gui_cam);
 	void display_output();
+	Thread_Pool* raster_threads(); //pool shared by every software rasterization (started on first use)
 
 	enum class Method : uint8_t { hardware_raster, software_raster, path_trace, count };
 	static const char* Method_Names[static_cast<uint8_t>(Method::count)];
@@ -242,6 +243,7 @@ private:
 
 	float exposure = 1.0f;
 	bool use_bvh = true;
+	bool keep_session = false; //path trace from the previous render's session (skipping the scene build)
 	bool has_rendered = false, rebuild_ray_log = false;
 	bool render_window = false, render_window_focus = false;
 	bool quit = false;
@@ -261,6 +263,7 @@ private:
 	GL::MSAA msaa;
 
 	PT::Pathtracer pathtracer;
+	std::unique_ptr< Thread_Pool > raster_pool; //(declared before the rasterizer, which uses it)
 	std::unique_ptr< Rasterizer > rasterizer;
 };
 
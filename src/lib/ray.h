@@ -34,6 +34,7 @@ struct Ray {
 		dir = trans.rotate(dir);
 		float d = dir.norm();
 		dist_bounds *= d;
+		cone_width *= d;
 		dir /= d;
 	}
 
@@ -46,6 +47,11 @@ struct Ray {
 
 	/// The minimum and maximum distance at which this ray can encounter collisions
 	Vec2 dist_bounds = Vec2(0.0f, std::numeric_limits<float>::infinity());
+
+	/// Ray cone, for texture filtering: the cone is cone_width across at the origin and
+	/// widens by cone_spread (radians) per unit distance (both zero => no filtering)
+	float cone_width = 0.0f;
+	float cone_spread = 0.0f;
 };
 
 inline std::ostream& operator<<(std::ostream& out, Ray r) {
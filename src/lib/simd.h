@@ -0,0 +1,10 @@
+#pragma once
+
+//SIMD_SSE is 1 when SSE2 intrinsics are available (and <emmintrin.h> is included), 0 otherwise:
+// (code using it keeps a plain scalar path for other platforms)
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD_SSE 1
+#include <emmintrin.h>
+#else
+#define SIMD_SSE 0
+#endif
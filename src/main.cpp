@@ -14,6 +14,8 @@
 #include "test.h"
 
 #include <filesystem>
+#include <fstream>
+#include <unordered_set>
 
 int main(int argc, char** argv) {
 
@@ -30,7 +32,8 @@ int main(int argc, char** argv) {
 
 	std::string output_file = "out.png";
 
-	std::string camera_name;
+	std::string camera_name; //camera instance to render, or comma-separated list of them
+	bool all_cameras = false; //render every camera instance
 	bool animate = false;
 	int32_t min_frame = 0;
 	int32_t max_frame = -1;
@@ -43,9 +46,33 @@ int main(int argc, char** argv) {
 	uint32_t film_samples = -1U; //override film samples (if not -1U)
 	uint32_t film_max_ray_depth = -1U; //override film max ray depth (if not -1U)
 	std::string film_sample_pattern = ""; //override film sample pattern (if not "")
+	std::string crop = ""; //"x,y,w,h" window of the film to render, from the top-left (if not "")
+	bool crop_full = false; //write the full film (with only the crop window filled) rather than just the window
 
 	std::string write_file = ""; //write file (useful for conversions)
 
+	bool print_stats = false; //print path tracer render statistics
+	std::string stats_file = ""; //write path tracer render statistics as JSON (if not "")
+
+	std::string checkpoint_file = ""; //periodically save path tracer progress here (if not "")
+	float checkpoint_interval = 60.0f; //seconds between checkpoints
+	bool resume = false; //continue from checkpoint_file if it exists
+
+	std::string shard = ""; //"i/n" to path trace only shard i of n (if not "")
+	std::vector< std::string > merge_files; //shard files to merge into output_file
+
+	float time_limit = 0.0f; //progressive path tracing: stop after this many seconds per frame (if > 0)
+	float noise_threshold = 0.0f; //progressive path tracing: stop once estimated relative noise is below this (if > 0)
+	bool write_passes = false; //progressive path tracing: write output after every pass
+
+	bool denoise = false; //denoise path traced images
+	uint32_t light_samples = 0; //shadow rays per shading point for delta lights (0 traces every light)
+
+	std::string aovs = ""; //comma-separated AOVs to write (if not "")
+	std::string aov_file = ""; //multi-layer EXR file for AOVs (if "", next to output_file)
+
+	std::string texture_storage = "rows"; //how image textures are stored for sampling
+
 
 	CLI::App args{"Scotty3D - Student Version"};
 
@@ -56,19 +83,37 @@ int main(int argc, char** argv) {
 	args.add_option("--write", write_file, "Re-save file and exit");
 	args.add_flag("--trace", pathtrace, "Path trace scene without opening the GUI");
 	args.add_flag("--rasterize", rasterize, "Rasterize scene without opening the GUI");
-	args.add_option("-c,--camera", camera_name, "Camera instance to render (if headless)");
+	args.add_option("-c,--camera", camera_name, "Camera instance to render (if headless) [several can be path traced at once as a comma-separated list]");
+	args.add_flag("--all-cameras", all_cameras, "Path trace from every camera instance at once (if headless) [outputs are named with the camera name]");
 	args.add_option("-o,--output", output_file, "Image file to write (if headless) [for animation, can also be a directory]");
 	args.add_flag("--animate", animate, "Output animation frames [min_frame,max_frame] (if headless)");
 	args.add_option("--min-frame", min_frame, "First animation frame");
 	args.add_option("--max-frame", max_frame, "Last animation frame (-1 is last keyframe)");
 	args.add_flag("--no_bvh", no_bvh, "Don't use BVH (if headless)");
 	args.add_option("--exposure", exp, "Output exposure (if headless)");
+	args.add_flag("--stats", print_stats, "Print render statistics (if headless path tracing)");
+	args.add_option("--checkpoint", checkpoint_file, "Periodically save path tracing progress to this file (if headless) [numbered like output when animating]");
+	args.add_option("--checkpoint-interval", checkpoint_interval, "Seconds between checkpoints");
+	args.add_flag("--resume", resume, "Continue path tracing from the --checkpoint file, if it exists");
+	args.add_option("--shard", shard, "Path trace only shard i/n of the image and save it as a checkpoint (to --checkpoint, or next to --output); requires --seed");
+	args.add_option("--merge", merge_files, "Merge shard files from --shard into the --output image");
+	args.add_option("--time-limit", time_limit, "Path trace progressively (doubling samples each pass, up to film samples) and stop after this many seconds per frame");
+	args.add_option("--noise-threshold", noise_threshold, "Path trace progressively and stop once estimated relative noise is below this (e.g., 0.02)");
+	args.add_flag("--write-passes", write_passes, "When path tracing progressively, write output after every pass");
+	args.add_flag("--denoise", denoise, "Denoise path traced output (edge-avoiding a-trous filter guided by first-hit albedo/normal/depth)");
+	args.add_option("--light-samples", light_samples, "Path trace delta lights with this many shadow rays per shading point, picking lights at random (for scenes with many lights; 0 traces every light)");
+	args.add_option("--aov", aovs, "Path trace extra channels: comma-separated list of depth, normal, albedo, direct, indirect, samples (or all)");
+	args.add_option("--aov-output", aov_file, "Multi-layer EXR file to write output and --aov channels to (default: --output with .exr extension) [numbered like output when animating]");
+	args.add_option("--stats-json", stats_file, "Write render statistics to a JSON file (if headless path tracing) [numbered like output when animating]");
+	args.add_option("--texture-storage", texture_storage, "Store image textures for sampling as: rows (default), tiled (4x4 tiles), tiled-f16 (tiles of half floats), or tiled-rgb9e5 (tiles of shared-exponent texels)");
 	args.add_option("--seed", RNG::fixed_seed, "Use fixed seed for RNG when rendering; (0 disables).");
 	args.add_option("--film-width",          film_width, "Override camera film width (pixels)");
 	args.add_option("--film-height",         film_height, "Override camera film height (pixels)");
 	args.add_option("--film-samples",        film_samples, "Override film samples-per-pixel (for pathtracer)");
 	args.add_option("--film-max-ray-depth",  film_max_ray_depth, "Override film max ray depth (for pathtracer)");
 	args.add_option("--film-sample-pattern", film_sample_pattern, "Override film sample pattern (for rasterizer)");
+	args.add_option("--crop", crop, "Only render a window of the film: x,y,width,height in pixels from the top-left");
+	args.add_flag("--crop-full", crop_full, "With --crop, write a full-size image with only the crop window filled (default: write just the window)");
 	args.add_option("--force-dpi", Platform::force_dpi, "Force DPI to a given number (will scale UI).");
 
 	CLI11_PARSE(args, argc, argv);
@@ -82,11 +127,194 @@ int main(int argc, char** argv) {
 		}
 	}
 
+	//tonemap and write an image to a png file:
+	auto write_png = [&](std::filesystem::path const &filename, HDR_Image const &image) {
+		std::vector<uint8_t> data;
+		image.tonemap_to(data, exp);
+
+		stbi_flip_vertically_on_write(true);
+		if (!stbi_write_png(filename.generic_string().c_str(), image.w, image.h, 4, data.data(), image.w * 4)) {
+			warn("ERROR: Failed to write output to '%s'", filename.generic_string().c_str());
+			return false;
+		}
+		std::cout << "Wrote result to '" << filename.generic_string() << "'." << std::endl;
+		return true;
+	};
+
+	//write an image and its AOVs to a multi-layer exr file:
+	auto write_exr = [&](std::filesystem::path const &filename, HDR_Image const &image, std::vector< PT::AOV_Layer > &&layers) {
+		PT::AOV_Layer color;
+		color.channels = {"R", "G", "B"};
+		color.w = image.w;
+		color.h = image.h;
+		color.data.reserve(size_t(image.w) * image.h * 3);
+		for (uint32_t i = 0; i < image.w * image.h; ++i) {
+			color.data.insert(color.data.end(), {image.at(i).r, image.at(i).g, image.at(i).b});
+		}
+		layers.insert(layers.begin(), std::move(color));
+		try {
+			PT::save_exr(filename.generic_string(), layers);
+		} catch (std::exception const &e) {
+			warn("ERROR: %s", e.what());
+			return false;
+		}
+		std::cout << "Wrote AOVs to '" << filename.generic_string() << "'." << std::endl;
+		return true;
+	};
+
+	//cut the rendered window out of an image and its AOVs (unless the full film was asked for):
+	auto crop_output = [&](Camera::Film_Rect const &rect, HDR_Image &image, std::vector< PT::AOV_Layer > &layers) {
+		if (crop_full || (rect.x_begin == 0 && rect.y_begin == 0 && rect.x_end == image.w && rect.y_end == image.h)) return;
+		HDR_Image cropped(rect.width(), rect.height());
+		for (uint32_t y = 0; y < cropped.h; ++y) {
+			for (uint32_t x = 0; x < cropped.w; ++x) {
+				cropped.at(x, y) = image.at(rect.x_begin + x, rect.y_begin + y);
+			}
+		}
+		image = std::move(cropped);
+		for (auto &layer : layers) {
+			size_t stride = layer.channels.size();
+			std::vector< float > data;
+			data.reserve(size_t(rect.width()) * rect.height() * stride);
+			for (uint32_t y = rect.y_begin; y < rect.y_end; ++y) {
+				auto row = layer.data.begin() + (size_t(y) * layer.w + rect.x_begin) * stride;
+				data.insert(data.end(), row, row + rect.width() * stride);
+			}
+			layer.data = std::move(data);
+			layer.w = rect.width();
+			layer.h = rect.height();
+		}
+	};
+
+	uint32_t aov_mask = 0;
+	try {
+		aov_mask = PT::AOV::parse(aovs);
+	} catch (std::exception const &e) {
+		warn("ERROR: %s", e.what());
+		return 1;
+	}
+	Textures::Image::Storage image_storage = Textures::Image::Storage::rows;
+	if (texture_storage == "rows") {
+		image_storage = Textures::Image::Storage::rows;
+	} else if (texture_storage == "tiled") {
+		image_storage = Textures::Image::Storage::tiled;
+	} else if (texture_storage == "tiled-f16") {
+		image_storage = Textures::Image::Storage::tiled_f16;
+	} else if (texture_storage == "tiled-rgb9e5") {
+		image_storage = Textures::Image::Storage::tiled_rgb9e5;
+	} else {
+		warn("ERROR: Unknown texture storage '%s' (expecting rows, tiled, tiled-f16, or tiled-rgb9e5)", texture_storage.c_str());
+		return 1;
+	}
+
+	if (aov_file == "") {
+		std::error_code ec;
+		std::filesystem::path filename(output_file);
+		//(animation frames written to a directory get numbered .exr files next to the .png files)
+		if (!std::filesystem::is_directory(filename, ec)) filename.replace_extension(".exr");
+		aov_file = filename.generic_string();
+	}
+
+	//if shard merge requested, do that and return:
+	if (!merge_files.empty()) {
+		PT::Pathtracer::Checkpoint merged;
+		for (auto const &file : merge_files) {
+			try {
+				PT::Pathtracer::Checkpoint checkpoint = PT::Pathtracer::Checkpoint::load(file);
+				if (&file == &merge_files[0]) merged = std::move(checkpoint);
+				else merged.merge(checkpoint);
+			} catch (std::exception const &e) {
+				warn("ERROR: Failed to merge '%s': %s", file.c_str(), e.what());
+				return 1;
+			}
+		}
+		uint32_t done = merged.tiles_done();
+		info("Merged %u files: %u of %u tiles done.", uint32_t(merge_files.size()), done, uint32_t(merged.tiles.size()));
+		if (done != merged.tiles.size()) {
+			warn("Some tiles are missing; those parts of the image will have fewer samples (or be black).");
+		}
+		//(shards of a cropped render only cover the crop window)
+		HDR_Image image = merged.image();
+		std::vector< PT::AOV_Layer > layers = merged.aov_layers();
+		crop_output(merged.bounds(), image, layers);
+		if (!write_png(output_file, image)) return 1;
+		if (merged.aov_mask != 0) {
+			if (!write_exr(aov_file, image, std::move(layers))) return 1;
+		}
+		return 0;
+	}
+
+	uint32_t shard_index = 0, shard_count = 1;
+	if (shard != "") {
+		char slash = '\0';
+		std::istringstream str(shard);
+		if (!(str >> shard_index >> slash >> shard_count) || slash != '/' || !str.eof() || shard_count == 0 || shard_index >= shard_count) {
+			warn("ERROR: --shard expects i/n with 0 <= i < n (got '%s').", shard.c_str());
+			return 1;
+		}
+		if (!pathtrace) {
+			warn("ERROR: --shard only works with --trace.");
+			return 1;
+		}
+		if (RNG::fixed_seed == 0) {
+			warn("ERROR: --shard requires a nonzero --seed (the same for all shards), so the shards agree on tile seeds.");
+			return 1;
+		}
+		if (checkpoint_file == "") {
+			std::filesystem::path filename(output_file);
+			filename.replace_extension(".shard-" + std::to_string(shard_index) + "-of-" + std::to_string(shard_count));
+			checkpoint_file = filename.generic_string();
+		}
+	}
+
+	uint32_t crop_x = 0, crop_y = 0, crop_width = 0, crop_height = 0;
+	if (crop != "") {
+		char comma[3] = {'\0', '\0', '\0'};
+		std::istringstream str(crop);
+		if (!(str >> crop_x >> comma[0] >> crop_y >> comma[1] >> crop_width >> comma[2] >> crop_height) || !str.eof()
+		 || comma[0] != ',' || comma[1] != ',' || comma[2] != ',' || crop_width == 0 || crop_height == 0) {
+			warn("ERROR: --crop expects x,y,width,height with nonzero width and height (got '%s').", crop.c_str());
+			return 1;
+		}
+		if (!(pathtrace || rasterize)) {
+			warn("ERROR: --crop only works with --trace or --rasterize.");
+			return 1;
+		}
+	}
+	if (crop_full && crop == "") {
+		warn("ERROR: --crop-full requires --crop.");
+		return 1;
+	}
+
+	bool progressive = (time_limit > 0.0f || noise_threshold > 0.0f);
+	if (progressive && !pathtrace) {
+		warn("ERROR: --time-limit and --noise-threshold only work with --trace.");
+		return 1;
+	}
+	if (progressive && (checkpoint_file != "" || shard_count > 1)) {
+		warn("ERROR: progressive rendering (--time-limit, --noise-threshold) can't be combined with --checkpoint or --shard.");
+		return 1;
+	}
+	if (aov_mask != 0 && !pathtrace) {
+		warn("ERROR: --aov only works with --trace.");
+		return 1;
+	}
+
+	if (write_passes && !progressive) {
+		warn("ERROR: --write-passes requires --time-limit or --noise-threshold.");
+		return 1;
+	}
+
 	if (animate && !(pathtrace || rasterize)) {
 		warn("ERROR: must specify --trace or --rasterize when doing --animate.");
 		return 1;
 	}
 
+	if (resume && checkpoint_file == "") {
+		warn("ERROR: --resume requires --checkpoint to say which file to resume from.");
+		return 1;
+	}
+
 	if ((min_frame != 0 || max_frame != -1) && !animate) {
 		warn("ERROR: --min-frame and --max-frame should only be used with --animate");
 		return 1;
@@ -121,67 +349,119 @@ int main(int argc, char** argv) {
 			return 0;
 		}
 
-		//find camera:
-		std::weak_ptr< Instance::Camera > camera_instance = scene.get<Instance::Camera>(camera_name);
-		if (!camera_instance.lock()) {
-			std::string all_cameras = "Camera instances in scene:";
+		//store image textures for sampling as asked (--texture-storage):
+		for (auto &[name, texture] : scene.textures) {
+			if (auto image = std::get_if< Textures::Image >(&texture->texture)) image->set_storage(image_storage);
+		}
+
+		//find camera(s):
+		std::vector< std::string > camera_names;
+		if (all_cameras) {
 			for (auto const &[name, camera] : scene.instances.cameras) {
-				all_cameras += "\n    '" + name + "'";
+				camera_names.emplace_back(name);
+			}
+			std::sort(camera_names.begin(), camera_names.end());
+		} else {
+			std::istringstream str(camera_name);
+			std::string name;
+			while (std::getline(str, name, ',')) camera_names.emplace_back(name);
+			if (camera_names.empty()) camera_names.emplace_back("");
+		}
+		std::vector< std::weak_ptr< Instance::Camera > > camera_instances;
+		for (auto const &name : camera_names) {
+			camera_instances.emplace_back(scene.get<Instance::Camera>(name));
+			if (!camera_instances.back().lock()) {
+				std::string all_cameras = "Camera instances in scene:";
+				for (auto const &[name, camera] : scene.instances.cameras) {
+					all_cameras += "\n    '" + name + "'";
+				}
+				warn("ERROR: Failed to find camera: %s", name.c_str());
+				info("%s", all_cameras.c_str());
+				return 1;
+			}
+		}
+		std::weak_ptr< Instance::Camera > camera_instance = camera_instances[0];
+
+		//several cameras are path traced as a batch, sharing one scene build and one thread pool:
+		bool batch = camera_instances.size() > 1;
+		if (batch) {
+			if (!pathtrace) {
+				warn("ERROR: rendering several cameras at once only works with --trace.");
+				return 1;
+			}
+			if (progressive || checkpoint_file != "" || shard_count > 1) {
+				warn("ERROR: rendering several cameras at once can't be combined with progressive rendering, --checkpoint, or --shard.");
+				return 1;
 			}
-			warn("ERROR: Failed to find camera: %s", camera_name.c_str());
-			info("%s", all_cameras.c_str());
-			return 1;
 		}
-		std::shared_ptr< Camera > camera = camera_instance.lock()->camera.lock();
-		assert(camera && "valid scenes always have valid data references in instances");
 
 		//override camera parameters if requested:
-		if (film_width != -1U && film_height != -1U) {
-			camera->film.width = film_width;
-			camera->film.height = film_height;
-			camera->aspect_ratio = camera->film.width / float(camera->film.height);
-			std::cout << "  Set film size to [" << camera->film.width << "x" << camera->film.height << "]." << std::endl;
-		} else if (film_width != -1U) {
-			camera->film.width = film_width;
-			camera->film.height = uint32_t(std::round(camera->film.width / camera->aspect_ratio));
-			std::cout << "  Set film size to [" << camera->film.width << "x" << camera->film.height << "] (height determined from aspect ratio)." << std::endl;
-		} else if (film_height != -1U) {
-			camera->film.height = film_height;
-			camera->film.width = uint32_t(std::round(camera->film.height * camera->aspect_ratio));
-			std::cout << "  Set film size to [" << camera->film.width << "x" << camera->film.height << "] (width determined from aspect ratio)." << std::endl;
-		}
-
-		if (film_samples != -1U) {
-			camera->film.samples = film_samples;
-			std::cout << "  Set film path tracer samples to " << camera->film.samples << "." << std::endl;
-		}
-
-		if (film_max_ray_depth != -1U) {
-			camera->film.max_ray_depth = film_max_ray_depth;
-			std::cout << "  Set film max ray depth to " << camera->film.max_ray_depth << "." << std::endl;
-		}
-
-		if (film_sample_pattern != "") {
-			std::vector< SamplePattern > const &patterns = SamplePattern::all_patterns();
-			bool found = false;
-			for (auto const &p : patterns) {
-				if (p.name == film_sample_pattern) {
-					camera->film.sample_pattern = p.id;
-					std::cout << "  Set film rasterizer sample pattern to '" << p.name << "'." << std::endl;
-					found = true;
-					break;
-				}
+		// (several instances may share camera data, so each camera is only adjusted once)
+		std::unordered_set< Camera * > adjusted;
+		for (auto const &instance : camera_instances) {
+			std::shared_ptr< Camera > camera = instance.lock()->camera.lock();
+			assert(camera && "valid scenes always have valid data references in instances");
+			if (!adjusted.emplace(camera.get()).second) continue;
+
+			if (film_width != -1U && film_height != -1U) {
+				camera->film.width = film_width;
+				camera->film.height = film_height;
+				camera->aspect_ratio = camera->film.width / float(camera->film.height);
+				std::cout << "  Set film size to [" << camera->film.width << "x" << camera->film.height << "]." << std::endl;
+			} else if (film_width != -1U) {
+				camera->film.width = film_width;
+				camera->film.height = uint32_t(std::round(camera->film.width / camera->aspect_ratio));
+				std::cout << "  Set film size to [" << camera->film.width << "x" << camera->film.height << "] (height determined from aspect ratio)." << std::endl;
+			} else if (film_height != -1U) {
+				camera->film.height = film_height;
+				camera->film.width = uint32_t(std::round(camera->film.height * camera->aspect_ratio));
+				std::cout << "  Set film size to [" << camera->film.width << "x" << camera->film.height << "] (width determined from aspect ratio)." << std::endl;
 			}
-			if (!found) {
-				std::string all_patterns = "Available Sample Patterns:";
+
+			if (film_samples != -1U) {
+				camera->film.samples = film_samples;
+				std::cout << "  Set film path tracer samples to " << camera->film.samples << "." << std::endl;
+			}
+
+			if (film_max_ray_depth != -1U) {
+				camera->film.max_ray_depth = film_max_ray_depth;
+				std::cout << "  Set film max ray depth to " << camera->film.max_ray_depth << "." << std::endl;
+			}
+
+			if (film_sample_pattern != "") {
+				std::vector< SamplePattern > const &patterns = SamplePattern::all_patterns();
+				bool found = false;
 				for (auto const &p : patterns) {
-					all_patterns += "\n    '" + p.name + "'";
+					if (p.name == film_sample_pattern) {
+						camera->film.sample_pattern = p.id;
+						std::cout << "  Set film rasterizer sample pattern to '" << p.name << "'." << std::endl;
+						found = true;
+						break;
+					}
+				}
+				if (!found) {
+					std::string all_patterns = "Available Sample Patterns:";
+					for (auto const &p : patterns) {
+						all_patterns += "\n    '" + p.name + "'";
+					}
+					warn("ERROR: Failed to find sample pattern: %s", film_sample_pattern.c_str());
+					info("%s", all_patterns.c_str());
+					return 1;
 				}
-				warn("ERROR: Failed to find sample pattern: %s", film_sample_pattern.c_str());
-				info("%s", all_patterns.c_str());
-				return 1;
+			}
+
+			if (crop != "") {
+				if (crop_x >= camera->film.width || crop_y >= camera->film.height) {
+					warn("ERROR: Crop window (%u,%u) is outside the [%ux%u] film.", crop_x, crop_y, camera->film.width, camera->film.height);
+					return 1;
+				}
+				//(crop is given from the top-left, like in an image viewer, but film pixels count from the bottom-left)
+				camera->crop_from_top_left(crop_x, crop_y, crop_width, crop_height);
+				std::cout << "  Set crop window to [" << camera->film.crop_width << "x" << camera->film.crop_height << "] at ("
+				          << crop_x << "," << crop_y << ")." << std::endl;
 			}
 		}
+		std::shared_ptr< Camera > camera = camera_instance.lock()->camera.lock();
 
 		if (RNG::fixed_seed == 0) {
 			RNG::fixed_seed = (std::random_device())();
@@ -190,7 +470,11 @@ int main(int argc, char** argv) {
 		//----------------------------
 		//animation setup
 
+		//simulation steps (and builds of the next frame) get their own threads, since they run while the previous frame is rendering:
+		std::unique_ptr< Thread_Pool > step_pool;
+
 		if (animate) {
+			step_pool = std::make_unique< Thread_Pool >(std::max(1u, std::thread::hardware_concurrency()));
 			if (max_frame < 0) {
 				max_frame = int32_t(std::ceil(animator.max_key()));
 				info("Set max_frame from max_key to %d", max_frame);
@@ -207,7 +491,7 @@ int main(int argc, char** argv) {
 					Scene::StepOpts opts;
 					opts.reset = (frame == 0);
 					opts.use_bvh = !no_bvh;
-					opts.thread_pool = nullptr; //TODO
+					opts.thread_pool = step_pool.get();
 					scene.step(animator, float(frame), float(frame + 1), 1.0f / animator.frame_rate, opts);
 				}
 			} else {
@@ -229,6 +513,11 @@ int main(int argc, char** argv) {
 		info("Render settings:");
 		info("\twidth: %d", camera->film.width);
 		info("\theight: %d", camera->film.height);
+		if (camera->cropped()) {
+			Camera::Film_Rect rect = camera->crop_rect();
+			info("\tcrop: [%ux%u] at (%u,%u)%s", rect.width(), rect.height(), rect.x_begin, camera->film.height - rect.y_end,
+				crop_full ? ", writing full film" : "");
+		}
 		info("\texposure: %f", exp);
 		info("\tseed: 0x%X", RNG::fixed_seed);
 		if (pathtrace) {
@@ -236,6 +525,14 @@ int main(int argc, char** argv) {
 			info("\tmax depth: %d", camera->film.max_ray_depth);
 			info("\trender threads: %u", std::thread::hardware_concurrency());
 			if (no_bvh) info("\tusing object list instead of BVH");
+			if (denoise) info("\tdenoising output");
+			if (light_samples) info("\tsampling %u shadow rays per delta-lit point", light_samples);
+			if (aov_mask) info("\tAOVs: %s", PT::AOV::to_string(aov_mask).c_str());
+			if (batch) {
+				std::string names;
+				for (auto const &name : camera_names) names += (names == "" ? "" : ", ") + name;
+				info("\tcameras: %s", names.c_str());
+			}
 			info("\tpathtracing...");
 		} else { assert(rasterize);
 			std::string name;
@@ -247,10 +544,154 @@ int main(int argc, char** argv) {
 			info("\tsample pattern: '%s' (%d)", name.c_str(), camera->film.sample_pattern);
 			info("\trasterizing...");
 		}
+		//add frame number to a filename (if animating):
+		auto frame_filename = [&](std::string const &file, int32_t frame, std::string const &default_ext) {
+			std::filesystem::path filename(file);
+			if (animate) {
+				std::stringstream str;
+				str << std::setfill('0') << std::setw(4) << frame;
+
+				std::error_code ec;
+				if (std::filesystem::is_directory(filename, ec) ) {
+					//numbered files within the directory:
+					filename = filename / (str.str() + default_ext);
+				} else {
+					//number goes after the stem:
+					std::filesystem::path ext = filename.extension();
+					filename.replace_extension("");
+					filename += str.str();
+					filename += ext;
+				}
+			}
+			return filename;
+		};
+
+		//add camera name to a filename (if rendering several cameras):
+		auto camera_filename = [&](std::string const &file, std::string const &view, std::string const &default_ext) {
+			if (!batch) return file;
+			std::filesystem::path filename(file);
+			std::error_code ec;
+			if (std::filesystem::is_directory(filename, ec)) {
+				//named files within the directory:
+				filename = filename / (view + default_ext);
+			} else {
+				//name goes after the stem:
+				std::filesystem::path ext = filename.extension();
+				filename.replace_extension("");
+				filename += "-" + view;
+				filename += ext;
+			}
+			return filename.generic_string();
+		};
+
+		//report on a finished path trace (denoising time, statistics):
+		auto pathtrace_done = [&](PT::Pathtracer &pathtracer, std::string const &view, HDR_Image const &image, int32_t frame) {
+			if (batch) info("\tcamera '%s':", view.c_str());
+			if (denoise) {
+				float ms = 1000.0f * pathtracer.denoise_time();
+				float megapixels = image.w * image.h / 1e6f;
+				info("\tdenoised in %.1fms (%.1fms per megapixel)", ms, ms / megapixels);
+			}
+
+			if (print_stats || stats_file != "") {
+				PT::Render_Stats stats = pathtracer.stats();
+				if (print_stats) {
+					std::cout << stats.to_string();
+				}
+				if (stats_file != "") {
+					std::filesystem::path filename = frame_filename(camera_filename(stats_file, view, ".json"), frame, ".json");
+					std::ofstream out(filename, std::ios::binary);
+					out << stats.to_json();
+					if (!out) {
+						warn("ERROR: Failed to write statistics to '%s'", filename.generic_string().c_str());
+						return false;
+					}
+					std::cout << "Wrote statistics to '" << filename.generic_string() << "'." << std::endl;
+				}
+			}
+			return true;
+		};
+
+		//several cameras: one pathtracer per camera, all tracing on one pool (one thread per core in total):
+		struct Batch_View {
+			std::string name;
+			std::shared_ptr< Instance::Camera > instance;
+			bool quit = false; //(declared before the pathtracer, which keeps a pointer to it)
+			std::unique_ptr< PT::Pathtracer > pathtracer;
+			std::mutex report_mut;
+			float percent_done = 0.0f;
+			HDR_Image display_hdr;
+		};
+		std::unique_ptr< Thread_Pool > batch_pool;
+		std::vector< std::unique_ptr< Batch_View > > views;
+		if (batch) {
+			batch_pool = std::make_unique< Thread_Pool >(std::thread::hardware_concurrency());
+			for (uint32_t i = 0; i < camera_instances.size(); ++i) {
+				Batch_View &view = *views.emplace_back(std::make_unique< Batch_View >());
+				view.name = camera_names[i];
+				view.instance = camera_instances[i].lock();
+				view.pathtracer = std::make_unique< PT::Pathtracer >(*batch_pool);
+				view.pathtracer->use_bvh(!no_bvh);
+				view.pathtracer->use_denoiser(denoise);
+				view.pathtracer->sample_delta_lights(light_samples);
+				view.pathtracer->use_aovs(aov_mask);
+			}
+		}
+
+		//frames are pipelined:
+		// both renderers copy the scene when they start, so the scene is stepped to the next frame while
+		// the current frame renders, and each frame's output is written while the next frame renders.
+		// when pathtracing, the next frame's scene is also built (on the step pool) while the current frame renders.
+		// (one pathtracer -- and its threads -- is reused for all frames)
+		bool quit = false; //(declared before the pathtracer, which keeps a pointer to it)
+		std::unique_ptr< PT::Pathtracer > pathtracer;
+		if (pathtrace) {
+			pathtracer = std::make_unique< PT::Pathtracer >();
+			pathtracer->use_bvh(!no_bvh);
+			pathtracer->set_shard(shard_index, shard_count);
+			pathtracer->use_denoiser(denoise);
+			pathtracer->sample_delta_lights(light_samples);
+			pathtracer->use_aovs(aov_mask);
+		}
+		//(...and one pool of rasterizer threads)
+		std::unique_ptr< Thread_Pool > raster_pool;
+		if (rasterize && std::thread::hardware_concurrency() > 1) {
+			raster_pool = std::make_unique< Thread_Pool >(std::thread::hardware_concurrency());
+		}
+		std::future< bool > writing; //output of the previous frame, being written
+		std::future< std::shared_ptr< PT::Render_Session const > > next_session; //scene for the next frame, being built
+		Timer animation_timer;
+
 		for (int32_t frame = min_frame; frame <= max_frame; ++frame) {
 			//do the render:
 			info(" frame %d", frame);
 
+			//advance the scene to the next frame (if animating):
+			bool advanced = false;
+			auto advance = [&]() {
+				if (advanced || !animate || frame == max_frame) return;
+				info("Advancing %d -> %d", frame, frame + 1);
+				Scene::StepOpts opts;
+				opts.use_bvh = !no_bvh;
+				opts.thread_pool = step_pool.get();
+				scene.step(animator, float(frame), float(frame + 1), 1.0f / animator.frame_rate, opts);
+				advanced = true;
+				if (pathtrace) {
+					//(the scene isn't touched again until the next frame, which waits for this build)
+					next_session = std::async(std::launch::async, [&]() {
+						return std::make_shared< PT::Render_Session const >(scene, !no_bvh, step_pool.get());
+					});
+				}
+			};
+			//scene for this frame, built while the previous frame rendered (if there was one):
+			auto prebuilt_session = [&]() -> std::shared_ptr< PT::Render_Session const > {
+				if (!next_session.valid()) return nullptr;
+				Timer wait_timer;
+				auto session = next_session.get();
+				info("\tbuilt scene in %.2fs during the previous frame (waited %.2fs for it)", session->build_time, wait_timer.s());
+				return session;
+			};
+
 			auto print_progress = [](float f) {
 				std::cout << "Progress: [";
 
@@ -273,6 +714,7 @@ int main(int argc, char** argv) {
 			std::mutex report_mut;
 			float percent_done = 0.0f;
 			HDR_Image display_hdr;
+			std::vector< PT::AOV_Layer > aov_layers;
 
 			auto report_callback = [&](auto&& report) {
 				std::lock_guard<std::mutex> lock(report_mut);
@@ -282,77 +724,230 @@ int main(int argc, char** argv) {
 				}
 			};
 
-			if (pathtrace) {
-				bool quit = false;
-				PT::Pathtracer pathtracer;
-
-				pathtracer.use_bvh(!no_bvh);
-				pathtracer.render(scene, camera_instance.lock(), std::move(report_callback), &quit);
+			if (pathtrace && batch) {
+				//build the scene once, then trace all cameras with their tiles interleaved:
+				auto session = prebuilt_session();
+				if (!session) {
+					Timer build_timer;
+					session = std::make_shared< PT::Render_Session const >(scene, !no_bvh, batch_pool.get());
+					info("\tbuilt scene in %.2fs", build_timer.s());
+				}
 
-				while (pathtracer.in_progress()) {
-					print_progress(percent_done);
-					std::this_thread::sleep_for(std::chrono::milliseconds(250));
+				std::vector< PT::Pathtracer::Batch_Item > items;
+				for (auto &view : views) {
+					view->quit = false;
+					view->percent_done = 0.0f;
+					items.emplace_back(PT::Pathtracer::Batch_Item{view->pathtracer.get(), view->instance,
+						[v = view.get()](PT::Pathtracer::Render_Report &&report) {
+							std::lock_guard<std::mutex> lock(v->report_mut);
+							if (report.first > v->percent_done) {
+								v->percent_done = report.first;
+								v->display_hdr = std::move(report.second);
+							}
+						}, &view->quit});
 				}
-				std::cout << std::endl;
+				PT::Pathtracer::render_batch(session, std::move(items));
 
-			} else { assert(rasterize);
+				//(the session has copied the scene, so it's safe to step it now)
+				advance();
 
-				Rasterizer rasterizer(scene, *camera_instance.lock(), std::move(report_callback));
-				while (rasterizer.in_progress()) {
-					print_progress(percent_done);
+				auto in_progress = [&]() {
+					for (auto &view : views) {
+						if (view->pathtracer->in_progress()) return true;
+					}
+					return false;
+				};
+				while (in_progress()) {
+					float sum = 0.0f;
+					for (auto &view : views) {
+						std::lock_guard<std::mutex> lock(view->report_mut);
+						sum += view->percent_done;
+					}
+					print_progress(sum / views.size());
 					std::this_thread::sleep_for(std::chrono::milliseconds(250));
 				}
 				std::cout << std::endl;
-			}
-			info("\tdone.");
 
-			//write frame:
-			if (output_file == "") {
-				std::cout << "No output was requested, not writing any file." << std::endl;
-			} else {
+				std::vector< std::tuple< std::string, HDR_Image, std::vector< PT::AOV_Layer > > > outputs;
+				for (auto &view : views) {
+					if (!pathtrace_done(*view->pathtracer, view->name, view->display_hdr, frame)) return 1;
+					auto &[name, image, layers] = outputs.emplace_back(view->name, std::move(view->display_hdr), view->pathtracer->aov_layers());
+					crop_output(view->instance->camera.lock()->crop_rect(), image, layers);
+				}
+				info("\tdone.");
+
+				//write frames (in the background, while the next frame renders):
+				if (writing.valid() && !writing.get()) return 1;
+				if (output_file == "") {
+					std::cout << "No output was requested, not writing any file." << std::endl;
+				} else {
+					writing = std::async(std::launch::async, [&, frame, outputs = std::move(outputs)]() mutable {
+						for (auto &[name, image, layers] : outputs) {
+							if (!write_png(frame_filename(camera_filename(output_file, name, ".png"), frame, ".png"), image)) return false;
+							if (aov_mask != 0 && !write_exr(frame_filename(camera_filename(aov_file, name, ".exr"), frame, ".exr"), image, std::move(layers))) return false;
+						}
+						return true;
+					});
+				}
 
-				std::filesystem::path filename(output_file);
+				advance();
+				continue;
+			}
 
-				if (animate) {
-					std::stringstream str;
-					str << std::setfill('0') << std::setw(4) << frame;
+			if (pathtrace) {
+				quit = false;
 
+				if (checkpoint_file != "") {
+					std::filesystem::path filename = frame_filename(checkpoint_file, frame, ".checkpoint");
 					std::error_code ec;
-					if (std::filesystem::is_directory(filename, ec) ) {
-						//numbered files within the directory:
-						filename = filename / (str.str() + ".png");
+					if (resume && std::filesystem::exists(filename, ec)) {
+						PT::Pathtracer::Checkpoint checkpoint;
+						try {
+							checkpoint = PT::Pathtracer::Checkpoint::load(filename.generic_string());
+						} catch (std::exception const &e) {
+							warn("ERROR: Failed to load checkpoint '%s': %s", filename.generic_string().c_str(), e.what());
+							return 1;
+						}
+						if (checkpoint.width != camera->film.width || checkpoint.height != camera->film.height
+						 || checkpoint.samples != camera->film.samples || checkpoint.max_ray_depth != camera->film.max_ray_depth) {
+							warn("ERROR: Checkpoint '%s' is for a [%ux%u] film with %u samples and max depth %u, which doesn't match this render.",
+								filename.generic_string().c_str(), checkpoint.width, checkpoint.height, checkpoint.samples, checkpoint.max_ray_depth);
+							return 1;
+						}
+						if (checkpoint.bounds() != camera->crop_rect()) {
+							warn("ERROR: Checkpoint '%s' is for a different crop window than this render.", filename.generic_string().c_str());
+							return 1;
+						}
+						info("\tresuming from '%s' (%u of %u tiles done)", filename.generic_string().c_str(),
+							checkpoint.tiles_done(), uint32_t(checkpoint.tiles.size()));
+						pathtracer->resume(std::move(checkpoint));
+					}
+					pathtracer->checkpoint_to(filename.generic_string(), checkpoint_interval);
+				}
+
+				if (!progressive) {
+					if (auto session = prebuilt_session()) {
+						pathtracer->render(session, camera_instance.lock(), std::move(report_callback), &quit);
 					} else {
-						//number goes after the stem:
-						std::filesystem::path ext = filename.extension();
-						filename.replace_extension("");
-						filename += str.str();
-						filename += ext;
+						pathtracer->render(scene, camera_instance.lock(), std::move(report_callback), &quit);
+					}
+					if (frame == min_frame) {
+						PT::Pathtracer::Tile_Plan plan = pathtracer->tile_plan();
+						info("\ttiles: %u (%ux%u pixels, %u samples; %u split in tail) for %u threads",
+							plan.tiles, plan.tile_width, plan.tile_height, plan.tile_samples, plan.split_tiles, plan.threads);
+					}
+
+					//(render has copied the scene, so it's safe to step it now)
+					advance();
+
+					while (pathtracer->in_progress()) {
+						print_progress(percent_done);
+						std::this_thread::sleep_for(std::chrono::milliseconds(250));
+					}
+					std::cout << std::endl;
+				} else {
+					//render in passes, each doubling the samples so far, using add_samples to keep accumulating:
+					uint32_t max_samples = camera->film.samples;
+					PT::Pass_Schedule schedule(max_samples, noise_threshold);
+					Timer frame_timer;
+					auto session = prebuilt_session();
+					for (uint32_t pass = 0; !schedule.done(); ++pass) {
+						camera->film.samples = schedule.next_pass();
+						{
+							std::lock_guard<std::mutex> lock(report_mut);
+							percent_done = 0.0f;
+						}
+						//NOTE: passes re-read the camera from the scene, so the scene isn't advanced until they're done
+						if (pass == 0 && session) {
+							pathtracer->render(session, camera_instance.lock(), report_callback, &quit);
+						} else {
+							pathtracer->render(scene, camera_instance.lock(), report_callback, &quit, pass > 0);
+						}
+
+						//stop mid-pass when out of time (samples from unfinished tiles are dropped):
+						bool out_of_time = false;
+						while (pathtracer->in_progress()) {
+							print_progress(percent_done);
+							float remaining = time_limit - frame_timer.s();
+							if (time_limit > 0.0f && remaining <= 0.0f && !out_of_time) {
+								quit = true;
+								out_of_time = true;
+							}
+							int32_t wait = 250;
+							if (time_limit > 0.0f) wait = std::clamp(int32_t(remaining * 1000.0f), 5, 250);
+							std::this_thread::sleep_for(std::chrono::milliseconds(wait));
+						}
+						std::cout << std::endl;
+
+						if (out_of_time) {
+							info("\tpass %u: stopped by time limit after %.2fs (%u full samples)", pass, frame_timer.s(), schedule.samples);
+							break;
+						}
+						schedule.finish_pass(display_hdr);
+
+						info("\tpass %u: %u samples, %.2fs, noise %.4f", pass, schedule.samples, frame_timer.s(), schedule.noise);
+
+						if (write_passes && !schedule.done() && output_file != "") {
+							HDR_Image pass_image = display_hdr.copy();
+							std::vector< PT::AOV_Layer > no_layers;
+							crop_output(camera->crop_rect(), pass_image, no_layers);
+							if (!write_png(frame_filename(output_file, frame, ".png"), pass_image)) return 1;
+						}
+						if (schedule.converged()) {
+							info("\tnoise below threshold %.4f.", noise_threshold);
+						}
 					}
+					camera->film.samples = max_samples;
 				}
 
-				uint32_t data_w, data_h;
-				std::vector<uint8_t> data;
-				display_hdr.tonemap_to(data, exp);
-				data_w = display_hdr.w;
-				data_h = display_hdr.h;
+				aov_layers = pathtracer->aov_layers();
+				if (!pathtrace_done(*pathtracer, camera_names[0], display_hdr, frame)) return 1;
 
-				stbi_flip_vertically_on_write(true);
-				if (!stbi_write_png(filename.generic_string().c_str(), data_w, data_h, 4, data.data(), data_w * 4)) {
-					warn("ERROR: Failed to write output to '%s'", filename.generic_string().c_str());
-					return 1;
+			} else { assert(rasterize);
+
+				Rasterizer rasterizer(scene, *camera_instance.lock(), std::move(report_callback), raster_pool.get());
+
+				//(rasterizer has copied the scene, so it's safe to step it now)
+				advance();
+
+				while (rasterizer.in_progress()) {
+					print_progress(percent_done);
+					std::this_thread::sleep_for(std::chrono::milliseconds(250));
 				}
-				std::cout << "Wrote result to '" << filename.generic_string() << "'." << std::endl;
+				std::cout << std::endl;
+				Rasterizer::Cull_Stats const& culled = rasterizer.cull_stats;
+				info("\tculled %u of %u instances (%u triangles) outside the view, and %u back-facing triangles.",
+				     culled.culled_instances, culled.instances, culled.culled_triangles, culled.backfacing_triangles);
 			}
+			info("\tdone.");
 
-			//advance (if animating):
-			if (animate && frame != max_frame) {
-				info("Advancing %d -> %d", frame, frame + 1);
-				Scene::StepOpts opts;
-				opts.use_bvh = !no_bvh;
-				opts.thread_pool = nullptr; //TODO
-				scene.step(animator, float(frame), float(frame + 1), 1.0f / animator.frame_rate, opts);
+			//write frame (in the background, while the next frame renders):
+			if (writing.valid() && !writing.get()) return 1;
+			if (shard_count > 1) {
+				std::cout << "Wrote shard " << shard_index << "/" << shard_count << " to '"
+				          << frame_filename(checkpoint_file, frame, ".checkpoint").generic_string() << "' (combine shards with --merge)." << std::endl;
+			} else if (output_file == "") {
+				std::cout << "No output was requested, not writing any file." << std::endl;
+			} else {
+				writing = std::async(std::launch::async,
+					[&, png = frame_filename(output_file, frame, ".png"), exr = frame_filename(aov_file, frame, ".exr"),
+					 image = std::move(display_hdr), layers = std::move(aov_layers), rect = camera->crop_rect()]() mutable {
+						crop_output(rect, image, layers);
+						if (!write_png(png, image)) return false;
+						if (aov_mask != 0 && !write_exr(exr, image, std::move(layers))) return false;
+						return true;
+					});
 			}
 
+			//advance (if not already done while rendering):
+			advance();
+		}
+		if (writing.valid() && !writing.get()) return 1;
+
+		if (animate) {
+			float seconds = animation_timer.s();
+			uint32_t frames = uint32_t(max_frame - min_frame + 1);
+			info("Rendered %u frames in %.2fs (%.1f frames/hour).", frames, seconds, frames * 3600.0f / seconds);
 		}
 
 		return 0;
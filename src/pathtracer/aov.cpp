@@ -0,0 +1,163 @@
+
+#include "aov.h"
+
+#include <sf_libs/tinyexr.h>
+
+#include <algorithm>
+#include <cstring>
+#include <sstream>
+#include <stdexcept>
+
+namespace PT {
+
+namespace AOV {
+
+static std::pair< char const *, Channel > const names[] = {
+	{"depth", Depth}, {"normal", Normal}, {"albedo", Albedo},
+	{"direct", Direct}, {"indirect", Indirect}, {"samples", Samples},
+};
+
+uint32_t parse(std::string const &list) {
+	uint32_t mask = 0;
+	std::istringstream str(list);
+	std::string name;
+	while (std::getline(str, name, ',')) {
+		if (name == "") continue;
+		if (name == "all") {
+			mask |= All;
+			continue;
+		}
+		auto found = std::find_if(std::begin(names), std::end(names), [&](auto const &n) { return name == n.first; });
+		if (found == std::end(names)) {
+			throw std::runtime_error("Unknown AOV '" + name + "' (expected depth, normal, albedo, direct, indirect, samples, or all).");
+		}
+		mask |= found->second;
+	}
+	return mask;
+}
+
+std::string to_string(uint32_t mask) {
+	std::string ret;
+	for (auto const &[name, channel] : names) {
+		if (!(mask & channel)) continue;
+		if (ret != "") ret += ",";
+		ret += name;
+	}
+	return ret;
+}
+
+} // namespace AOV
+
+AOV_Layout::AOV_Layout(uint32_t mask_) : mask(mask_ & AOV::All & ~AOV::Samples) {
+	auto place = [&](AOV::Channel channel, uint32_t &offset, uint32_t size) {
+		if (!(mask & channel)) return;
+		offset = stride;
+		stride += size;
+	};
+	place(AOV::Depth, depth, 1);
+	place(AOV::Normal, normal, 3);
+	place(AOV::Albedo, albedo, 3);
+	place(AOV::Direct, direct, 3);
+	place(AOV::Indirect, indirect, 3);
+}
+
+void AOV_Layout::add(float *sums, Sample_AOVs const &sample, float pdf) const {
+	if (mask & AOV::Depth) {
+		sums[depth] += sample.depth;
+	}
+	if (mask & AOV::Normal) {
+		sums[normal + 0] += sample.normal.x;
+		sums[normal + 1] += sample.normal.y;
+		sums[normal + 2] += sample.normal.z;
+	}
+	if (mask & AOV::Albedo) {
+		sums[albedo + 0] += sample.albedo.r;
+		sums[albedo + 1] += sample.albedo.g;
+		sums[albedo + 2] += sample.albedo.b;
+	}
+	//(light is skipped when invalid, same as the radiance sample)
+	if (mask & AOV::Direct) {
+		Spectrum d = sample.direct / pdf;
+		if (d.valid()) {
+			sums[direct + 0] += d.r;
+			sums[direct + 1] += d.g;
+			sums[direct + 2] += d.b;
+		}
+	}
+	if (mask & AOV::Indirect) {
+		Spectrum i = sample.indirect / pdf;
+		if (i.valid()) {
+			sums[indirect + 0] += i.r;
+			sums[indirect + 1] += i.g;
+			sums[indirect + 2] += i.b;
+		}
+	}
+}
+
+void save_exr(std::string const &filename, std::vector< AOV_Layer > const &layers) {
+	if (layers.empty()) throw std::runtime_error("No layers to write to '" + filename + "'.");
+	uint32_t w = layers[0].w, h = layers[0].h;
+
+	//EXR readers expect channels sorted by full name ("layer.channel"):
+	struct Channel_Source {
+		std::string name;
+		AOV_Layer const *layer;
+		uint32_t channel;
+	};
+	std::vector< Channel_Source > sources;
+	for (auto const &layer : layers) {
+		if (layer.w != w || layer.h != h || layer.data.size() != size_t(w) * h * layer.channels.size()) {
+			throw std::runtime_error("Layer '" + layer.name + "' doesn't match the size of the image.");
+		}
+		for (uint32_t c = 0; c < layer.channels.size(); ++c) {
+			std::string name = layer.name == "" ? layer.channels[c] : layer.name + "." + layer.channels[c];
+			sources.emplace_back(Channel_Source{name, &layer, c});
+		}
+	}
+	std::sort(sources.begin(), sources.end(), [](auto const &a, auto const &b) { return a.name < b.name; });
+
+	//de-interleave channels (and flip vertically, since EXR is top-left origin):
+	std::vector< std::vector< float > > planes(sources.size(), std::vector< float >(size_t(w) * h));
+	for (uint32_t s = 0; s < sources.size(); ++s) {
+		AOV_Layer const &layer = *sources[s].layer;
+		uint32_t stride = uint32_t(layer.channels.size());
+		for (uint32_t y = 0; y < h; ++y) {
+			for (uint32_t x = 0; x < w; ++x) {
+				planes[s][size_t(h - 1 - y) * w + x] = layer.data[(size_t(y) * w + x) * stride + sources[s].channel];
+			}
+		}
+	}
+
+	std::vector< EXRChannelInfo > channels(sources.size());
+	std::vector< int > pixel_types(sources.size(), TINYEXR_PIXELTYPE_FLOAT);
+	std::vector< unsigned char * > images(sources.size());
+	for (uint32_t s = 0; s < sources.size(); ++s) {
+		std::memset(&channels[s], 0, sizeof(channels[s]));
+		std::strncpy(channels[s].name, sources[s].name.c_str(), sizeof(channels[s].name) - 1);
+		images[s] = reinterpret_cast< unsigned char * >(planes[s].data());
+	}
+
+	EXRHeader header;
+	InitEXRHeader(&header);
+	header.num_channels = int(sources.size());
+	header.channels = channels.data();
+	header.pixel_types = pixel_types.data();
+	header.requested_pixel_types = pixel_types.data();
+	header.compression_type = TINYEXR_COMPRESSIONTYPE_ZIP;
+
+	EXRImage image;
+	InitEXRImage(&image);
+	image.num_channels = int(sources.size());
+	image.width = int(w);
+	image.height = int(h);
+	image.images = images.data();
+
+	const char *err = nullptr;
+	if (SaveEXRImageToFile(&image, &header, filename.c_str(), &err) != TINYEXR_SUCCESS) {
+		std::string err_s = err ? err : "Unknown failure.";
+		if (err) FreeEXRErrorMessage(err);
+		throw std::runtime_error("Failed to write EXR to " + filename + ": " + err_s);
+	}
+}
+
+} // namespace PT
@@ -0,0 +1,68 @@
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "../lib/spectrum.h"
+#include "../lib/vec3.h"
+
+namespace PT {
+
+//arbitrary output variables (AOVs): extra per-pixel channels accumulated alongside radiance
+namespace AOV {
+
+enum Channel : uint32_t {
+	Depth    = 0x01, //distance along the camera ray to the first hit
+	Normal   = 0x02, //world-space normal at the first hit
+	Albedo   = 0x04, //display color of the first hit's material
+	Direct   = 0x08, //emitted + directly reflected light at the first hit (or environment, for misses)
+	Indirect = 0x10, //light reflected at the first hit after more than one bounce
+	Samples  = 0x20, //samples per pixel (comes from the radiance accumulator, so costs nothing to record)
+
+	All      = 0x3f,
+	Guides   = Depth | Normal | Albedo, //what the denoiser needs
+};
+
+//parse a comma-separated list of channel names (e.g., "depth,normal" or "all"); throws on unknown names:
+uint32_t parse(std::string const &list);
+//comma-separated names of the channels in mask:
+std::string to_string(uint32_t mask);
+
+} // namespace AOV
+
+//values recorded for a single camera ray:
+struct Sample_AOVs {
+	Spectrum albedo;
+	Vec3 normal;
+	float depth = 0.0f;
+	Spectrum direct, indirect;
+};
+
+//where each accumulated channel lives within a pixel's accumulator entry:
+// (only the channels in mask take up space, so disabled channels cost neither memory nor time)
+struct AOV_Layout {
+	AOV_Layout() = default;
+	explicit AOV_Layout(uint32_t mask);
+
+	uint32_t mask = 0; //channels that are accumulated (never includes AOV::Samples)
+	uint32_t stride = 0; //values per pixel
+	uint32_t depth = 0, normal = 0, albedo = 0, direct = 0, indirect = 0; //offsets of channels in mask
+
+	//add a sample's values to a pixel's sums (direct and indirect light are divided by pdf):
+	void add(float *sums, Sample_AOVs const &sample, float pdf) const;
+};
+
+//a named group of channels, ready to write:
+struct AOV_Layer {
+	std::string name; //layer name (e.g., "N"); "" for the main (beauty) layer
+	std::vector< std::string > channels; //e.g., {"R", "G", "B"}
+	uint32_t w = 0, h = 0;
+	std::vector< float > data; //row-major from the bottom-left, channels interleaved
+};
+
+//write layers (all the same size) to a multi-layer OpenEXR file; throws on error:
+void save_exr(std::string const &filename, std::vector< AOV_Layer > const &layers);
+
+} // namespace PT
@@ -2,6 +2,7 @@
 #include "bvh.h"
 #include "aggregate.h"
 #include "instance.h"
+#include "stats.h"
 #include "tri_mesh.h"
 
 #include <stack>
@@ -46,7 +47,10 @@ template<typename Primitive> Trace BVH<Primitive>::hit(const Ray& ray) const {
     // The starter code simply iterates through all the primitives.
     // Again, remember you can use hit() on any Primitive value.
 
+	//NOTE: call Stats::visit_node() for each node your traversal visits (for render statistics)
+
 	//TODO: replace this code with a more efficient traversal:
+    Stats::visit_node();
     Trace ret;
     for(const Primitive& prim : primitives) {
         Trace hit = prim.hit(ray);
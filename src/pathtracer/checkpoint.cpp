@@ -0,0 +1,273 @@
+
+#include "pathtracer.h"
+
+#include <algorithm>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <stdexcept>
+
+namespace PT {
+
+//checkpoint files start with this magic number, then (every field little-endian, whatever the machine):
+// width, height, samples, max_ray_depth, tile count (uint32 each), Tile_Plan (six uint32),
+// tiles (eight uint32 each), done bytes, accumulator (three int64 per pixel), accumulator_samples (uint32)
+// and then, only if AOVs were recorded: aov_mask (uint32), aov_accumulator (int64), aov_samples (uint32)
+static char const Checkpoint_format[4] = {'s','3','c','k'};
+
+namespace {
+//encodes fields as little-endian bytes, and writes them out in large blocks:
+struct Checkpoint_Writer {
+	std::ofstream &out;
+	std::vector< unsigned char > buffer;
+	void u8(uint8_t v) {
+		buffer.emplace_back(v);
+		if (buffer.size() >= (1 << 16)) flush();
+	}
+	void u32(uint32_t v) {
+		for (uint32_t b = 0; b < 32; b += 8) u8(uint8_t(v >> b));
+	}
+	void u64(uint64_t v) {
+		for (uint32_t b = 0; b < 64; b += 8) u8(uint8_t(v >> b));
+	}
+	void flush() {
+		out.write(reinterpret_cast< char const * >(buffer.data()), buffer.size());
+		buffer.clear();
+	}
+};
+
+//reads and decodes little-endian fields, throwing if the file runs out:
+struct Checkpoint_Reader {
+	std::ifstream &in;
+	std::string const &filename;
+	uint64_t remaining = 0; //bytes left in the file
+	std::vector< unsigned char > buffer;
+	size_t at = 0;
+	uint8_t u8() {
+		if (at == buffer.size()) {
+			if (remaining == 0) throw std::runtime_error("Checkpoint '" + filename + "' is truncated.");
+			buffer.resize(size_t(std::min< uint64_t >(remaining, 1 << 16)));
+			if (!in.read(reinterpret_cast< char * >(buffer.data()), buffer.size())) {
+				throw std::runtime_error("Checkpoint '" + filename + "' is truncated.");
+			}
+			remaining -= buffer.size();
+			at = 0;
+		}
+		return buffer[at++];
+	}
+	uint32_t u32() {
+		uint32_t v = 0;
+		for (uint32_t b = 0; b < 32; b += 8) v |= uint32_t(u8()) << b;
+		return v;
+	}
+	uint64_t u64() {
+		uint64_t v = 0;
+		for (uint32_t b = 0; b < 64; b += 8) v |= uint64_t(u8()) << b;
+		return v;
+	}
+	uint64_t left() const {
+		return remaining + (buffer.size() - at);
+	}
+	//throw unless count fields of the given size are left (checked before making room for them):
+	void expect(uint64_t count, uint64_t bytes) {
+		if (count > left() / bytes) throw std::runtime_error("Checkpoint '" + filename + "' is truncated.");
+	}
+};
+} // namespace
+
+uint32_t Pathtracer::Checkpoint::tiles_done() const {
+	uint32_t count = 0;
+	for (uint8_t d : done) count += (d != 0);
+	return count;
+}
+
+Camera::Film_Rect Pathtracer::Checkpoint::bounds() const {
+	if (tiles.empty()) return Camera::Film_Rect{0, width, 0, height};
+	Camera::Film_Rect rect{width, 0, height, 0};
+	for (Tile const &t : tiles) {
+		rect.x_begin = std::min(rect.x_begin, t.x_begin);
+		rect.x_end = std::max(rect.x_end, t.x_end);
+		rect.y_begin = std::min(rect.y_begin, t.y_begin);
+		rect.y_end = std::max(rect.y_end, t.y_end);
+	}
+	return rect;
+}
+
+void Pathtracer::Checkpoint::merge(Checkpoint const &other) {
+	if (other.width != width || other.height != height || other.samples != samples || other.max_ray_depth != max_ray_depth) {
+		throw std::runtime_error("Checkpoints are for different films.");
+	}
+	if (other.tiles.size() != tiles.size()) {
+		throw std::runtime_error("Checkpoints have different tile lists (were they rendered with the same --seed?).");
+	}
+	for (uint32_t i = 0; i < tiles.size(); ++i) {
+		Tile const &a = tiles[i];
+		Tile const &b = other.tiles[i];
+		if (a.seed != b.seed || a.x_begin != b.x_begin || a.x_end != b.x_end || a.y_begin != b.y_begin
+		 || a.y_end != b.y_end || a.s_begin != b.s_begin || a.s_end != b.s_end) {
+			throw std::runtime_error("Checkpoints have different tile lists (were they rendered with the same --seed?).");
+		}
+		if (done[i] && other.done[i]) {
+			throw std::runtime_error("Checkpoints both contain tile " + std::to_string(i) + ".");
+		}
+	}
+	if (other.aov_mask != aov_mask) {
+		throw std::runtime_error("Checkpoints record different AOVs ('" + AOV::to_string(aov_mask) + "' vs '" + AOV::to_string(other.aov_mask) + "').");
+	}
+
+	//fixed-point sums, so merging is exact (and order doesn't matter):
+	for (size_t i = 0; i < accumulator.size(); ++i) {
+		accumulator[i][0] += other.accumulator[i][0];
+		accumulator[i][1] += other.accumulator[i][1];
+		accumulator[i][2] += other.accumulator[i][2];
+		accumulator_samples[i] += other.accumulator_samples[i];
+	}
+	for (size_t i = 0; i < aov_accumulator.size(); ++i) {
+		aov_accumulator[i] += other.aov_accumulator[i];
+	}
+	for (size_t i = 0; i < aov_samples.size(); ++i) {
+		aov_samples[i] += other.aov_samples[i];
+	}
+	for (uint32_t i = 0; i < done.size(); ++i) {
+		done[i] |= other.done[i];
+	}
+}
+
+Pathtracer::Checkpoint Pathtracer::Checkpoint::load(std::string const &filename) {
+	std::ifstream in(filename, std::ios::binary | std::ios::ate);
+	if (!in) throw std::runtime_error("Failed to open '" + filename + "'.");
+	Checkpoint_Reader read{in, filename, uint64_t(in.tellg())};
+	in.seekg(0);
+
+	char format[4];
+	for (char &c : format) c = char(read.u8());
+	if (std::memcmp(format, Checkpoint_format, 4) != 0) {
+		throw std::runtime_error("'" + filename + "' is not a checkpoint file.");
+	}
+
+	Checkpoint ret;
+	ret.width = read.u32();
+	ret.height = read.u32();
+	ret.samples = read.u32();
+	ret.max_ray_depth = read.u32();
+	uint32_t tile_count = read.u32();
+
+	ret.plan.tile_width = read.u32();
+	ret.plan.tile_height = read.u32();
+	ret.plan.tile_samples = read.u32();
+	ret.plan.threads = read.u32();
+	ret.plan.tiles = read.u32();
+	ret.plan.split_tiles = read.u32();
+
+	read.expect(tile_count, 8 * 4 + 1);
+	ret.tiles.resize(tile_count);
+	for (Tile &t : ret.tiles) {
+		t.seed = read.u32();
+		t.x_begin = read.u32();
+		t.x_end = read.u32();
+		t.y_begin = read.u32();
+		t.y_end = read.u32();
+		t.s_begin = read.u32();
+		t.s_end = read.u32();
+		t.index = read.u32();
+	}
+	ret.done.resize(tile_count);
+	for (uint8_t &d : ret.done) d = read.u8();
+
+	uint64_t pixels = uint64_t(ret.width) * uint64_t(ret.height);
+	read.expect(pixels, 3 * 8 + 4);
+	ret.accumulator.resize(size_t(pixels));
+	for (auto &a : ret.accumulator) {
+		for (int64_t &c : a) c = int64_t(read.u64());
+	}
+	ret.accumulator_samples.resize(size_t(pixels));
+	for (uint32_t &n : ret.accumulator_samples) n = read.u32();
+
+	if (read.left() != 0) {
+		ret.aov_mask = read.u32();
+		if (ret.aov_mask & ~uint32_t(AOV::All)) {
+			throw std::runtime_error("Checkpoint '" + filename + "' has unknown AOVs.");
+		}
+		AOV_Layout layout(ret.aov_mask);
+		if (layout.stride) read.expect(pixels, uint64_t(layout.stride) * 8 + 4);
+		ret.aov_accumulator.resize(size_t(pixels) * layout.stride);
+		for (int64_t &c : ret.aov_accumulator) c = int64_t(read.u64());
+		ret.aov_samples.resize(layout.stride ? size_t(pixels) : 0);
+		for (uint32_t &n : ret.aov_samples) n = read.u32();
+	}
+
+	if (read.left() != 0) {
+		throw std::runtime_error("Checkpoint '" + filename + "' has trailing data.");
+	}
+
+	for (uint32_t i = 0; i < ret.tiles.size(); ++i) {
+		Tile const &t = ret.tiles[i];
+		if (t.index != i || t.x_end > ret.width || t.y_end > ret.height || t.s_end > ret.samples
+		    || t.x_begin >= t.x_end || t.y_begin >= t.y_end || t.s_begin >= t.s_end) {
+			throw std::runtime_error("Checkpoint '" + filename + "' has an invalid tile.");
+		}
+	}
+
+	return ret;
+}
+
+void Pathtracer::Checkpoint::save(std::string const &filename) const {
+	assert(tiles.size() == done.size());
+	assert(accumulator.size() == size_t(width) * size_t(height));
+	assert(accumulator_samples.size() == accumulator.size());
+	assert(aov_accumulator.size() == accumulator.size() * AOV_Layout(aov_mask).stride);
+
+	//write to a temporary file first, so that an interrupted save never clobbers the previous checkpoint:
+	std::string temp = filename + ".tmp";
+	{
+		std::ofstream out(temp, std::ios::binary);
+		Checkpoint_Writer write{out};
+
+		for (char c : Checkpoint_format) write.u8(uint8_t(c));
+		write.u32(width);
+		write.u32(height);
+		write.u32(samples);
+		write.u32(max_ray_depth);
+		write.u32(uint32_t(tiles.size()));
+
+		write.u32(plan.tile_width);
+		write.u32(plan.tile_height);
+		write.u32(plan.tile_samples);
+		write.u32(plan.threads);
+		write.u32(plan.tiles);
+		write.u32(plan.split_tiles);
+
+		for (Tile const &t : tiles) {
+			write.u32(t.seed);
+			write.u32(t.x_begin);
+			write.u32(t.x_end);
+			write.u32(t.y_begin);
+			write.u32(t.y_end);
+			write.u32(t.s_begin);
+			write.u32(t.s_end);
+			write.u32(t.index);
+		}
+		for (uint8_t d : done) write.u8(d);
+
+		for (auto const &a : accumulator) {
+			for (int64_t c : a) write.u64(uint64_t(c));
+		}
+		for (uint32_t n : accumulator_samples) write.u32(n);
+
+		if (aov_mask != 0) {
+			write.u32(aov_mask);
+			for (int64_t c : aov_accumulator) write.u64(uint64_t(c));
+			for (uint32_t n : aov_samples) write.u32(n);
+		}
+		write.flush();
+
+		out.close();
+		if (!out) throw std::runtime_error("Failed to write '" + temp + "'.");
+	}
+
+	std::error_code ec;
+	std::filesystem::rename(temp, filename, ec);
+	if (ec) throw std::runtime_error("Failed to rename '" + temp + "' to '" + filename + "': " + ec.message());
+}
+
+} // namespace PT
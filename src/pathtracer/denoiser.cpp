@@ -0,0 +1,161 @@
+
+#include "denoiser.h"
+
+#include "../lib/mathlib.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace PT {
+
+//rows per band handed out to a thread:
+constexpr uint32_t BandRows = 8;
+
+//call f(band) for every band in [0, bands), on the calling thread and (if given) thread_pool's workers:
+// the caller takes bands too, and only waits for bands a worker has already started -- so it finishes even
+// when every worker is busy (e.g., it is itself a worker, or other workers are in here as well).
+template< typename F >
+static void for_each_band(uint32_t bands, Thread_Pool *thread_pool, F const &f) {
+	struct Shared {
+		std::atomic< uint32_t > next{0};
+		std::mutex mut;
+		std::condition_variable finished;
+		uint32_t done = 0;
+	};
+	auto shared = std::make_shared< Shared >();
+	//(helpers that start after every band is taken return without touching f, so they may outlive this call)
+	auto work = [shared, bands, &f]() {
+		uint32_t count = 0;
+		for (uint32_t band = shared->next++; band < bands; band = shared->next++) {
+			f(band);
+			count += 1;
+		}
+		if (count == 0) return;
+		std::lock_guard< std::mutex > lock(shared->mut);
+		shared->done += count;
+		if (shared->done == bands) shared->finished.notify_all();
+	};
+	if (thread_pool && thread_pool->size() > 1) {
+		for (uint32_t w = 1; w < std::min(bands, thread_pool->size()); ++w) {
+			thread_pool->enqueue(work);
+		}
+	}
+	work();
+	std::unique_lock< std::mutex > lock(shared->mut);
+	shared->finished.wait(lock, [&]() { return shared->done == bands; });
+}
+
+HDR_Image Denoiser::denoise(HDR_Image const &color, HDR_Image const &albedo, HDR_Image const &normal,
+                            HDR_Image const &depth, Thread_Pool *thread_pool) const {
+	assert(albedo.w == color.w && albedo.h == color.h);
+	assert(normal.w == color.w && normal.h == color.h);
+	assert(depth.w == color.w && depth.h == color.h);
+
+	uint32_t w = color.w, h = color.h;
+	uint32_t pixels = w * h;
+	if (pixels == 0) return color.copy();
+
+	//demodulate albedo (pixels with ~zero albedo, e.g. misses, are filtered as-is):
+	auto safe_albedo = [&](uint32_t i) {
+		Spectrum a = albedo.at(i);
+		return Spectrum(a.r > 1e-3f ? a.r : 1.0f, a.g > 1e-3f ? a.g : 1.0f, a.b > 1e-3f ? a.b : 1.0f);
+	};
+
+	std::vector< Spectrum > current(pixels), next(pixels);
+	std::vector< Vec3 > normals(pixels);
+	std::vector< float > depths(pixels);
+	std::vector< uint8_t > hits(pixels); //did any camera ray through the pixel hit the scene?
+	std::vector< float > lumas(pixels);
+	for (uint32_t i = 0; i < pixels; ++i) {
+		Spectrum a = safe_albedo(i);
+		current[i] = color.at(i) * Spectrum(1.0f / a.r, 1.0f / a.g, 1.0f / a.b);
+		Spectrum const &n = normal.at(i);
+		normals[i] = Vec3(n.r, n.g, n.b);
+		//(averaged normals are shorter than unit length at silhouettes; renormalize so they compare fairly)
+		hits[i] = normals[i].norm_squared() > 1e-8f;
+		if (hits[i]) normals[i].normalize();
+		depths[i] = depth.at(i).r;
+	}
+
+	//B3-spline kernel taps:
+	static float const kernel[5] = {1.0f / 16.0f, 1.0f / 4.0f, 3.0f / 8.0f, 1.0f / 4.0f, 1.0f / 16.0f};
+
+	uint32_t bands = (h + BandRows - 1) / BandRows;
+
+	for (uint32_t iteration = 0; iteration < iterations; ++iteration) {
+		int32_t step = 1 << iteration;
+		float sigma_c = sigma_color / float(1 << iteration);
+
+		for (uint32_t i = 0; i < pixels; ++i) {
+			lumas[i] = current[i].luma();
+		}
+
+		//depth tolerance grows with distance from the center tap:
+		float depth_tolerance[5][5];
+		for (int32_t j = -2; j <= 2; ++j) {
+			for (int32_t i = -2; i <= 2; ++i) {
+				depth_tolerance[j + 2][i + 2] = sigma_depth * step * std::sqrt(float(i * i + j * j));
+			}
+		}
+
+		for_each_band(bands, thread_pool, [&](uint32_t band) {
+			for (uint32_t y = band * BandRows; y < std::min(h, (band + 1) * BandRows); ++y) {
+				for (uint32_t x = 0; x < w; ++x) {
+					uint32_t p = y * w + x;
+					float luma_p = lumas[p];
+					Vec3 n_p = normals[p];
+					bool hit_p = hits[p];
+					float z_p = depths[p];
+
+					Spectrum sum;
+					float weight_sum = 0.0f;
+					for (int32_t j = -2; j <= 2; ++j) {
+						int32_t qy = int32_t(y) + j * step;
+						if (qy < 0 || qy >= int32_t(h)) continue;
+						for (int32_t i = -2; i <= 2; ++i) {
+							int32_t qx = int32_t(x) + i * step;
+							if (qx < 0 || qx >= int32_t(w)) continue;
+							uint32_t q = uint32_t(qy) * w + uint32_t(qx);
+
+							//normal: don't mix hits with misses
+							if (hits[q] != hit_p) continue;
+
+							//color: relative luma difference
+							float luma_q = lumas[q];
+							float dc = (luma_p - luma_q) / (sigma_c * 0.5f * (std::abs(luma_p) + std::abs(luma_q)) + 1e-4f);
+
+							//normal: penalize creases
+							// (exp(-s * (1 - cos)) is close to cos^s for the angles that matter, and cheaper)
+							float dn = hit_p ? sigma_normal * (1.0f - dot(n_p, normals[q])) : 0.0f;
+
+							//depth: relative difference
+							float dz = std::abs(z_p - depths[q]) / (depth_tolerance[j + 2][i + 2] * std::max(z_p, depths[q]) + 1e-4f);
+
+							float weight = kernel[i + 2] * kernel[j + 2] * std::exp(-(dc * dc + dn + dz));
+							sum += current[q] * weight;
+							weight_sum += weight;
+						}
+					}
+					//(weight_sum > 0 because the center tap always has full weight)
+					next[p] = sum / weight_sum;
+				}
+			}
+		});
+
+		std::swap(current, next);
+	}
+
+	//remodulate:
+	HDR_Image result(w, h);
+	for (uint32_t i = 0; i < pixels; ++i) {
+		result.at(i) = current[i] * safe_albedo(i);
+	}
+	return result;
+}
+
+} // namespace PT
@@ -0,0 +1,27 @@
+
+#pragma once
+
+#include "../util/hdr_image.h"
+#include "../util/thread_pool.h"
+
+namespace PT {
+
+//edge-avoiding a-trous wavelet denoiser (Dammertz et al., "Edge-Avoiding A-Trous Wavelet Transform
+// for fast Global Illumination Filtering", 2010), guided by the first surface hit of each camera ray.
+//
+//Color is divided by albedo before filtering (so texture detail isn't blurred) and multiplied back after.
+struct Denoiser {
+	uint32_t iterations = 5; //filter footprint doubles every iteration (5 => 125x125 pixels)
+	float sigma_color = 1.0f; //tolerance for (relative) luma differences; halves every iteration
+	float sigma_normal = 64.0f; //normal weight is exp(-sigma_normal * (1 - dot(n_p, n_q)))
+	float sigma_depth = 0.02f; //tolerance for relative depth differences, per pixel of distance
+
+	//guides are per-pixel averages of first hit albedo, world-space normal (as xyz), and distance (in r);
+	// all zero for pixels whose camera rays missed the scene.
+	//rows are filtered in bands on the calling thread and (if given) thread_pool's workers; this may be
+	// called from one of thread_pool's own workers:
+	HDR_Image denoise(HDR_Image const &color, HDR_Image const &albedo, HDR_Image const &normal,
+	                  HDR_Image const &depth, Thread_Pool *thread_pool = nullptr) const;
+};
+
+} // namespace PT
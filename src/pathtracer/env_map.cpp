@@ -0,0 +1,102 @@
+
+#include "env_map.h"
+
+#include "../scene/env_light.h"
+#include "../scene/shape.h"
+#include "../util/rand.h"
+
+#include <algorithm>
+
+namespace PT {
+
+Environment_Map::Environment_Map(std::vector< Environment_Light const * > const &lights) {
+	if (lights.empty()) return;
+
+	//pick a resolution that keeps every texel of every image, and the sampler of the largest image:
+	w = 1;
+	h = 1;
+	Textures::Image::Sampler sampler = Textures::Image::Sampler::nearest;
+	bool hemisphere = false;
+	for (Environment_Light const *light : lights) {
+		std::visit([&](auto const &l) {
+			auto texture = l.radiance.lock();
+			if (texture && texture->template is< Textures::Image >()) {
+				Textures::Image const &image = std::get< Textures::Image >(texture->texture);
+				if (uint64_t(image.image.w) * image.image.h > uint64_t(w) * h) sampler = image.sampler;
+				w = std::max(w, image.image.w);
+				h = std::max(h, image.image.h);
+			}
+			if constexpr (std::is_same_v< std::decay_t< decltype(l) >, Environment_Lights::Hemisphere >) {
+				hemisphere = true;
+			}
+		}, light->light);
+	}
+	//(hemispheres cut off at the horizon, which needs to fall between rows)
+	if (hemisphere) h += h % 2;
+
+	//sum the lights at texel centers:
+	HDR_Image texels(w, h);
+	std::vector< float > weights(size_t(w) * h);
+	double total_luma = 0.0;
+	for (uint32_t y = 0; y < h; ++y) {
+		float theta = PI_F * (y + 0.5f) / h;
+		for (uint32_t x = 0; x < w; ++x) {
+			float phi = 2.0f * PI_F * (x + 0.5f) / w;
+			Vec3 dir(std::sin(theta) * std::cos(phi), -std::cos(theta), std::sin(theta) * std::sin(phi));
+			Spectrum &texel = texels.at(x, y);
+			for (Environment_Light const *light : lights) {
+				texel += light->evaluate(dir);
+			}
+			weights[size_t(y) * w + x] = std::max(texel.luma(), 0.0f);
+			total_luma += weights[size_t(y) * w + x];
+		}
+	}
+
+	//importance is luma times solid angle, plus a little everywhere so that the sampling pdf is never zero
+	// where the map isn't black (and is uniform over the sphere when the map is all black):
+	float floor = total_luma > 0.0 ? 1e-2f * float(total_luma / (double(w) * h)) : 1.0f;
+	for (uint32_t y = 0; y < h; ++y) {
+		float sin_theta = std::sin(PI_F * (y + 0.5f) / h);
+		for (uint32_t x = 0; x < w; ++x) {
+			float &weight = weights[size_t(y) * w + x];
+			weight = (weight + floor) * sin_theta;
+		}
+	}
+	cells = Samplers::Alias_Table(weights);
+
+	//(lookups happen at level 0, so trilinear filtering is the same as bilinear without building mipmaps)
+	if (sampler == Textures::Image::Sampler::trilinear) sampler = Textures::Image::Sampler::bilinear;
+	radiance = Textures::Image(sampler, texels, Textures::Image::Storage::rows);
+}
+
+uint32_t Environment_Map::cell(Vec3 dir) const {
+	Vec2 uv = Shapes::Sphere::uv(dir);
+	uint32_t x = std::min(uint32_t(uv.x * w), w - 1);
+	uint32_t y = std::min(uint32_t(uv.y * h), h - 1);
+	return y * w + x;
+}
+
+Spectrum Environment_Map::evaluate(Vec3 dir) const {
+	if (empty()) return {};
+	return radiance.evaluate(Shapes::Sphere::uv(dir), 0.0f);
+}
+
+Vec3 Environment_Map::sample(RNG &rng) const {
+	assert(!empty());
+	uint32_t i = cells.sample(rng);
+	float u = ((i % w) + rng.unit()) / w;
+	float v = ((i / w) + rng.unit()) / h;
+	float theta = PI_F * v;
+	float phi = 2.0f * PI_F * u;
+	return Vec3(std::sin(theta) * std::cos(phi), -std::cos(theta), std::sin(theta) * std::sin(phi));
+}
+
+float Environment_Map::pdf(Vec3 dir) const {
+	if (empty()) return 0.0f;
+	//texels are uniform in (u,v), which covers 2 pi^2 sin(theta) steradians per unit area:
+	float sin_theta = std::sqrt(dir.x * dir.x + dir.z * dir.z) / dir.norm();
+	if (sin_theta <= 0.0f) return 0.0f;
+	return cells.probability(cell(dir)) * float(w) * float(h) / (2.0f * PI_F * PI_F * sin_theta);
+}
+
+} // namespace PT
@@ -0,0 +1,44 @@
+
+#pragma once
+
+#include <vector>
+
+#include "../lib/mathlib.h"
+#include "../lib/spectrum.h"
+#include "../scene/texture.h"
+#include "samplers.h"
+
+class Environment_Light;
+struct RNG;
+
+namespace PT {
+
+//all of a scene's environment lights, combined into one lat/lon radiance map (north pole at (0,1,0), laid
+// out like Shapes::Sphere::uv), so rays that miss the scene can evaluate, sample, and find the pdf of the
+// environment in constant time -- no matter how many lights there are or what textures they use.
+//
+//The map has the resolution of the largest image texture among the lights (1x1 if every light is a
+// constant sphere), and is looked up with that texture's sampler (trilinear lookups never leave level 0,
+// so they are bilinear here). A single image light (or one with constants) evaluates just as it would on
+// its own; several images of different sizes are filtered at the largest one's resolution.
+//Directions are importance-sampled by radiance, which is piecewise constant over texels.
+class Environment_Map {
+public:
+	Environment_Map() = default;
+	explicit Environment_Map(std::vector< Environment_Light const * > const &lights);
+
+	bool empty() const { return w == 0; }
+
+	Spectrum evaluate(Vec3 dir) const;
+	Vec3 sample(RNG &rng) const;
+	float pdf(Vec3 dir) const;
+
+	uint32_t w = 0, h = 0;
+	Textures::Image radiance; //the lights summed at texel centers; row 0 is v = 0 (i.e., dir (0,-1,0))
+	Samplers::Alias_Table cells; //importance of each texel
+
+private:
+	uint32_t cell(Vec3 dir) const;
+};
+
+} // namespace PT
@@ -17,10 +17,12 @@ public:
 	Instance(Shape const * shape, Material* material, const Mat4& T)
 		: T(T), iT(T.inverse()), material(material), geometry(shape) {
 		has_transform = T != Mat4::I;
+		if (has_transform) uv_scale_factor = 1.0f / std::cbrt(std::abs(T.det()));
 	}
 	Instance(Tri_Mesh const * mesh, Material* material, const Mat4& T)
 		: T(T), iT(T.inverse()), material(material), geometry(mesh) {
 		has_transform = T != Mat4::I;
+		if (has_transform) uv_scale_factor = 1.0f / std::cbrt(std::abs(T.det()));
 	}
 
 	BBox bbox() const {
@@ -31,7 +33,11 @@ public:
 
 	Trace hit(Ray ray) const {
 		if (has_transform) ray.transform(iT);
-		auto trace = std::visit([&](const auto& g) { return g->hit(ray); }, geometry);
+		auto trace = std::visit([&](const auto& g) {
+			Trace t = g->hit(ray);
+			if (t.hit) t.uv_scale = g->uv_scale() * uv_scale_factor;
+			return t;
+		}, geometry);
 		if (trace.hit) {
 			trace.material = material;
 			if (has_transform) trace.transform(T, iT.T());
@@ -39,6 +45,11 @@ public:
 		return trace;
 	}
 
+	//uv units per unit of world-space distance along the surface (what hit() reports as Trace::uv_scale):
+	float uv_scale() const {
+		return std::visit([&](const auto& g) { return g->uv_scale(); }, geometry) * uv_scale_factor;
+	}
+
 	uint32_t visualize(GL::Lines& lines, GL::Lines& active, uint32_t level, Mat4 vtrans) const {
 		if (has_transform) vtrans = vtrans * T;
 		return std::visit(overloaded{[&](const Tri_Mesh* mesh) {
@@ -66,6 +77,7 @@ public:
 private:
 	Mat4 T, iT;
 	bool has_transform = false;
+	float uv_scale_factor = 1.0f; //converts geometry's uv_scale to world space (1 / average scale of T)
 
 	const Material* material = nullptr;
 	std::variant<const Shape*, const Tri_Mesh*> geometry;
@@ -84,6 +96,29 @@ public:
 		return ret;
 	}
 
+	bool is_spot() const {
+		return std::holds_alternative<Delta_Lights::Spot>(light->light);
+	}
+
+	//could this light reach any point in box? (conservative)
+	// delta lights don't fall off with distance, so only spot lights -- which light nothing outside their
+	// cone -- are ever ruled out
+	bool reaches(BBox box) const {
+		auto spot = std::get_if<Delta_Lights::Spot>(&light->light);
+		if (!spot) return true;
+		float half_angle = Radians(std::max(spot->inner_angle, spot->outer_angle) / 2.0f);
+		if (half_angle >= PI_F) return true;
+
+		//bounding sphere of the box in light space, where the spot shines along +y:
+		if (has_transform) box.transform(iT);
+		Vec3 center = box.center();
+		float radius = 0.5f * (box.max - box.min).norm();
+		float distance = center.norm();
+		if (distance <= radius) return true;
+		float angle = std::atan2(Vec2(center.x, center.z).norm(), center.y);
+		return angle - std::asin(radius / distance) <= half_angle + 1e-3f;
+	}
+
 private:
 	Mat4 T, iT;
 	bool has_transform = false;
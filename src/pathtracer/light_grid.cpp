@@ -0,0 +1,66 @@
+
+#include "light_grid.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace PT {
+
+Light_Grid::Light_Grid(std::vector<Light_Instance> const &lights, BBox bounds_) {
+	//most cells across the longest side of the scene:
+	constexpr uint32_t max_cells_per_axis = 16;
+
+	for (uint32_t i = 0; i < lights.size(); ++i) all_lights.emplace_back(i);
+
+	//a grid only helps if some light can be culled (i.e., there are spot lights) and the scene has a size:
+	bool any_spots = false;
+	for (auto const &light : lights) any_spots = any_spots || light.is_spot();
+	if (!any_spots || bounds_.empty()) return;
+
+	//(padded slightly, so shading points on the surface of the bounds are inside)
+	Vec3 extent = bounds_.max - bounds_.min;
+	float longest = std::max(extent.x, std::max(extent.y, extent.z));
+	if (!std::isfinite(longest)) return;
+	Vec3 pad = Vec3(1e-3f * longest + 1e-4f);
+	bounds = BBox(bounds_.min - pad, bounds_.max + pad);
+	extent = bounds.max - bounds.min;
+	longest = std::max(extent.x, std::max(extent.y, extent.z));
+
+	auto cells_along = [&](float length) {
+		return std::clamp(uint32_t(std::ceil(max_cells_per_axis * length / longest)), 1u, max_cells_per_axis);
+	};
+	dim_x = cells_along(extent.x);
+	dim_y = cells_along(extent.y);
+	dim_z = cells_along(extent.z);
+
+	Vec3 cell_size = extent / Vec3(float(dim_x), float(dim_y), float(dim_z));
+	cell_start.reserve(size_t(dim_x) * dim_y * dim_z + 1);
+	for (uint32_t z = 0; z < dim_z; ++z) {
+		for (uint32_t y = 0; y < dim_y; ++y) {
+			for (uint32_t x = 0; x < dim_x; ++x) {
+				Vec3 min = bounds.min + cell_size * Vec3(float(x), float(y), float(z));
+				BBox cell(min, min + cell_size);
+				cell_start.emplace_back(uint32_t(cell_lights.size()));
+				for (uint32_t i = 0; i < lights.size(); ++i) {
+					if (lights[i].reaches(cell)) cell_lights.emplace_back(i);
+				}
+			}
+		}
+	}
+	cell_start.emplace_back(uint32_t(cell_lights.size()));
+}
+
+Light_Grid::Range Light_Grid::lights_at(Vec3 p) const {
+	Range all{all_lights.data(), all_lights.data() + all_lights.size()};
+	if (dim_x == 0) return all;
+
+	Vec3 t = (p - bounds.min) / (bounds.max - bounds.min);
+	if (!(t.x >= 0.0f && t.x <= 1.0f && t.y >= 0.0f && t.y <= 1.0f && t.z >= 0.0f && t.z <= 1.0f)) return all;
+	uint32_t x = std::min(uint32_t(t.x * dim_x), dim_x - 1);
+	uint32_t y = std::min(uint32_t(t.y * dim_y), dim_y - 1);
+	uint32_t z = std::min(uint32_t(t.z * dim_z), dim_z - 1);
+	uint32_t cell = (z * dim_y + y) * dim_x + x;
+	return Range{cell_lights.data() + cell_start[cell], cell_lights.data() + cell_start[cell + 1]};
+}
+
+} // namespace PT
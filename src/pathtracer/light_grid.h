@@ -0,0 +1,36 @@
+
+#pragma once
+
+#include <vector>
+
+#include "../lib/mathlib.h"
+#include "instance.h"
+
+namespace PT {
+
+//uniform grid over the scene, listing the delta lights that might reach each cell, so shading points
+// only look at lights that can light them. (Spot lights are culled by their cones; see Light_Instance::reaches.)
+class Light_Grid {
+public:
+	Light_Grid() = default;
+	Light_Grid(std::vector<Light_Instance> const &lights, BBox bounds);
+
+	//indices (into the lights the grid was built from):
+	struct Range {
+		uint32_t const *first = nullptr, *last = nullptr;
+		uint32_t const *begin() const { return first; }
+		uint32_t const *end() const { return last; }
+		uint32_t size() const { return uint32_t(last - first); }
+		uint32_t operator[](uint32_t i) const { return first[i]; }
+	};
+	//lights that might reach point p (all of them, for points outside the grid):
+	Range lights_at(Vec3 p) const;
+
+	BBox bounds;
+	uint32_t dim_x = 0, dim_y = 0, dim_z = 0; //cells along each axis (all zero => no grid)
+	std::vector<uint32_t> cell_start; //cell i's lights are cell_lights[cell_start[i], cell_start[i+1])
+	std::vector<uint32_t> cell_lights;
+	std::vector<uint32_t> all_lights;
+};
+
+} // namespace PT
@@ -12,6 +12,8 @@ constexpr bool SAMPLE_AREA_LIGHTS = true;
 constexpr bool RENDER_NORMALS = false;
 constexpr bool LOG_CAMERA_RAYS = false;
 constexpr bool LOG_AREA_LIGHT_RAYS = false;
+//when sampling delta lights, candidates considered per shadow ray:
+constexpr uint32_t DELTA_LIGHT_CANDIDATES = 8;
 static thread_local RNG log_rng(0x15462662); //separate RNG for logging a fraction of rays to avoid changing result when logging enabled
 
 Spectrum Pathtracer::sample_direct_lighting_task4(RNG &rng, const Shading_Info& hit) {
@@ -24,7 +26,7 @@ Spectrum Pathtracer::sample_direct_lighting_task4(RNG &rng, const Shading_Info&
 
     // Compute exact amount of light coming from delta lights:
 	//  (these don't need to be sampled)
-    Spectrum radiance = sum_delta_lights(hit);
+    Spectrum radiance = sum_delta_lights(rng, hit);
 
 	//TODO: ask hit.bsdf to sample an in direction that would scatter out along hit.out_dir
 
@@ -32,6 +34,7 @@ Spectrum Pathtracer::sample_direct_lighting_task4(RNG &rng, const Shading_Info&
 
 	//TODO: construct a ray travelling in that direction
 	// NOTE: because we want emitted light only, can use depth = 0 for the ray
+	// NOTE: pass hit.footprint to the bsdf, and copy hit.cone_width/cone_spread to the ray, for texture filtering
 
 	//TODO: trace() the ray to get the emitted light (first part of the return value)
 
@@ -46,7 +49,7 @@ Spectrum Pathtracer::sample_direct_lighting_task6(RNG &rng, const Shading_Info&
 
     // For task 6, we want to upgrade our direct light sampling procedure to also
     // sample area lights using mixture sampling.
-	Spectrum radiance = sum_delta_lights(hit);
+	Spectrum radiance = sum_delta_lights(rng, hit);
 
 	// Example of using log_ray():
 	if constexpr (LOG_AREA_LIGHT_RAYS) {
@@ -70,6 +73,7 @@ Spectrum Pathtracer::sample_indirect_lighting(RNG &rng, const Shading_Info& hit)
 
 	//TODO: construct a ray travelling in that direction
 	// NOTE: be sure to reduce the ray depth! otherwise infinite recursion is possible
+	// NOTE: pass hit.footprint to the bsdf, and copy hit.cone_width/cone_spread to the ray, for texture filtering
 
 	//TODO: trace() the ray to get the reflected light (the second part of the return value)
 
@@ -79,20 +83,22 @@ Spectrum Pathtracer::sample_indirect_lighting(RNG &rng, const Shading_Info& hit)
     return radiance;
 }
 
-std::pair<Spectrum, Spectrum> Pathtracer::trace(RNG &rng, const Ray& ray) {
+std::pair<Spectrum, Spectrum> Pathtracer::trace(RNG &rng, const Ray& ray, Sample_AOVs *aovs) {
 
-	Trace result = scene.hit(ray);
+	Stats::traced_ray();
+
+	Trace result = session->scene.hit(ray);
 	if (!result.hit) {
-		if (env_lights.size()) {
-			Spectrum radiance;
-			for (const auto& light : env_lights) {
-				radiance += light.second->evaluate(ray.dir);
-			}
+		if (!session->env_map.empty()) {
+			Spectrum radiance = session->env_map.evaluate(ray.dir);
+			if (aovs) aovs->direct = radiance;
 			return {radiance, {}};
 		}
 		return {};
 	}
 
+	Stats::path_vertex();
+
 	const Material* bsdf = result.material;
 	if (!bsdf) return {};
 
@@ -100,7 +106,23 @@ std::pair<Spectrum, Spectrum> Pathtracer::trace(RNG &rng, const Ray& ray) {
 		result.normal = -result.normal;
 	}
 
+	//texture filtering: the ray cone's width where it hits, stretched by the slant of the surface and
+	// measured in uv units, gives the footprint textures should be averaged over (as in Akenine-Moller et al.,
+	// "Texture Level of Detail Strategies for Real-Time Ray Tracing"). Approximations: meshes use their
+	// average uv density, and the cone's spread doesn't grow at bounces (so textures seen through rough
+	// reflections are filtered less than they could be -- never more).
+	float cone_width = ray.cone_width + ray.cone_spread * result.distance;
+	float cos_theta = std::max(std::abs(dot(result.normal, ray.dir)), 1e-3f);
+	float footprint = cone_width * result.uv_scale / cos_theta;
+
+	if (aovs) {
+		if (auto texture = bsdf->display().lock()) aovs->albedo = texture->evaluate(result.uv, texture->lod(footprint));
+		aovs->normal = result.normal;
+		aovs->depth = result.distance;
+	}
+
 	if constexpr (RENDER_NORMALS) {
+		if (aovs) aovs->direct = Spectrum::direction(result.normal);
 		return {Spectrum::direction(result.normal), {}};
 	}
 
@@ -108,15 +130,16 @@ std::pair<Spectrum, Spectrum> Pathtracer::trace(RNG &rng, const Ray& ray) {
 	Mat4 world_to_object = object_to_world.T();
 	Vec3 out_dir = world_to_object.rotate(ray.point - result.position).unit();
 
-	// TODO DEV: do we want to add ray differentials to track UV derivatives for texture sampling?
-	// https://pbr-book.org/3ed-2018/Geometry_and_Transformations/Rays#RayDifferentials
 	Shading_Info info = {*bsdf,         world_to_object, object_to_world, result.position, out_dir,
-	                     result.normal, result.uv, ray.depth};
+	                     result.normal, result.uv, ray.depth, footprint, cone_width, ray.cone_spread};
 
-	Spectrum emissive = bsdf->emission(info.uv);
+	Spectrum emissive = bsdf->emission(info.uv, info.footprint);
 
 	//if no recursion was requested, or the material doesn't scatter light (i.e., is Materials::Emissive), don't recurse:
-	if (ray.depth == 0 || bsdf->is_emissive()) return {emissive, {}};
+	if (ray.depth == 0 || bsdf->is_emissive()) {
+		if (aovs) aovs->direct = emissive;
+		return {emissive, {}};
+	}
 
 	Spectrum direct;
 	if constexpr (SAMPLE_AREA_LIGHTS) {
@@ -124,223 +147,32 @@ std::pair<Spectrum, Spectrum> Pathtracer::trace(RNG &rng, const Ray& ray) {
 	} else {
 		direct = sample_direct_lighting_task4(rng, info);
 	}
+	Spectrum indirect = sample_indirect_lighting(rng, info);
+
+	if (aovs) {
+		aovs->direct = emissive + direct;
+		aovs->indirect = indirect;
+	}
 
-	return {emissive, direct + sample_indirect_lighting(rng, info)};
+	return {emissive, direct + indirect};
 }
 
-Pathtracer::Pathtracer() : thread_pool(std::thread::hardware_concurrency()) {
+Pathtracer::Pathtracer() : own_thread_pool(std::make_unique< Thread_Pool >(std::thread::hardware_concurrency())) {
+	thread_pool = own_thread_pool.get();
+}
+
+Pathtracer::Pathtracer(Thread_Pool &shared_pool) : thread_pool(&shared_pool) {
 }
 
 Pathtracer::~Pathtracer() {
 	cancel();
-	thread_pool.stop();
+	if (own_thread_pool) own_thread_pool->stop();
 }
 
 void Pathtracer::build_scene(Scene& scene_) {
-
-	// It would be nice to let the interface be usable here (as with
-	// the path-tracing part), but this would cause too much hassle with
-	// editing the scene while building BVHs from it.
-	// This could be worked around by first copying all the mesh data
-	// and then building the BVHs, but I don't think it's that big
-	// of a deal, as BVH building should take at most a few seconds
-	// even with many big meshes.
-
-	// We could also do instancing instead of duplicating the bvh
-	// for big meshes, but that's something to add in the future
-
-	delta_lights.clear();
-	env_lights.clear();
-	textures.clear();
-	materials.clear();
-	meshes.clear();
-	shapes.clear();
-
-	std::unordered_map<std::shared_ptr<Halfedge_Mesh>, std::string> mesh_names;
-	std::unordered_map<std::shared_ptr<Skinned_Mesh>, std::string> skinned_mesh_names;
-	std::unordered_map<std::shared_ptr<Shape>, std::string> shape_names;
-	std::unordered_map<std::shared_ptr<Texture>, std::string> texture_names;
-	std::unordered_map<std::shared_ptr<Material>, std::string> material_names;
-	std::unordered_map<std::shared_ptr<Delta_Light>, std::string> delta_light_names;
-	std::unordered_map<std::shared_ptr<Environment_Light>, std::string> env_light_names;
-	std::string default_texture_name, default_material_name;
-
-	{ // copy scene data into path tracing formats
-		std::vector<std::future<std::pair<std::string, Tri_Mesh>>> mesh_futs;
-
-		for (const auto& [name, mesh] : scene_.meshes) {
-			mesh_names[mesh] = name;
-			mesh_futs.emplace_back(thread_pool.enqueue([name=name,mesh=mesh,this]() {
-				return std::pair{name, Tri_Mesh(Indexed_Mesh::from_halfedge_mesh( *mesh, Indexed_Mesh::SplitEdges), scene_use_bvh)};
-			}));
-		}
-
-		for (const auto& [name, mesh] : scene_.skinned_meshes) {
-			skinned_mesh_names[mesh] = name;
-			mesh_futs.emplace_back(thread_pool.enqueue([name=name,mesh=mesh,this]() {
-				return std::pair{name, Tri_Mesh(mesh->posed_mesh(), scene_use_bvh)};
-			}));
-		}
-
-		for (const auto& [name, shape] : scene_.shapes) {
-			shape_names[shape] = name;
-			shapes.emplace(name, std::make_shared<Shape>(*shape));
-		}
-
-		std::unordered_map<std::shared_ptr<Texture>, std::shared_ptr<Texture>> texture_to_copy;
-		for (const auto& [name, texture] : scene_.textures) {
-			texture_names[texture] = name;
-			auto copy = std::make_shared<Texture>(texture->copy());
-			texture_to_copy[texture] = copy;
-			textures.emplace(name, std::move(copy));
-		}
-		default_texture_name = scene_.make_unique("default_texture");
-		textures.emplace(default_texture_name, std::make_shared<Texture>(Textures::Constant{Spectrum{0.0f}, 1.0f}));
-
-		for (const auto& [name, material] : scene_.materials) {
-			material_names[material] = name;
-			auto copy = std::make_shared<Material>(*material);
-			copy->for_each([&](std::weak_ptr<Texture>& tex) {
-				if (!tex.expired()) tex = texture_to_copy[tex.lock()];
-			});
-			materials.emplace(name, std::move(copy));
-		}
-		default_material_name = scene_.make_unique("default_material");
-		materials.emplace(default_material_name, std::make_shared<Material>(Materials::Lambertian{ textures.at(default_texture_name) }));
-
-		for (const auto& [name, delta_light] : scene_.delta_lights) {
-			delta_light_names[delta_light] = name;
-			delta_lights.emplace(name, std::make_shared<Delta_Light>(*delta_light));
-		}
-
-		for (const auto& [name, env_light] : scene_.env_lights) {
-			env_light_names[env_light] = name;
-			auto light = std::make_shared<Environment_Light>(*env_light);
-			light->for_each([&](std::weak_ptr<Texture>& tex) {
-				if (!tex.expired()) tex = texture_to_copy[tex.lock()];
-			});
-			if (light->is<Environment_Lights::Sphere>()) {
-				auto& sphere_map = std::get<Environment_Lights::Sphere>(light->light);
-				if (auto radiance = sphere_map.radiance.lock()) {
-					if (radiance->is<Textures::Image>()) {
-						sphere_map.importance = Samplers::Sphere::Image{
-							std::get<Textures::Image>(radiance->texture).image
-						};
-					}
-				}
-			}
-			env_lights.emplace(name, std::move(light));
-		}
-
-		for (auto& f : mesh_futs) {
-			auto [name, mesh] = f.get();
-			meshes.emplace(name, std::make_shared<Tri_Mesh>(std::move(mesh)));
-		}
-	}
-
-	{ // create scene instances
-		std::vector<Instance> objects, area_lights;
-		std::vector<Light_Instance> lights;
-
-		for (const auto& [name, mesh_inst] : scene_.instances.meshes) {
-
-			if (!mesh_inst->settings.visible) continue;
-			if (mesh_inst->mesh.expired()) continue;
-
-			auto& mesh = meshes.at(mesh_names.at(mesh_inst->mesh.lock()));
-			auto& material = materials.at(mesh_inst->material.expired()
-			                                  ? default_material_name
-			                                  : material_names.at(mesh_inst->material.lock()));
-			Mat4 T = mesh_inst->transform.lock()->local_to_world();
-
-			objects.emplace_back(mesh.get(), material.get(), T);
-
-			if (material->is_emissive()) {
-				area_lights.emplace_back(mesh.get(), material.get(), T);
-			}
-		}
-
-		for (const auto& [name, mesh_inst] : scene_.instances.skinned_meshes) {
-
-			if (!mesh_inst->settings.visible) continue;
-			if (mesh_inst->mesh.expired()) continue;
-
-			auto& mesh = meshes.at(skinned_mesh_names.at(mesh_inst->mesh.lock()));
-			auto& material = materials.at(mesh_inst->material.expired()
-			                                  ? default_material_name
-			                                  : material_names.at(mesh_inst->material.lock()));
-			Mat4 T = mesh_inst->transform.lock()->local_to_world();
-
-			objects.emplace_back(mesh.get(), material.get(), T);
-
-			if (material->is_emissive()) {
-				area_lights.emplace_back(mesh.get(), material.get(), T);
-			}
-		}
-
-		for (const auto& [name, shape_inst] : scene_.instances.shapes) {
-
-			if (!shape_inst->settings.visible) continue;
-			if (shape_inst->shape.expired()) continue;
-
-			auto& shape = shapes.at(shape_names.at(shape_inst->shape.lock()));
-			auto& material = materials.at(shape_inst->material.expired()
-			                                  ? default_material_name
-			                                  : material_names.at(shape_inst->material.lock()));
-			Mat4 T = shape_inst->transform.lock()->local_to_world();
-
-			objects.emplace_back(shape.get(), material.get(), T);
-
-			if (material->is_emissive()) {
-				area_lights.emplace_back(shape.get(), material.get(), T);
-			}
-		}
-
-		for (const auto& [name, part_inst] : scene_.instances.particles) {
-
-			if (!part_inst->settings.visible) continue;
-			if (part_inst->mesh.expired()) continue;
-			if (part_inst->particles.expired()) continue;
-
-			auto& mesh = meshes.at(mesh_names.at(part_inst->mesh.lock()));
-			auto& material = materials.at(part_inst->material.expired()
-			                                  ? default_material_name
-			                                  : material_names.at(part_inst->material.lock()));
-			//Mat4 T = part_inst->transform.lock()->local_to_world();
-
-			auto particles = part_inst->particles.lock();
-			for (const auto& p : particles->particles) {
-				//NOTE: particle positions stored in world space (thus no 'T *' here):
-				Mat4 pT = Mat4::translate(p.position) * Mat4::scale(Vec3{particles->radius});
-
-				objects.emplace_back(mesh.get(), material.get(), pT);
-				if (material->is_emissive()) {
-					area_lights.emplace_back(mesh.get(), material.get(), pT);
-				}
-			}
-		}
-
-		for (const auto& [name, light_inst] : scene_.instances.delta_lights) {
-
-			if (!light_inst->settings.visible) continue;
-			if (light_inst->light.expired()) continue;
-
-			auto& light = delta_lights.at(delta_light_names.at(light_inst->light.lock()));
-			Mat4 T = light_inst->transform.lock()->local_to_world();
-
-			lights.emplace_back(light.get(), T);
-		}
-
-		
-		emissive_objects = List(std::move(area_lights));
-		point_lights = std::move(lights);
-
-		if (scene_use_bvh) {
-			scene = Aggregate(BVH<Instance>(std::move(objects)));
-		} else {
-			scene = Aggregate(List<Instance>(std::move(objects)));
-		}
-	}
+	build_timer.reset();
+	session = std::make_shared< Render_Session const >(scene_, scene_use_bvh, thread_pool);
+	build_timer.pause();
 }
 
 void Pathtracer::set_camera(std::shared_ptr<::Instance::Camera> camera_) {
@@ -356,12 +188,28 @@ void Pathtracer::use_bvh(bool bvh) {
 	scene_use_bvh = bvh;
 }
 
+void Pathtracer::use_denoiser(bool use_denoiser) {
+	denoise = use_denoiser;
+}
+
+void Pathtracer::sample_delta_lights(uint32_t shadow_rays) {
+	delta_light_samples = shadow_rays;
+}
+
+float Pathtracer::denoise_time() const {
+	return denoise_seconds;
+}
+
+void Pathtracer::use_aovs(uint32_t mask) {
+	aov_mask = mask;
+}
+
 void Pathtracer::log_ray(const Ray& ray, float t, Spectrum color) {
 	std::lock_guard<std::mutex> lock(ray_log_mut);
 	ray_log.push_back(Ray_Log{ray, t, color});
 }
 
-void Pathtracer::accumulate(Tile const &tile, const HDR_Image& data) {
+void Pathtracer::accumulate(Tile const &tile, const HDR_Image& data, std::vector< float > const &aov_sums) {
 
 	std::lock_guard<std::mutex> lock(accumulator_mut);
 
@@ -372,7 +220,7 @@ void Pathtracer::accumulate(Tile const &tile, const HDR_Image& data) {
 			std::array< int64_t, 3 > &spectrum = accumulator[idx];
 
 			//convert to 40.24 fixed point and add:
-			const Spectrum& n = data.at(px, py);
+			const Spectrum& n = data.at(px - tile.x_begin, py - tile.y_begin);
 			spectrum[0] += int64_t(n.r * (1ll<<24ll));
 			spectrum[1] += int64_t(n.g * (1ll<<24ll));
 			spectrum[2] += int64_t(n.b * (1ll<<24ll));
@@ -381,10 +229,29 @@ void Pathtracer::accumulate(Tile const &tile, const HDR_Image& data) {
 			samples += (tile.s_end - tile.s_begin);
 		}
 	}
+
+	if (uint32_t stride = aov_layout.stride) {
+		uint32_t tile_w = tile.x_end - tile.x_begin;
+		for (uint32_t py = tile.y_begin; py < tile.y_end; ++py) {
+			for (uint32_t px = tile.x_begin; px < tile.x_end; ++px) {
+				uint32_t idx = py * accumulator_w + px;
+				float const *values = &aov_sums[((py - tile.y_begin) * tile_w + (px - tile.x_begin)) * stride];
+				int64_t *sums = &aov_accumulator[size_t(idx) * stride];
+				for (uint32_t i = 0; i < stride; ++i) {
+					sums[i] += int64_t(values[i] * (1ll<<24ll));
+				}
+				aov_samples[idx] += (tile.s_end - tile.s_begin);
+			}
+		}
+	}
+
+	tile_done[tile.index] = 1;
 }
 
-HDR_Image Pathtracer::accumulator_to_image() const {
-	HDR_Image image(accumulator_w, accumulator_h, Spectrum(0.0f, 0.0f, 0.0f));
+//divide accumulated spectrums by sample counts:
+static HDR_Image resolve_accumulator(uint32_t w, uint32_t h, std::vector< std::array< int64_t, 3 > > const &accumulator,
+                                     std::vector< uint32_t > const &accumulator_samples) {
+	HDR_Image image(w, h, Spectrum(0.0f, 0.0f, 0.0f));
 	for (uint32_t i = 0; i < uint32_t(accumulator.size()); ++i) {
 		//(doing the conversion in double precision is probably overkill)
 		if (accumulator_samples[i] > 0) {
@@ -398,17 +265,118 @@ HDR_Image Pathtracer::accumulator_to_image() const {
 	return image;
 }
 
+//divide accumulated AOV sums by sample counts, making a layer for each channel in mask:
+static std::vector< AOV_Layer > resolve_aovs(uint32_t w, uint32_t h, uint32_t mask, AOV_Layout const &layout,
+                                             std::vector< int64_t > const &aov_accumulator, std::vector< uint32_t > const &aov_samples,
+                                             std::vector< uint32_t > const &accumulator_samples) {
+	std::vector< AOV_Layer > layers;
+	auto add_layer = [&](std::string const &name, std::vector< std::string > const &channels) -> AOV_Layer & {
+		AOV_Layer &layer = layers.emplace_back();
+		layer.name = name;
+		layer.channels = channels;
+		layer.w = w;
+		layer.h = h;
+		layer.data.assign(size_t(w) * h * channels.size(), 0.0f);
+		return layer;
+	};
+	auto resolve = [&](AOV::Channel channel, std::string const &name, std::vector< std::string > const &channels, uint32_t offset) {
+		if (!(mask & channel) || !(layout.mask & channel)) return;
+		AOV_Layer &layer = add_layer(name, channels);
+		uint32_t count = uint32_t(channels.size());
+		for (uint32_t i = 0; i < w * h; ++i) {
+			if (aov_samples[i] == 0) continue;
+			double scale = 1.0 / double(1ll<<24ll) / double(aov_samples[i]);
+			for (uint32_t c = 0; c < count; ++c) {
+				layer.data[size_t(i) * count + c] = float(aov_accumulator[size_t(i) * layout.stride + offset + c] * scale);
+			}
+		}
+	};
+	//(names follow the usual EXR conventions, so compositors pick them up)
+	resolve(AOV::Depth, "", {"Z"}, layout.depth);
+	resolve(AOV::Normal, "N", {"X", "Y", "Z"}, layout.normal);
+	resolve(AOV::Albedo, "albedo", {"R", "G", "B"}, layout.albedo);
+	resolve(AOV::Direct, "direct", {"R", "G", "B"}, layout.direct);
+	resolve(AOV::Indirect, "indirect", {"R", "G", "B"}, layout.indirect);
+	if (mask & AOV::Samples) {
+		AOV_Layer &layer = add_layer("samples", {"Y"});
+		for (uint32_t i = 0; i < w * h; ++i) {
+			layer.data[i] = float(accumulator_samples[i]);
+		}
+	}
+	return layers;
+}
+
+HDR_Image Pathtracer::accumulator_to_image() const {
+	return resolve_accumulator(accumulator_w, accumulator_h, accumulator, accumulator_samples);
+}
+
+HDR_Image Pathtracer::final_image() {
+	if (!denoise) return accumulator_to_image();
+	Timer denoise_timer;
+	HDR_Image denoised = denoised_image();
+	denoise_seconds = denoise_timer.s();
+	return denoised;
+}
+
+HDR_Image Pathtracer::denoised_image() const {
+	assert((aov_layout.mask & AOV::Guides) == AOV::Guides);
+	//only the crop window has samples, so only it gets filtered (otherwise the empty film around it would bleed in):
+	Camera::Film_Rect rect = camera.crop_rect();
+	HDR_Image image = accumulator_to_image();
+	HDR_Image color(rect.width(), rect.height());
+	HDR_Image albedo(rect.width(), rect.height()), normal(rect.width(), rect.height()), depth(rect.width(), rect.height());
+	for (uint32_t y = rect.y_begin; y < rect.y_end; ++y) {
+		for (uint32_t x = rect.x_begin; x < rect.x_end; ++x) {
+			uint32_t i = y * accumulator_w + x;
+			uint32_t lx = x - rect.x_begin, ly = y - rect.y_begin;
+			color.at(lx, ly) = image.at(i);
+			if (aov_samples[i] == 0) continue;
+			int64_t const *sums = &aov_accumulator[size_t(i) * aov_layout.stride];
+			double scale = 1.0 / double(1ll<<24ll) / double(aov_samples[i]);
+			auto at = [&](uint32_t offset) { return float(sums[offset] * scale); };
+			albedo.at(lx, ly) = Spectrum(at(aov_layout.albedo), at(aov_layout.albedo + 1), at(aov_layout.albedo + 2));
+			normal.at(lx, ly) = Spectrum(at(aov_layout.normal), at(aov_layout.normal + 1), at(aov_layout.normal + 2));
+			depth.at(lx, ly) = Spectrum(at(aov_layout.depth), 0.0f, 0.0f);
+		}
+	}
+	HDR_Image denoised = denoiser.denoise(color, albedo, normal, depth, thread_pool);
+	for (uint32_t y = rect.y_begin; y < rect.y_end; ++y) {
+		for (uint32_t x = rect.x_begin; x < rect.x_end; ++x) {
+			image.at(x, y) = denoised.at(x - rect.x_begin, y - rect.y_begin);
+		}
+	}
+	return image;
+}
+
+std::vector< AOV_Layer > Pathtracer::aov_layers() {
+	std::lock_guard<std::mutex> lock(accumulator_mut);
+	return resolve_aovs(accumulator_w, accumulator_h, aov_mask, aov_layout, aov_accumulator, aov_samples, accumulator_samples);
+}
+
+HDR_Image Pathtracer::Checkpoint::image() const {
+	return resolve_accumulator(width, height, accumulator, accumulator_samples);
+}
+
+std::vector< AOV_Layer > Pathtracer::Checkpoint::aov_layers() const {
+	return resolve_aovs(width, height, aov_mask, AOV_Layout(aov_mask), aov_accumulator, aov_samples, accumulator_samples);
+}
+
 void Pathtracer::do_trace(RNG &rng, Tile const &tile) {
 	//A3T1 - Step 0: understand this function!
 
-	HDR_Image sample(camera.film.width, camera.film.height, Spectrum(0.0f, 0.0f, 0.0f));
+	HDR_Image sample(tile.x_end - tile.x_begin, tile.y_end - tile.y_begin, Spectrum(0.0f, 0.0f, 0.0f));
+	//(AOVs are only recorded if some are being accumulated)
+	bool record_aovs = aov_layout.stride > 0;
+	std::vector< float > aov_sums(size_t(sample.w) * sample.h * aov_layout.stride, 0.0f);
 	for (uint32_t py = tile.y_begin; py < tile.y_end; ++py) {
 		for (uint32_t px = tile.x_begin; px < tile.x_end; ++px) {
 			for (uint32_t s = tile.s_begin; s < tile.s_end; ++s) {
+				if (cancel_flag && *cancel_flag) return;
 
 				//generate a camera ray for this pixel:
 				auto [ray, pdf] = camera.sample_ray(rng, px, py);
 				ray.transform(camera_to_world);
+				Stats::camera_ray();
 
 				//if LOG_CAMERA_RAYS is set, add ray to the debug log with some small probability:
 				if constexpr (LOG_CAMERA_RAYS) {
@@ -418,19 +386,26 @@ void Pathtracer::do_trace(RNG &rng, Tile const &tile) {
 				}
 
 				//do path tracing:
-				auto [emissive, light] = trace(rng, ray);
+				Sample_AOVs aovs;
+				auto [emissive, light] = trace(rng, ray, record_aovs ? &aovs : nullptr);
+				if (record_aovs) {
+					size_t pixel = size_t(py - tile.y_begin) * sample.w + (px - tile.x_begin);
+					aov_layout.add(&aov_sums[pixel * aov_layout.stride], aovs, pdf);
+				}
 
 				Spectrum p = (emissive + light) / pdf;
 
 				if (p.valid()) {
-					sample.at(px, py) += p;
+					sample.at(px - tile.x_begin, py - tile.y_begin) += p;
 				}
-
-				if (cancel_flag && *cancel_flag) return;
 			}
 		}
 	}
-	accumulate(tile, sample);
+	accumulate(tile, sample, aov_sums);
+}
+
+std::shared_ptr<Render_Session const> Pathtracer::current_session() const {
+	return session;
 }
 
 bool Pathtracer::in_progress() const {
@@ -441,8 +416,165 @@ std::pair<float, float> Pathtracer::completion_time() const {
 	return {build_timer.s(), render_timer.s()};
 }
 
+Pathtracer::Tile_Plan Pathtracer::tile_plan() const {
+	return plan;
+}
+
+void Pathtracer::checkpoint_to(std::string const &filename, float interval_seconds) {
+	std::lock_guard<std::mutex> lock(accumulator_mut);
+	checkpoint_file = filename;
+	checkpoint_interval = interval_seconds;
+}
+
+void Pathtracer::resume(Checkpoint&& checkpoint) {
+	resume_from = std::move(checkpoint);
+}
+
+void Pathtracer::set_shard(uint32_t index, uint32_t count) {
+	assert(count >= 1 && index < count);
+	shard_index = index;
+	shard_count = count;
+}
+
+Pathtracer::Checkpoint Pathtracer::snapshot_checkpoint(uint64_t *sequence) {
+	//NOTE: called with accumulator_mut held, so accumulator and tile_done agree
+	Checkpoint checkpoint;
+	checkpoint.width = accumulator_w;
+	checkpoint.height = accumulator_h;
+	checkpoint.samples = camera.film.samples;
+	checkpoint.max_ray_depth = camera.film.max_ray_depth;
+	checkpoint.plan = plan;
+	checkpoint.tiles = render_tiles;
+	checkpoint.done = tile_done;
+	checkpoint.accumulator = accumulator;
+	checkpoint.accumulator_samples = accumulator_samples;
+	if (aov_layout.stride > 0 || (aov_mask & AOV::Samples)) {
+		checkpoint.aov_mask = aov_layout.mask | (aov_mask & AOV::Samples);
+		checkpoint.aov_accumulator = aov_accumulator;
+		checkpoint.aov_samples = aov_samples;
+	}
+	*sequence = ++checkpoint_snapshots;
+	checkpoint_timer.reset();
+	return checkpoint;
+}
+
+void Pathtracer::save_checkpoint(Checkpoint const &checkpoint, uint64_t sequence) {
+	//(snapshots taken later may already be saved, and must not be replaced by this older one)
+	std::lock_guard<std::mutex> lock(checkpoint_save_mut);
+	if (sequence <= checkpoint_saved) return;
+	try {
+		checkpoint.save(checkpoint_file);
+	} catch (std::exception const &e) {
+		warn("Failed to save checkpoint: %s", e.what());
+	}
+	checkpoint_saved = sequence;
+}
+
+Render_Stats Pathtracer::stats() {
+	std::lock_guard<std::mutex> lock(accumulator_mut);
+	return render_stats;
+}
+
+Pathtracer::Tile_Plan Pathtracer::plan_tiles(uint32_t width, uint32_t height, uint32_t samples, uint32_t threads) {
+	//tune these to your liking:
+	// more tiles per thread == better load balancing and quicker feedback but also more overhead
+	constexpr uint32_t tiles_per_thread = 16;
+	constexpr uint32_t min_tile_size = 16;
+	constexpr uint32_t max_tile_size = 256;
+	//cap on samples per tile, so progress gets reported regularly even at high sample counts:
+	constexpr uint32_t max_tile_samples = 128;
+
+	auto ceil_div = [](uint32_t a, uint32_t b) { return (a + b - 1) / b; };
+
+	Tile_Plan ret;
+	ret.threads = std::max(threads, 1u);
+	width = std::max(width, 1u);
+	height = std::max(height, 1u);
+
+	uint32_t target_tiles = ret.threads * tiles_per_thread;
+
+	//square tiles (multiple of 8 pixels on a side) sized so the image alone makes about target_tiles tiles:
+	float side = std::sqrt(float(width) * float(height) / float(target_tiles));
+	uint32_t size = std::clamp(8u * uint32_t(std::ceil(side / 8.0f)), min_tile_size, max_tile_size);
+	ret.tile_width = std::min(size, width);
+	ret.tile_height = std::min(size, height);
+
+	//small images don't have enough pixels to keep every thread busy, so split samples as well:
+	uint32_t pixel_tiles = ceil_div(width, ret.tile_width) * ceil_div(height, ret.tile_height);
+	uint32_t sample_slices = ceil_div(target_tiles, pixel_tiles);
+	ret.tile_samples = std::clamp(ceil_div(samples, sample_slices), 1u, max_tile_samples);
+
+	return ret;
+}
+
+std::vector< Pathtracer::Tile > Pathtracer::make_tiles(Tile_Plan &plan_, Camera::Film_Rect const &rect, uint32_t samples) {
+	//the last (threads * tail_tiles_per_thread) tiles get split into quarters,
+	// so that all threads run out of work at about the same time:
+	constexpr uint32_t tail_tiles_per_thread = 2;
+
+	//interleave the bits of x and y to get position along a Morton (Z-order) curve:
+	auto morton = [](uint32_t x, uint32_t y) {
+		auto spread = [](uint64_t v) {
+			v &= 0xffffffffull;
+			v = (v | (v << 16)) & 0x0000ffff0000ffffull;
+			v = (v | (v << 8)) & 0x00ff00ff00ff00ffull;
+			v = (v | (v << 4)) & 0x0f0f0f0f0f0f0f0full;
+			v = (v | (v << 2)) & 0x3333333333333333ull;
+			v = (v | (v << 1)) & 0x5555555555555555ull;
+			return v;
+		};
+		return spread(x) | (spread(y) << 1);
+	};
+
+	//tile locations, in Morton order so that consecutive tiles look at nearby parts of the scene:
+	std::vector< std::pair< uint32_t, uint32_t > > locations;
+	for (uint32_t y_begin = rect.y_begin; y_begin < rect.y_end; y_begin += plan_.tile_height) {
+		for (uint32_t x_begin = rect.x_begin; x_begin < rect.x_end; x_begin += plan_.tile_width) {
+			locations.emplace_back(x_begin, y_begin);
+		}
+	}
+	std::sort(locations.begin(), locations.end(), [&](auto const &a, auto const &b) {
+		return morton((a.first - rect.x_begin) / plan_.tile_width, (a.second - rect.y_begin) / plan_.tile_height)
+		     < morton((b.first - rect.x_begin) / plan_.tile_width, (b.second - rect.y_begin) / plan_.tile_height);
+	});
+
+	//every location gets a slice of samples before any location gets its next slice:
+	// (so the whole image refines together)
+	std::vector< Tile > tiles;
+	for (uint32_t s_begin = 0; s_begin < samples; s_begin += plan_.tile_samples) {
+		uint32_t s_end = std::min(s_begin + plan_.tile_samples, samples);
+		for (auto const &[x_begin, y_begin] : locations) {
+			uint32_t x_end = std::min(x_begin + plan_.tile_width, rect.x_end);
+			uint32_t y_end = std::min(y_begin + plan_.tile_height, rect.y_end);
+			tiles.emplace_back(Tile{0, x_begin, x_end, y_begin, y_end, s_begin, s_end});
+		}
+	}
+
+	//split the tail tiles into (up to) four pieces:
+	size_t tail = std::min(tiles.size(), size_t(plan_.threads) * tail_tiles_per_thread);
+	std::vector< Tile > split(tiles.begin(), tiles.end() - tail);
+	plan_.split_tiles = 0;
+	for (auto t = tiles.end() - tail; t != tiles.end(); ++t) {
+		uint32_t x_mid = (t->x_begin + t->x_end) / 2;
+		uint32_t y_mid = (t->y_begin + t->y_end) / 2;
+		if (x_mid == t->x_begin || y_mid == t->y_begin) {
+			split.emplace_back(*t);
+			continue;
+		}
+		split.emplace_back(Tile{0, t->x_begin, x_mid, t->y_begin, y_mid, t->s_begin, t->s_end});
+		split.emplace_back(Tile{0, x_mid, t->x_end, t->y_begin, y_mid, t->s_begin, t->s_end});
+		split.emplace_back(Tile{0, t->x_begin, x_mid, y_mid, t->y_end, t->s_begin, t->s_end});
+		split.emplace_back(Tile{0, x_mid, t->x_end, y_mid, t->y_end, t->s_begin, t->s_end});
+		plan_.split_tiles += 4;
+	}
+
+	plan_.tiles = uint32_t(split.size());
+	return split;
+}
+
 uint32_t Pathtracer::visualize_bvh(GL::Lines& lines, GL::Lines& active, uint32_t depth) {
-	return scene.visualize(lines, active, depth, Mat4::I);
+	if (!session) return 0;
+	return session->scene.visualize(lines, active, depth, Mat4::I);
 }
 
 void Pathtracer::render(Scene& scene_, std::shared_ptr<::Instance::Camera> camera_,
@@ -451,8 +583,63 @@ void Pathtracer::render(Scene& scene_, std::shared_ptr<::Instance::Camera> camer
 	assert(camera_);
 	assert(!camera_->camera.expired());
 
+	//(stop tracing before replacing the session the tiles are using)
+	cancel();
+
+	//adding samples to the same film keeps using the current session; anything else starts from a fresh build:
+	Camera const &film_camera = *camera_->camera.lock();
+	if (!add_samples || !session || resume_from || accumulator_w != film_camera.film.width || accumulator_h != film_camera.film.height) {
+		build_scene(scene_);
+	}
+
+	render(session, std::move(camera_), std::move(f), quit, add_samples);
+}
+
+void Pathtracer::render(std::shared_ptr<Render_Session const> session_, std::shared_ptr<::Instance::Camera> camera_,
+                        std::function<void(Render_Report &&)>&& f, bool* quit,
+                        bool add_samples) {
+	for (auto const &tile : begin_render(std::move(session_), std::move(camera_), std::move(f), quit, add_samples)) {
+		enqueue_tile(tile);
+	}
+}
+
+void Pathtracer::render_batch(std::shared_ptr<Render_Session const> session, std::vector< Batch_Item > &&items) {
+	std::vector< std::vector< Tile > > tiles;
+	for (auto &item : items) {
+		assert(item.pathtracer->thread_pool == items[0].pathtracer->thread_pool && "batched pathtracers share a thread pool");
+		tiles.emplace_back(item.pathtracer->begin_render(session, std::move(item.camera), std::move(item.report), item.quit, false));
+	}
+
+	//enqueue tiles round-robin, so all cameras make progress together:
+	for (size_t i = 0; true; ++i) {
+		bool any = false;
+		for (size_t b = 0; b < items.size(); ++b) {
+			if (i >= tiles[b].size()) continue;
+			items[b].pathtracer->enqueue_tile(tiles[b][i]);
+			any = true;
+		}
+		if (!any) break;
+	}
+}
+
+std::vector< Pathtracer::Tile > Pathtracer::begin_render(std::shared_ptr<Render_Session const> session_,
+                                                         std::shared_ptr<::Instance::Camera> camera_,
+                                                         std::function<void(Render_Report &&)>&& f, bool* quit,
+                                                         bool add_samples) {
+	assert(session_);
+	assert(camera_);
+	assert(!camera_->camera.expired());
+
 	cancel();
 	cancel_flag = quit;
+
+	if (session_ != session) {
+		//(a session built elsewhere took no time to build here)
+		session = std::move(session_);
+		build_timer.reset();
+		build_timer.pause();
+		add_samples = false;
+	}
 	report_fn = std::move(f);
 
 	//copy camera to local camera:
@@ -462,10 +649,21 @@ void Pathtracer::render(Scene& scene_, std::shared_ptr<::Instance::Camera> camer
 		add_samples = false;
 	}
 
+	std::optional< Checkpoint > resuming = std::move(resume_from);
+	resume_from.reset();
+	if (resuming) {
+		add_samples = false;
+		if (resuming->width != camera.film.width || resuming->height != camera.film.height
+		 || resuming->samples != camera.film.samples || resuming->max_ray_depth != camera.film.max_ray_depth) {
+			warn("Checkpoint is for a different film; starting the render over.");
+			resuming.reset();
+		} else if (resuming->bounds() != camera.crop_rect()) {
+			warn("Checkpoint is for a different crop window; starting the render over.");
+			resuming.reset();
+		}
+	}
+
 	if (!add_samples) {
-		build_timer.reset();
-		build_scene(scene_);
-		build_timer.pause();
 		accumulator_w = camera.film.width;
 		accumulator_h = camera.film.height;
 		std::array< int64_t, 3 > zero;
@@ -474,76 +672,168 @@ void Pathtracer::render(Scene& scene_, std::shared_ptr<::Instance::Camera> camer
 		accumulator_samples.assign(accumulator_w * accumulator_h, 0);
 		ray_log.clear();
 	}
+	//(denoiser guides are accumulated whether or not they were asked for as outputs)
+	AOV_Layout layout(aov_mask | (denoise ? uint32_t(AOV::Guides) : 0u));
+	if (!add_samples || layout.mask != aov_layout.mask) {
+		aov_layout = layout;
+		aov_accumulator.assign(size_t(accumulator_w) * accumulator_h * aov_layout.stride, 0);
+		aov_samples.assign(aov_layout.stride ? accumulator_w * accumulator_h : 0, 0);
+	}
+	denoise_seconds = 0.0f;
 	render_timer.reset();
+	render_stats = Render_Stats();
+	sample_pass = add_samples ? sample_pass + 1 : 0;
+
+	if (resuming) {
+		//pick up the accumulated samples and tiles from the checkpoint:
+		accumulator = std::move(resuming->accumulator);
+		accumulator_samples = std::move(resuming->accumulator_samples);
+		if (AOV_Layout(resuming->aov_mask).mask == aov_layout.mask) {
+			aov_accumulator = std::move(resuming->aov_accumulator);
+			aov_samples = std::move(resuming->aov_samples);
+		} else if (aov_layout.stride > 0) {
+			warn("Checkpoint records different AOVs; AOVs will only cover tiles traced from now on.");
+		}
+		plan = resuming->plan;
+		render_tiles = std::move(resuming->tiles);
+		tile_done = std::move(resuming->done);
+	} else {
+		//divide image into tiles for rendering:
+		// (feedback will be posted back to the UI after every tile completes)
+		Camera::Film_Rect rect = camera.crop_rect();
+		if (shard_count > 1) {
+			//shards must agree on the tiles no matter what machine they run on:
+			constexpr uint32_t threads_per_shard = 16;
+			plan = plan_tiles(rect.width(), rect.height(), camera.film.samples, shard_count * threads_per_shard);
+		} else {
+			plan = plan_tiles(rect.width(), rect.height(), camera.film.samples, thread_pool->size());
+		}
+		//(only pixels inside the crop window get tiles)
+		render_tiles = make_tiles(plan, rect, camera.film.samples);
+
+		//get a pseudo-random stream to seed the tiles with:
+		RNG seeds_rng;
+		if (RNG::fixed_seed != 0) seeds_rng.seed(RNG::fixed_seed + sample_pass * 0x9e3779b9u);
+		for (uint32_t i = 0; i < render_tiles.size(); ++i) {
+			render_tiles[i].seed = seeds_rng.mt();
+			render_tiles[i].index = i;
+		}
+		tile_done.assign(render_tiles.size(), 0);
+	}
+	render_stats.plan = plan;
 
-	//divide image into tiles for rendering:
-	// (feedback will be posted back to the UI after every tile completes)
 	std::vector< Tile > tiles;
+	for (auto const &tile : render_tiles) {
+		if (tile_done[tile.index]) continue;
+		if (tile.index % shard_count != shard_index) continue;
+		tiles.emplace_back(tile);
+	}
 
-	//tune these to your liking:
-	// lower values == quicker feedback but also generally more overhead
-	constexpr uint32_t tile_width = 100;
-	constexpr uint32_t tile_height = 100;
-	constexpr uint32_t tile_samples = 50;
-
-	//get a pseudo-random stream to seed the tiles with:
-	RNG seeds_rng;
-	if (RNG::fixed_seed != 0) seeds_rng.seed(RNG::fixed_seed);
-
-	for (uint32_t y_begin = 0; y_begin < camera.film.height; y_begin += tile_height) {
-		uint32_t y_end = std::min(y_begin + tile_height, camera.film.height);
-		for (uint32_t x_begin = 0; x_begin < camera.film.width; x_begin += tile_width) {
-			uint32_t x_end = std::min(x_begin + tile_width, camera.film.width);
-			for (uint32_t s_begin = 0; s_begin < camera.film.samples; s_begin += tile_samples) {
-				uint32_t s_end = std::min(s_begin + tile_samples, camera.film.samples);
-				uint32_t seed = seeds_rng.mt();
-				tiles.emplace_back(Tile{seed, x_begin, x_end, y_begin, y_end, s_begin, s_end});
-			}
+	checkpoint_timer.reset();
+
+	//nothing left to do (e.g., resumed a finished render, or a shard with no tiles):
+	// (the checkpoint is still written, so every shard of a render leaves a file for --merge)
+	if (tiles.empty()) {
+		render_timer.pause();
+		std::optional< Checkpoint > checkpoint;
+		uint64_t sequence = 0;
+		{
+			std::lock_guard<std::mutex> lock(accumulator_mut);
+			if (checkpoint_file != "") checkpoint = snapshot_checkpoint(&sequence);
+			report_fn({1.0f, final_image()});
 		}
+		if (checkpoint) save_checkpoint(*checkpoint, sequence);
+		return {};
 	}
 
-	//a bit of flare -- do the tiles in a fancy order:
-	std::stable_sort(tiles.begin(), tiles.end(), [this](Tile const &a, Tile const &b){
-		//do tiles from the inside out:
-		auto distance_from_center = [this](Tile const &t) {
-			return Vec2(
-				0.5f * (t.x_begin + t.x_end) - camera.film.width * 0.5f, 
-				0.5f * (t.y_begin + t.y_end) - camera.film.height * 0.5f
-			).norm();
-		};
-		float da = distance_from_center(a);
-		float db = distance_from_center(b);
-		if (da != db) return da < db;
-		//make sure to do the tiles at the same location in order of s_begin:
-		// (since 'accumulate' uses it for weight computation)
-		return a.s_begin < b.s_begin;
-	});
+	total_tiles = uint32_t(tiles.size());
+	return tiles;
+}
 
+void Pathtracer::enqueue_tile(Tile const &tile) {
+	//tiles remember which render they belong to, so cancel() can have queued ones skipped:
+	uint32_t tile_generation = generation.load();
+	{
+		std::lock_guard<std::mutex> lock(queued_tiles_mut);
+		queued_tiles += 1;
+	}
 
-	//actually launch the render jobs:
-	total_tiles = uint32_t(tiles.size());
-	for (auto const &tile : tiles) {
-		//queue up a render job per-tile:
-		thread_pool.enqueue([tile, this]() {
-			RNG rng(tile.seed);
-			do_trace(rng, tile);
-
-			uint32_t traced = traced_tiles.fetch_add(1) + 1;
-			if (traced == total_tiles) {
-				std::lock_guard<std::mutex> lock(accumulator_mut);
-				render_timer.pause();
-				report_fn({1.0f, accumulator_to_image()});
+	thread_pool->enqueue([tile, tile_generation, this]() {
+		auto run_tile = [&]() {
+			if (tile_generation != generation.load()) return;
+
+			//once quit is set, remaining tiles are only counted off, so the render finishes with a single final report:
+			auto quitting = [&]() { return cancel_flag && *cancel_flag; };
+			bool skipped = quitting();
+
+			auto trace_tile = [&]() {
+				if (skipped) return;
+				RNG rng(tile.seed);
+				do_trace(rng, tile);
+			};
+
+			Render_Stats tile_stats;
+			if constexpr (COLLECT_STATS) {
+				Timer tile_timer;
+				Stats::local = &tile_stats;
+				trace_tile();
+				Stats::local = nullptr;
+				tile_stats.add_tile(tile_timer.s());
 			} else {
+				trace_tile();
+			}
+
+			//checkpoints are copied with accumulator_mut held, but written after it is released,
+			// so other tiles don't wait on the disk:
+			std::optional< Checkpoint > checkpoint;
+			uint64_t sequence = 0;
+			uint32_t traced;
+			{
 				std::lock_guard<std::mutex> lock(accumulator_mut);
-				report_fn({traced / float(total_tiles), accumulator_to_image()});
+				//(don't report tiles that were cut short by cancel())
+				if (tile_generation != generation.load()) return;
+				if constexpr (COLLECT_STATS) if (!skipped) render_stats += tile_stats;
+
+				//(traced_tiles is only updated after reporting, so in_progress() stays true until the final report is done)
+				traced = traced_tiles.load() + 1;
+				if (traced == total_tiles) {
+					render_timer.pause();
+					render_stats.seconds = render_timer.s();
+					if (checkpoint_file != "") checkpoint = snapshot_checkpoint(&sequence);
+					report_fn({1.0f, final_image()});
+				} else {
+					if (!quitting()) {
+						if (checkpoint_file != "" && checkpoint_timer.s() >= checkpoint_interval) checkpoint = snapshot_checkpoint(&sequence);
+						report_fn({traced / float(total_tiles), accumulator_to_image()});
+					}
+					traced_tiles = traced;
+				}
 			}
-		});
-	}
+			if (checkpoint) save_checkpoint(*checkpoint, sequence);
+			//(the last tile finishes the render only once its checkpoint is on disk)
+			if (traced == total_tiles) traced_tiles = traced;
+		};
+		run_tile();
+
+		std::lock_guard<std::mutex> lock(queued_tiles_mut);
+		queued_tiles -= 1;
+		queued_tiles_cv.notify_all();
+	});
 }
 
 void Pathtracer::cancel() {
 	if (cancel_flag) *cancel_flag = true;
-	thread_pool.clear();
+	generation += 1;
+	if (own_thread_pool) {
+		//(clearing drops queued tiles and waits for running ones)
+		own_thread_pool->clear();
+		std::lock_guard<std::mutex> lock(queued_tiles_mut);
+		queued_tiles = 0;
+	} else {
+		//other pathtracers' tiles are on the pool too, so wait for this one's tiles to finish (or be skipped):
+		std::unique_lock<std::mutex> lock(queued_tiles_mut);
+		queued_tiles_cv.wait(lock, [this]() { return queued_tiles == 0; });
+	}
 	traced_tiles = 0;
 	total_tiles = 0;
 	if (cancel_flag) *cancel_flag = false;
@@ -557,69 +847,104 @@ const std::vector<Pathtracer::Ray_Log> Pathtracer::copy_ray_log() {
 
 Vec3 Pathtracer::sample_area_lights(RNG &rng, Vec3 from) {
 
+	List<Instance> const &emissive_objects = session->emissive_objects;
+	Environment_Map const &env_map = session->env_map;
 	size_t n_emissive = emissive_objects.n_primitives();
-	size_t n_env = env_lights.size();
+	bool has_env = !env_map.empty();
 
-	auto sample_env_lights = [&]() {
-		int32_t n = rng.integer(0, static_cast<int32_t>(n_env));
-		auto it = env_lights.begin();
-		std::advance(it, n);
-		return it->second->sample(rng);
-	};
-
-	if (n_emissive > 0 && n_env > 0) {
+	if (n_emissive > 0 && has_env) {
 		if (rng.coin_flip(0.5f)) {
-			return sample_env_lights();
+			return env_map.sample(rng);
 		} else {
 			return emissive_objects.sample(rng, from);
 		}
 	}
-	if (n_env > 0) {
-		return sample_env_lights();
+	if (has_env) {
+		return env_map.sample(rng);
 	}
 	return emissive_objects.sample(rng, from);
 }
 
 float Pathtracer::area_lights_pdf(Vec3 from, Vec3 dir) {
 
+	List<Instance> const &emissive_objects = session->emissive_objects;
+	Environment_Map const &env_map = session->env_map;
 	size_t n_emissive = emissive_objects.n_primitives();
-	size_t n_env = env_lights.size();
+	bool has_env = !env_map.empty();
 
-	auto env_lights_pdf = [&]() {
-		float pdf = 0.0f;
-		for (auto& light : env_lights) {
-			pdf += light.second->pdf(dir);
-		}
-		return n_env ? pdf / n_env : 0.0f;
-	};
-
-	uint32_t n_strategies = (n_emissive > 0) + (n_env > 0);
-	float pdf = emissive_objects.pdf(Ray(from, dir)) + env_lights_pdf();
+	uint32_t n_strategies = (n_emissive > 0) + has_env;
+	float pdf = emissive_objects.pdf(Ray(from, dir)) + env_map.pdf(dir);
 
 	return n_strategies ? pdf / n_strategies : 0.0f;
 }
 
-Spectrum Pathtracer::sum_delta_lights(const Shading_Info& hit) {
+Spectrum Pathtracer::sum_delta_lights(RNG &rng, const Shading_Info& hit) {
 
 	if (hit.bsdf.is_specular()) return {};
 
-	Spectrum radiance;
-	for (auto& light : point_lights) {
-		Delta_Lights::Incoming incoming = light.incoming(hit.pos);
-		Vec3 in_dir = hit.world_to_object.rotate(incoming.direction);
+	//only lights that might reach this point:
+	Light_Grid::Range candidates = session->light_grid.lights_at(hit.pos);
+
+	if (delta_light_samples == 0 || candidates.size() <= delta_light_samples) {
+		Spectrum radiance;
+		for (uint32_t index : candidates) {
+			auto& light = session->point_lights[index];
+			Delta_Lights::Incoming incoming = light.incoming(hit.pos);
+			Vec3 in_dir = hit.world_to_object.rotate(incoming.direction);
+
+			Spectrum attenuation = hit.bsdf.evaluate(hit.out_dir, in_dir, hit.uv, hit.footprint);
+			if (attenuation.luma() == 0.0f) continue;
+
+			Ray shadow_ray(hit.pos, incoming.direction, Vec2{EPS_F, incoming.distance - EPS_F});
+
+			Stats::shadow_ray();
+			Trace shadow = session->scene.hit(shadow_ray);
+			if (!shadow.hit) {
+				radiance += attenuation * incoming.radiance;
+			}
+		}
+		return radiance;
+	}
 
-		Spectrum attenuation = hit.bsdf.evaluate(hit.out_dir, in_dir, hit.uv);
-		if (attenuation.luma() == 0.0f) continue;
+	//too many lights to trace them all, so use resampled importance sampling: for each shadow ray, draw a
+	// few candidates uniformly, keep one in proportion to its unshadowed contribution (a one-entry weighted
+	// reservoir), and trace only that one. The weights make the estimate unbiased.
+	Spectrum radiance;
+	uint32_t count = candidates.size();
+	for (uint32_t s = 0; s < delta_light_samples; ++s) {
+		Delta_Lights::Incoming chosen{};
+		Spectrum chosen_contribution;
+		float chosen_target = 0.0f;
+		float weight_sum = 0.0f;
+		for (uint32_t c = 0; c < DELTA_LIGHT_CANDIDATES; ++c) {
+			auto& light = session->point_lights[candidates[rng.integer(0, int32_t(count))]];
+			Delta_Lights::Incoming incoming = light.incoming(hit.pos);
+			Vec3 in_dir = hit.world_to_object.rotate(incoming.direction);
+			Spectrum contribution = hit.bsdf.evaluate(hit.out_dir, in_dir, hit.uv, hit.footprint) * incoming.radiance;
+
+			float target = contribution.luma();
+			if (!(target > 0.0f)) continue;
+			//(candidate pdf is 1 / count)
+			float weight = target * float(count);
+			weight_sum += weight;
+			if (rng.unit() * weight_sum < weight) {
+				chosen = incoming;
+				chosen_contribution = contribution;
+				chosen_target = target;
+			}
+		}
+		if (chosen_target == 0.0f) continue;
 
-		Ray shadow_ray(hit.pos, incoming.direction, Vec2{EPS_F, incoming.distance - EPS_F});
+		Ray shadow_ray(hit.pos, chosen.direction, Vec2{EPS_F, chosen.distance - EPS_F});
 
-		Trace shadow = scene.hit(shadow_ray);
+		Stats::shadow_ray();
+		Trace shadow = session->scene.hit(shadow_ray);
 		if (!shadow.hit) {
-			radiance += attenuation * incoming.radiance;
+			radiance += chosen_contribution * (weight_sum / (float(DELTA_LIGHT_CANDIDATES) * chosen_target));
 		}
 	}
 
-	return radiance;
+	return radiance * (1.0f / float(delta_light_samples));
 }
 
 } // namespace PT
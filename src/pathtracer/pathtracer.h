@@ -2,7 +2,9 @@
 #pragma once
 
 #include <atomic>
+#include <condition_variable>
 #include <mutex>
+#include <optional>
 #include <unordered_map>
 
 #include "../lib/mathlib.h"
@@ -13,6 +15,10 @@
 #include "../util/timer.h"
 
 #include "aggregate.h"
+#include "aov.h"
+#include "denoiser.h"
+#include "session.h"
+#include "stats.h"
 
 namespace PT {
 
@@ -24,6 +30,10 @@ public:
 		Vec3 pos, out_dir, normal;
 		Vec2 uv;
 		uint32_t depth = 0;
+		//texture filtering: width of the ray cone here (in uv units), for bsdf calls:
+		float footprint = 0.0f;
+		//...and the cone (in world units), for rays continuing from here:
+		float cone_width = 0.0f, cone_spread = 0.0f;
 	};
 	struct Ray_Log {
 		Ray ray;
@@ -32,28 +42,57 @@ public:
 	};
 
 	Pathtracer();
+	//trace tiles on a thread pool shared with other Pathtracers (e.g., for render_batch):
+	explicit Pathtracer(Thread_Pool &shared_pool);
 	~Pathtracer();
 
 	void use_bvh(bool use_bvh);
+	//record first-hit guides and denoise the final image of each render:
+	void use_denoiser(bool use_denoiser);
+	//estimate delta lights with (at most) this many shadow rays per shading point, picking lights at random
+	// in proportion to their unshadowed contribution (0, the default, sums every light exactly):
+	void sample_delta_lights(uint32_t shadow_rays);
+	Denoiser denoiser;
+	float denoise_time() const; //seconds spent denoising the most recent render
+	//accumulate extra per-pixel channels (a mask of AOV::Channel bits) alongside radiance:
+	void use_aovs(uint32_t mask);
+	//AOV channels from the most recent render, resolved to per-pixel averages (with proper locking):
+	std::vector< AOV_Layer > aov_layers();
 	uint32_t visualize_bvh(GL::Lines& lines, GL::Lines& active, uint32_t level);
 	const std::vector<Ray_Log> copy_ray_log(); //copy ray log (with proper locking)
 
 	using Render_Report = std::pair<float, HDR_Image>;
 	void render(Scene& scene, std::shared_ptr<::Instance::Camera> camera,
 	            std::function<void(Render_Report &&)>&& f, bool* quit, bool add_samples = false);
+	//render from an already-built session, skipping the scene build entirely:
+	// (any number of Pathtracers can render from the same session at the same time)
+	void render(std::shared_ptr<Render_Session const> session, std::shared_ptr<::Instance::Camera> camera,
+	            std::function<void(Render_Report &&)>&& f, bool* quit, bool add_samples = false);
+	//session used by the most recent render (can be passed to other renders of the same scene):
+	std::shared_ptr<Render_Session const> current_session() const;
+
+	//render several cameras from one session at once, with their tiles interleaved on one thread pool:
+	// (each Pathtracer -- which must all share the same pool -- keeps its own accumulator and reports to its own callback)
+	struct Batch_Item {
+		Pathtracer *pathtracer = nullptr;
+		std::shared_ptr<::Instance::Camera> camera;
+		std::function<void(Render_Report &&)> report;
+		bool *quit = nullptr;
+	};
+	static void render_batch(std::shared_ptr<Render_Session const> session, std::vector< Batch_Item > &&items);
 	
 	bool in_progress() const;
 	std::pair<float, float> completion_time() const;
 
-	Spectrum sample_direct_lighting_task4(RNG &rng, const Shading_Info& hit);
-	Spectrum sample_direct_lighting_task6(RNG &rng, const Shading_Info& hit);
-	Spectrum sample_indirect_lighting(RNG &rng, const Shading_Info& hit);
+	//how the most recent render() split the image into work items:
+	using Tile_Plan = PT::Tile_Plan;
+	//choose tile sizes for a given film and thread count:
+	static Tile_Plan plan_tiles(uint32_t width, uint32_t height, uint32_t samples, uint32_t threads);
+	Tile_Plan tile_plan() const;
 
-	void build_scene(Scene& scene);
-	void set_camera(std::shared_ptr<::Instance::Camera> camera); //in its own function so test code can call it
-
-private:
-	void cancel();
+	//counters from the most recent render() (with proper locking):
+	// (all zero if compiled with SCOTTY3D_NO_RENDER_STATS)
+	Render_Stats stats();
 
 	//a 'Tile' is a region of the image (in both pixel and sample space) to trace:
 	struct Tile {
@@ -61,17 +100,86 @@ private:
 		uint32_t x_begin = 0, x_end = 0;
 		uint32_t y_begin = 0, y_end = 0;
 		uint32_t s_begin = 0, s_end = 0;
+		uint32_t index = 0; //position in the render's tile list
+	};
+	//split the rect's pixels and [0,samples) into tiles as planned, filling in plan.tiles/split_tiles:
+	// (returns tiles in the order they should be traced, without seeds or indices)
+	static std::vector< Tile > make_tiles(Tile_Plan &plan, Camera::Film_Rect const &rect, uint32_t samples);
+
+	//everything needed to continue a partly-finished render:
+	struct Checkpoint {
+		uint32_t width = 0, height = 0, samples = 0, max_ray_depth = 0; //film the render was made with
+		Tile_Plan plan;
+		std::vector< Tile > tiles; //all tiles of the render (including seeds)
+		std::vector< uint8_t > done; //done[i] is 1 if tiles[i] has been accumulated
+		std::vector< std::array< int64_t, 3 > > accumulator;
+		std::vector< uint32_t > accumulator_samples;
+		//AOVs (if any were being recorded), laid out as by AOV_Layout(aov_mask):
+		uint32_t aov_mask = 0;
+		std::vector< int64_t > aov_accumulator;
+		std::vector< uint32_t > aov_samples;
+
+		uint32_t tiles_done() const;
+		//pixels covered by the tiles (i.e., the crop window the render was started with):
+		Camera::Film_Rect bounds() const;
+		//resolve accumulated samples to an image:
+		HDR_Image image() const;
+		std::vector< AOV_Layer > aov_layers() const;
+		//add the tiles done in another checkpoint of the same render (e.g., from another shard):
+		// (throws if the checkpoints are of different renders, record different AOVs, or both contain a tile)
+		void merge(Checkpoint const &other);
+
+		//file I/O:
+		static Checkpoint load(std::string const &filename); //throws on error
+		void save(std::string const &filename) const; //writes to a temporary file and renames, throws on error
 	};
+	//periodically (and on completion) save checkpoints during render() (empty filename disables):
+	void checkpoint_to(std::string const &filename, float interval_seconds);
+	//have the next render() continue from a checkpoint (rather than starting over):
+	// (checkpoint's film must match the camera passed to render())
+	void resume(Checkpoint&& checkpoint);
+
+	//only trace tiles with (tile.index % count == shard_index) [when count > 1], where shard_index = index:
+	// with count > 1, tiles are planned independent of the local thread count, so that all shards of a
+	// render (given the same RNG::fixed_seed) agree on the tiles and can be merged exactly
+	void set_shard(uint32_t index, uint32_t count);
+
+	Spectrum sample_direct_lighting_task4(RNG &rng, const Shading_Info& hit);
+	Spectrum sample_direct_lighting_task6(RNG &rng, const Shading_Info& hit);
+	Spectrum sample_indirect_lighting(RNG &rng, const Shading_Info& hit);
+
+	void build_scene(Scene& scene); //replaces current_session()
+	void set_camera(std::shared_ptr<::Instance::Camera> camera); //in its own function so test code can call it
+
+private:
+	void cancel();
+
+	//set up a render (everything but queuing its tiles), returning the tiles to trace:
+	std::vector< Tile > begin_render(std::shared_ptr<Render_Session const> session, std::shared_ptr<::Instance::Camera> camera,
+	                                 std::function<void(Render_Report &&)>&& f, bool* quit, bool add_samples);
+	//queue a tile of the current render on the thread pool:
+	void enqueue_tile(Tile const &tile);
 
 	//trace [x_begin,x_end)x[y_begin,y_end) region of the image, shooting rays for samples [s_begin,s_end):
 	void do_trace(RNG &rng, Tile const &tile);
-	//accumulate samples from do_trace into the accumulator:
-	void accumulate(Tile const &tile, const HDR_Image& data);
+
+	//accumulate samples from do_trace into the accumulator and mark the tile done:
+	// (data and aov_sums [aov_layout.stride values per pixel] hold the tile's pixels, with (0,0) at (x_begin,y_begin))
+	void accumulate(Tile const &tile, const HDR_Image& data, std::vector< float > const &aov_sums);
+
+	Tile_Plan plan;
 
 	bool* cancel_flag = nullptr;
 	std::function<void(Render_Report &&)> report_fn;
 
-	Thread_Pool thread_pool;
+	std::unique_ptr< Thread_Pool > own_thread_pool; //(unless sharing a pool)
+	Thread_Pool *thread_pool = nullptr;
+	//renders are numbered, so that cancel() can have tiles of old renders skipped without clearing a shared pool:
+	std::atomic< uint32_t > generation = 0;
+	//tiles queued or running on the pool:
+	std::mutex queued_tiles_mut;
+	std::condition_variable queued_tiles_cv;
+	uint32_t queued_tiles = 0;
 	bool scene_use_bvh = true;
 	Timer render_timer, build_timer;
 
@@ -83,17 +191,57 @@ private:
 	std::vector< uint32_t > accumulator_samples;
 	//compute image (divide spectrums by sample counts):
 	HDR_Image accumulator_to_image() const;
+	//statistics, merged from each tile as it finishes:
+	Render_Stats render_stats;
+
+	//AOVs requested with use_aovs, and those actually accumulated (which also includes denoiser guides):
+	uint32_t aov_mask = 0;
+	AOV_Layout aov_layout;
+	//sums of AOV channels (aov_layout.stride per pixel), as 40.24 fixed point:
+	std::vector< int64_t > aov_accumulator;
+	std::vector< uint32_t > aov_samples;
+
+	bool denoise = false;
+	//denoise accumulated image using first hit guides:
+	HDR_Image denoised_image() const;
+	float denoise_seconds = 0.0f;
+	//image for the final report (denoised, if requested):
+	HDR_Image final_image();
+
+	//tiles of the current render, and which have been accumulated:
+	std::vector< Tile > render_tiles;
+	std::vector< uint8_t > tile_done;
+
+	//checkpointing (snapshots are taken with accumulator_mut held, and saved after releasing it):
+	std::string checkpoint_file;
+	float checkpoint_interval = 60.0f;
+	Timer checkpoint_timer;
+	uint64_t checkpoint_snapshots = 0; //snapshots taken so far (numbers them)
+	Checkpoint snapshot_checkpoint(uint64_t *sequence);
+	std::mutex checkpoint_save_mut;
+	uint64_t checkpoint_saved = 0; //number of the newest snapshot saved (guarded by checkpoint_save_mut)
+	void save_checkpoint(Checkpoint const &checkpoint, uint64_t sequence);
+	std::optional< Checkpoint > resume_from;
+
+	uint32_t shard_index = 0, shard_count = 1;
+
+	//number of add_samples renders since the accumulator was cleared:
+	// (mixed into tile seeds, so each pass of samples is independent of the ones before)
+	uint32_t sample_pass = 0;
 
 	uint32_t total_tiles = 0;
 	std::atomic<uint32_t> traced_tiles = 0;
 
 	//trace a single ray into the scene,
 	//return (emitted, reflected) light incoming along ray
-	std::pair<Spectrum, Spectrum> trace(RNG &rng, const Ray& ray);
+	// (if aovs is given, also record the first surface hit and the direct/indirect split there)
+	std::pair<Spectrum, Spectrum> trace(RNG &rng, const Ray& ray, Sample_AOVs *aovs = nullptr);
 
 	//compute the contribution of all of the delta lights in the scene:
 	// NOTE: no sampling required because delta lights are in exactly one spot!
-	Spectrum sum_delta_lights(const Shading_Info& hit);
+	// (...unless sample_delta_lights() asked for a bounded number of shadow rays, in which case rng picks lights)
+	Spectrum sum_delta_lights(RNG &rng, const Shading_Info& hit);
+	uint32_t delta_light_samples = 0;
 
 	//compute a direction to one of the area lights:
 	Vec3 sample_area_lights(RNG &rng, Vec3 from);
@@ -103,19 +251,11 @@ private:
 	std::vector<Ray_Log> ray_log;
 	void log_ray(const Ray& ray, float t, Spectrum color = Spectrum{1.0f});
 
-	Aggregate scene;
-	List<Instance> emissive_objects;
-	std::vector<Light_Instance> point_lights;
+	//scene being rendered (built meshes, materials, and lights):
+	std::shared_ptr<Render_Session const> session;
 
 	Camera camera;
 	Mat4 camera_to_world;
-
-	std::unordered_map<std::string, std::shared_ptr<Delta_Light>> delta_lights;
-	std::unordered_map<std::string, std::shared_ptr<Environment_Light>> env_lights;
-	std::unordered_map<std::string, std::shared_ptr<Material>> materials;
-	std::unordered_map<std::string, std::shared_ptr<Texture>> textures;
-	std::unordered_map<std::string, std::shared_ptr<Tri_Mesh>> meshes;
-	std::unordered_map<std::string, std::shared_ptr<Shape>> shapes;
 };
 
 } // namespace PT
@@ -152,4 +152,47 @@ float Sphere::Image::pdf(Vec3 dir) const {
 	}
 }
 
+Alias_Table::Alias_Table(std::vector<float> const &weights) {
+	uint32_t n = uint32_t(weights.size());
+	double total = 0.0;
+	for (float w : weights) total += std::max(w, 0.0f);
+
+	probabilities.resize(n);
+	for (uint32_t i = 0; i < n; ++i) {
+		probabilities[i] = total > 0.0 ? float(std::max(weights[i], 0.0f) / total) : 1.0f / n;
+	}
+
+	//split indices into buckets with less than / at least an average share of probability:
+	threshold.assign(n, 1.0f);
+	alias.resize(n);
+	std::vector<double> scaled(n);
+	std::vector<uint32_t> small, large;
+	for (uint32_t i = 0; i < n; ++i) {
+		alias[i] = i;
+		scaled[i] = double(probabilities[i]) * n;
+		(scaled[i] < 1.0 ? small : large).emplace_back(i);
+	}
+	//fill each under-full bucket from an over-full one:
+	while (!small.empty() && !large.empty()) {
+		uint32_t s = small.back(); small.pop_back();
+		uint32_t l = large.back();
+		threshold[s] = float(scaled[s]);
+		alias[s] = l;
+		scaled[l] -= 1.0 - scaled[s];
+		if (scaled[l] < 1.0) {
+			large.pop_back();
+			small.emplace_back(l);
+		}
+	}
+	//(whatever is left over is full, up to rounding error)
+}
+
+uint32_t Alias_Table::sample(RNG &rng) const {
+	assert(!probabilities.empty());
+	uint32_t n = size();
+	float x = rng.unit() * n;
+	uint32_t i = std::min(uint32_t(x), n - 1);
+	return (x - float(i)) < threshold[i] ? i : alias[i];
+}
+
 } // namespace Samplers
@@ -105,4 +105,20 @@ struct Image {
 };
 
 } // namespace Sphere
+
+//Alias_Table samples an index in [0,size()) with probability proportional to its weight, in O(1) time:
+// (Walker's alias method, built with Vose's algorithm)
+struct Alias_Table {
+	Alias_Table() = default;
+	Alias_Table(std::vector<float> const &weights); //weights must be >= 0; if they sum to zero, indices are uniform
+
+	uint32_t sample(RNG &rng) const;
+	float probability(uint32_t index) const { return probabilities[index]; }
+	uint32_t size() const { return uint32_t(probabilities.size()); }
+
+	std::vector<float> probabilities; //normalized weights
+	std::vector<float> threshold; //keep index i if a uniform draw in its bucket is below threshold[i]...
+	std::vector<uint32_t> alias; //...otherwise use alias[i]
+};
+
 } // namespace Samplers
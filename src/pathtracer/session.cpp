@@ -0,0 +1,252 @@
+
+#include "session.h"
+
+#include "../util/timer.h"
+
+#include <algorithm>
+#include <cmath>
+#include <future>
+
+namespace PT {
+
+Render_Session::Render_Session(Scene& scene_, bool use_bvh_, Thread_Pool *thread_pool) : use_bvh(use_bvh_) {
+
+	Timer build_timer;
+
+	// It would be nice to let the interface be usable here (as with
+	// the path-tracing part), but this would cause too much hassle with
+	// editing the scene while building BVHs from it.
+	// This could be worked around by first copying all the mesh data
+	// and then building the BVHs, but I don't think it's that big
+	// of a deal, as BVH building should take at most a few seconds
+	// even with many big meshes.
+
+	// We could also do instancing instead of duplicating the bvh
+	// for big meshes, but that's something to add in the future
+
+	std::unordered_map<std::shared_ptr<Halfedge_Mesh>, std::string> mesh_names;
+	std::unordered_map<std::shared_ptr<Skinned_Mesh>, std::string> skinned_mesh_names;
+	std::unordered_map<std::shared_ptr<Shape>, std::string> shape_names;
+	std::unordered_map<std::shared_ptr<Texture>, std::string> texture_names;
+	std::unordered_map<std::shared_ptr<Material>, std::string> material_names;
+	std::unordered_map<std::shared_ptr<Delta_Light>, std::string> delta_light_names;
+	std::unordered_map<std::shared_ptr<Environment_Light>, std::string> env_light_names;
+	std::string default_texture_name, default_material_name;
+
+	{ // copy scene data into path tracing formats
+		std::vector<std::future<std::pair<std::string, Tri_Mesh>>> mesh_futs;
+		//(meshes are built on the thread pool, if there is one, and otherwise when their results are needed)
+		auto build_mesh = [&](auto &&build) {
+			if (thread_pool) mesh_futs.emplace_back(thread_pool->enqueue(std::move(build)));
+			else mesh_futs.emplace_back(std::async(std::launch::deferred, std::move(build)));
+		};
+
+		for (const auto& [name, mesh] : scene_.meshes) {
+			mesh_names[mesh] = name;
+			build_mesh([name=name,mesh=mesh,use_bvh=use_bvh]() {
+				return std::pair{name, Tri_Mesh(Indexed_Mesh::from_halfedge_mesh( *mesh, Indexed_Mesh::SplitEdges), use_bvh)};
+			});
+		}
+
+		for (const auto& [name, mesh] : scene_.skinned_meshes) {
+			skinned_mesh_names[mesh] = name;
+			build_mesh([name=name,mesh=mesh,use_bvh=use_bvh]() {
+				return std::pair{name, Tri_Mesh(mesh->posed_mesh(), use_bvh)};
+			});
+		}
+
+		for (const auto& [name, shape] : scene_.shapes) {
+			shape_names[shape] = name;
+			shapes.emplace(name, std::make_shared<Shape>(*shape));
+		}
+
+		std::unordered_map<std::shared_ptr<Texture>, std::shared_ptr<Texture>> texture_to_copy;
+		for (const auto& [name, texture] : scene_.textures) {
+			texture_names[texture] = name;
+			auto copy = std::make_shared<Texture>(texture->copy());
+			texture_to_copy[texture] = copy;
+			textures.emplace(name, std::move(copy));
+		}
+		default_texture_name = scene_.make_unique("default_texture");
+		textures.emplace(default_texture_name, std::make_shared<Texture>(Textures::Constant{Spectrum{0.0f}, 1.0f}));
+
+		for (const auto& [name, material] : scene_.materials) {
+			material_names[material] = name;
+			auto copy = std::make_shared<Material>(*material);
+			copy->for_each([&](std::weak_ptr<Texture>& tex) {
+				if (!tex.expired()) tex = texture_to_copy[tex.lock()];
+			});
+			materials.emplace(name, std::move(copy));
+		}
+		default_material_name = scene_.make_unique("default_material");
+		materials.emplace(default_material_name, std::make_shared<Material>(Materials::Lambertian{ textures.at(default_texture_name) }));
+
+		for (const auto& [name, delta_light] : scene_.delta_lights) {
+			delta_light_names[delta_light] = name;
+			delta_lights.emplace(name, std::make_shared<Delta_Light>(*delta_light));
+		}
+
+		for (const auto& [name, env_light] : scene_.env_lights) {
+			env_light_names[env_light] = name;
+			auto light = std::make_shared<Environment_Light>(*env_light);
+			light->for_each([&](std::weak_ptr<Texture>& tex) {
+				if (!tex.expired()) tex = texture_to_copy[tex.lock()];
+			});
+			env_lights.emplace(name, std::move(light));
+		}
+
+		std::vector<Environment_Light const*> env;
+		for (const auto& [name, light] : env_lights) env.emplace_back(light.get());
+		env_map = Environment_Map(env);
+
+		for (auto& f : mesh_futs) {
+			auto [name, mesh] = f.get();
+			meshes.emplace(name, std::make_shared<Tri_Mesh>(std::move(mesh)));
+		}
+	}
+
+	{ // create scene instances
+		std::vector<Instance> objects, area_lights;
+		std::vector<Light_Instance> lights;
+
+		for (const auto& [name, mesh_inst] : scene_.instances.meshes) {
+
+			if (!mesh_inst->settings.visible) continue;
+			if (mesh_inst->mesh.expired()) continue;
+
+			auto& mesh = meshes.at(mesh_names.at(mesh_inst->mesh.lock()));
+			auto& material = materials.at(mesh_inst->material.expired()
+			                                  ? default_material_name
+			                                  : material_names.at(mesh_inst->material.lock()));
+			Mat4 T = mesh_inst->transform.lock()->local_to_world();
+
+			objects.emplace_back(mesh.get(), material.get(), T);
+
+			if (material->is_emissive()) {
+				area_lights.emplace_back(mesh.get(), material.get(), T);
+			}
+		}
+
+		for (const auto& [name, mesh_inst] : scene_.instances.skinned_meshes) {
+
+			if (!mesh_inst->settings.visible) continue;
+			if (mesh_inst->mesh.expired()) continue;
+
+			auto& mesh = meshes.at(skinned_mesh_names.at(mesh_inst->mesh.lock()));
+			auto& material = materials.at(mesh_inst->material.expired()
+			                                  ? default_material_name
+			                                  : material_names.at(mesh_inst->material.lock()));
+			Mat4 T = mesh_inst->transform.lock()->local_to_world();
+
+			objects.emplace_back(mesh.get(), material.get(), T);
+
+			if (material->is_emissive()) {
+				area_lights.emplace_back(mesh.get(), material.get(), T);
+			}
+		}
+
+		for (const auto& [name, shape_inst] : scene_.instances.shapes) {
+
+			if (!shape_inst->settings.visible) continue;
+			if (shape_inst->shape.expired()) continue;
+
+			auto& shape = shapes.at(shape_names.at(shape_inst->shape.lock()));
+			auto& material = materials.at(shape_inst->material.expired()
+			                                  ? default_material_name
+			                                  : material_names.at(shape_inst->material.lock()));
+			Mat4 T = shape_inst->transform.lock()->local_to_world();
+
+			objects.emplace_back(shape.get(), material.get(), T);
+
+			if (material->is_emissive()) {
+				area_lights.emplace_back(shape.get(), material.get(), T);
+			}
+		}
+
+		for (const auto& [name, part_inst] : scene_.instances.particles) {
+
+			if (!part_inst->settings.visible) continue;
+			if (part_inst->mesh.expired()) continue;
+			if (part_inst->particles.expired()) continue;
+
+			auto& mesh = meshes.at(mesh_names.at(part_inst->mesh.lock()));
+			auto& material = materials.at(part_inst->material.expired()
+			                                  ? default_material_name
+			                                  : material_names.at(part_inst->material.lock()));
+			//Mat4 T = part_inst->transform.lock()->local_to_world();
+
+			auto particles = part_inst->particles.lock();
+			for (const auto& p : particles->particles) {
+				//NOTE: particle positions stored in world space (thus no 'T *' here):
+				Mat4 pT = Mat4::translate(p.position) * Mat4::scale(Vec3{particles->radius});
+
+				objects.emplace_back(mesh.get(), material.get(), pT);
+				if (material->is_emissive()) {
+					area_lights.emplace_back(mesh.get(), material.get(), pT);
+				}
+			}
+		}
+
+		for (const auto& [name, light_inst] : scene_.instances.delta_lights) {
+
+			if (!light_inst->settings.visible) continue;
+			if (light_inst->light.expired()) continue;
+
+			auto& light = delta_lights.at(delta_light_names.at(light_inst->light.lock()));
+			Mat4 T = light_inst->transform.lock()->local_to_world();
+
+			lights.emplace_back(light.get(), T);
+		}
+
+		
+		emissive_objects = List(std::move(area_lights));
+		point_lights = std::move(lights);
+
+		if (use_bvh) {
+			scene = Aggregate(BVH<Instance>(std::move(objects)));
+		} else {
+			scene = Aggregate(List<Instance>(std::move(objects)));
+		}
+		light_grid = Light_Grid(point_lights, scene.bbox());
+	}
+
+	build_time = build_timer.s();
+}
+
+Pass_Schedule::Pass_Schedule(uint32_t max_samples_, float noise_threshold_)
+	: max_samples(max_samples_), noise_threshold(noise_threshold_) {
+}
+
+bool Pass_Schedule::converged() const {
+	return noise_threshold > 0.0f && noise < noise_threshold;
+}
+
+bool Pass_Schedule::done() const {
+	return samples >= max_samples || converged();
+}
+
+uint32_t Pass_Schedule::next_pass() const {
+	if (samples >= max_samples) return 0;
+	return std::min(std::max(samples, 1u), max_samples - samples);
+}
+
+void Pass_Schedule::finish_pass(HDR_Image const &image) {
+	samples += next_pass();
+	noise = relative_change(image, previous);
+	previous = image.copy();
+}
+
+float Pass_Schedule::relative_change(HDR_Image const &a, HDR_Image const &b) {
+	if (a.w != b.w || a.h != b.h || a.w * a.h == 0) return std::numeric_limits< float >::infinity();
+	double sum = 0.0;
+	for (uint32_t i = 0; i < a.w * a.h; ++i) {
+		float la = a.at(i).luma();
+		float lb = b.at(i).luma();
+		//(the small offset keeps near-black pixels from dominating)
+		double d = (la - lb) / (0.5f * (std::abs(la) + std::abs(lb)) + 1e-2f);
+		sum += d * d;
+	}
+	return float(std::sqrt(sum / (a.w * a.h)));
+}
+
+} // namespace PT
@@ -0,0 +1,80 @@
+
+#pragma once
+
+#include <limits>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "../scene/scene.h"
+#include "../util/hdr_image.h"
+#include "../util/thread_pool.h"
+
+#include "aggregate.h"
+#include "env_map.h"
+#include "light_grid.h"
+
+namespace PT {
+
+//everything the path tracer builds from a Scene: copies of its meshes, materials, and lights, plus the
+// acceleration structures over them. Building is the slow part of starting a render, so a session can be
+// built once and then shared (read-only) by any number of renders -- one after another (e.g., as the
+// camera moves) or at the same time (e.g., several cameras, each with its own Pathtracer).
+//
+//NOTE: instances point into the session's own maps, so sessions are neither copyable nor movable;
+// hold them by (shared) pointer.
+class Render_Session {
+public:
+	//copy data out of scene and build BVHs (or lists, if !use_bvh); meshes are built on thread_pool, if given:
+	Render_Session(Scene& scene, bool use_bvh, Thread_Pool *thread_pool = nullptr);
+	Render_Session(Render_Session const &) = delete;
+	Render_Session &operator=(Render_Session const &) = delete;
+
+	bool use_bvh = true;
+	float build_time = 0.0f; //seconds spent building
+
+	Aggregate scene;
+	List<Instance> emissive_objects;
+	std::vector<Light_Instance> point_lights;
+	//which of point_lights might reach each part of the scene:
+	Light_Grid light_grid;
+	//every environment light, combined:
+	Environment_Map env_map;
+
+	std::unordered_map<std::string, std::shared_ptr<Delta_Light>> delta_lights;
+	std::unordered_map<std::string, std::shared_ptr<Environment_Light>> env_lights;
+	std::unordered_map<std::string, std::shared_ptr<Material>> materials;
+	std::unordered_map<std::string, std::shared_ptr<Texture>> textures;
+	std::unordered_map<std::string, std::shared_ptr<Tri_Mesh>> meshes;
+	std::unordered_map<std::string, std::shared_ptr<Shape>> shapes;
+};
+
+//when to stop a progressive render (one rendered in passes that each add samples to the same film):
+// each pass doubles the samples taken so far, until the film's samples are all taken or the image
+// stops changing. Noise is estimated as the relative RMS change in luma since the previous pass --
+// since each pass doubles the samples, the change is about as large as the remaining error.
+struct Pass_Schedule {
+	Pass_Schedule(uint32_t max_samples, float noise_threshold = 0.0f);
+
+	uint32_t max_samples; //samples to take in all
+	float noise_threshold; //stop once noise is below this (if > 0)
+
+	uint32_t samples = 0; //samples taken by finished passes
+	float noise = std::numeric_limits< float >::infinity(); //estimate after the most recent pass
+
+	bool converged() const; //is noise below the threshold?
+	bool done() const; //all samples taken or converged?
+	uint32_t next_pass() const; //samples to take in the next pass
+
+	//record a finished pass (of next_pass() samples) and the image it left on the film:
+	void finish_pass(HDR_Image const &image);
+
+	//relative RMS change in luma between two images of the same size (infinity if the sizes differ):
+	static float relative_change(HDR_Image const &a, HDR_Image const &b);
+
+private:
+	HDR_Image previous;
+};
+
+} // namespace PT
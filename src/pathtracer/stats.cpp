@@ -0,0 +1,113 @@
+
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iomanip>
+#include <sstream>
+#include <vector>
+
+namespace PT {
+
+double Render_Stats::average_path_length() const {
+	return camera_rays ? double(path_vertices) / double(camera_rays) : 0.0;
+}
+
+double Render_Stats::utilization() const {
+	if (thread_busy.empty() || seconds <= 0.0) return 0.0;
+	double busy = 0.0;
+	for (auto const& [id, s] : thread_busy) busy += s;
+	return busy / (seconds * double(thread_busy.size()));
+}
+
+void Render_Stats::add_tile(double tile_seconds) {
+	double us = std::max(tile_seconds * 1e6, 1.0);
+	uint32_t bucket = std::min(uint32_t(std::log2(us)), uint32_t(tile_histogram.size() - 1));
+	tile_histogram[bucket] += 1;
+	tiles += 1;
+	thread_busy[std::this_thread::get_id()] += tile_seconds;
+}
+
+Render_Stats& Render_Stats::operator+=(Render_Stats const& other) {
+	camera_rays += other.camera_rays;
+	traced_rays += other.traced_rays;
+	shadow_rays += other.shadow_rays;
+	bvh_nodes += other.bvh_nodes;
+	primitive_tests += other.primitive_tests;
+	path_vertices += other.path_vertices;
+	for (uint32_t i = 0; i < tile_histogram.size(); ++i) {
+		tile_histogram[i] += other.tile_histogram[i];
+	}
+	tiles += other.tiles;
+	for (auto const& [id, s] : other.thread_busy) {
+		thread_busy[id] += s;
+	}
+	return *this;
+}
+
+//thread busy times, in a stable (descending) order for printing:
+static std::vector<double> sorted_busy(Render_Stats const& stats) {
+	std::vector<double> busy;
+	for (auto const& [id, s] : stats.thread_busy) busy.emplace_back(s);
+	std::sort(busy.begin(), busy.end(), std::greater<double>());
+	return busy;
+}
+
+std::string Render_Stats::to_string() const {
+	std::ostringstream str;
+	str << std::fixed << std::setprecision(2);
+	auto per_camera_ray = [&](uint64_t count) {
+		return camera_rays ? double(count) / double(camera_rays) : 0.0;
+	};
+	str << "Render statistics (" << seconds << "s):\n";
+	str << "\tcamera rays:     " << camera_rays << "\n";
+	str << "\tindirect rays:   " << indirect_rays() << " (" << per_camera_ray(indirect_rays()) << " per camera ray)\n";
+	str << "\tshadow rays:     " << shadow_rays << " (" << per_camera_ray(shadow_rays) << " per camera ray)\n";
+	str << "\tBVH nodes:       " << bvh_nodes << " (" << per_camera_ray(bvh_nodes) << " per camera ray)\n";
+	str << "\tprimitive tests: " << primitive_tests << " (" << per_camera_ray(primitive_tests) << " per camera ray)\n";
+	str << "\tpath length:     " << average_path_length() << " (average)\n";
+	str << "\ttiles:           " << tiles << " (of " << plan.tiles << " planned: " << plan.tile_width << "x" << plan.tile_height
+	    << " pixels, " << plan.tile_samples << " samples, " << plan.split_tiles << " split, for " << plan.threads << " threads)\n";
+	for (uint32_t i = 0; i < tile_histogram.size(); ++i) {
+		if (tile_histogram[i] == 0) continue;
+		str << "\t  [" << std::setw(10) << ((1ull << i) / 1000.0) << ", " << std::setw(10) << ((2ull << i) / 1000.0)
+		    << ") ms: " << tile_histogram[i] << "\n";
+	}
+	str << "\tutilization:     " << 100.0 * utilization() << "% of " << thread_busy.size() << " threads\n";
+	for (double s : sorted_busy(*this)) {
+		str << "\t  " << s << "s busy\n";
+	}
+	return str.str();
+}
+
+std::string Render_Stats::to_json() const {
+	std::ostringstream str;
+	str << std::setprecision(9);
+	str << "{\n";
+	str << "\t\"seconds\": " << seconds << ",\n";
+	str << "\t\"camera_rays\": " << camera_rays << ",\n";
+	str << "\t\"indirect_rays\": " << indirect_rays() << ",\n";
+	str << "\t\"shadow_rays\": " << shadow_rays << ",\n";
+	str << "\t\"bvh_nodes\": " << bvh_nodes << ",\n";
+	str << "\t\"primitive_tests\": " << primitive_tests << ",\n";
+	str << "\t\"average_path_length\": " << average_path_length() << ",\n";
+	str << "\t\"tiles\": " << tiles << ",\n";
+	str << "\t\"tile_plan\": {\"tiles\": " << plan.tiles << ", \"tile_width\": " << plan.tile_width << ", \"tile_height\": " << plan.tile_height
+	    << ", \"tile_samples\": " << plan.tile_samples << ", \"split_tiles\": " << plan.split_tiles << ", \"threads\": " << plan.threads << "},\n";
+	str << "\t\"tile_histogram_us\": [";
+	for (uint32_t i = 0; i < tile_histogram.size(); ++i) {
+		str << (i ? ", " : "") << tile_histogram[i];
+	}
+	str << "],\n";
+	str << "\t\"utilization\": " << utilization() << ",\n";
+	str << "\t\"thread_busy_seconds\": [";
+	std::vector<double> busy = sorted_busy(*this);
+	for (uint32_t i = 0; i < busy.size(); ++i) {
+		str << (i ? ", " : "") << busy[i];
+	}
+	str << "]\n";
+	str << "}\n";
+	return str.str();
+}
+
+} // namespace PT
@@ -0,0 +1,84 @@
+
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+namespace PT {
+
+//render statistics are counted unless compiled with -DSCOTTY3D_NO_RENDER_STATS,
+// in which case all of the counting functions below compile to nothing:
+#ifdef SCOTTY3D_NO_RENDER_STATS
+constexpr bool COLLECT_STATS = false;
+#else
+constexpr bool COLLECT_STATS = true;
+#endif
+
+//how a render's image was split into work items (see Pathtracer::plan_tiles):
+struct Tile_Plan {
+	uint32_t tile_width = 0, tile_height = 0, tile_samples = 0; //size of a (not yet split) tile
+	uint32_t threads = 0; //worker threads the plan was made for
+	uint32_t tiles = 0; //total tiles, after splitting
+	uint32_t split_tiles = 0; //how many of those tiles are quarter-size tail tiles
+};
+
+struct Render_Stats {
+	uint64_t camera_rays = 0; //rays generated by Camera::sample_ray
+	uint64_t traced_rays = 0; //calls to Pathtracer::trace (camera rays + indirect rays)
+	uint64_t shadow_rays = 0; //visibility tests toward lights
+	uint64_t bvh_nodes = 0; //BVH nodes visited
+	uint64_t primitive_tests = 0; //ray-primitive intersection tests
+	uint64_t path_vertices = 0; //surface hits over all paths
+
+	//tile_histogram[i] counts tiles that took [2^i, 2^(i+1)) microseconds to trace:
+	std::array< uint32_t, 32 > tile_histogram{};
+	uint32_t tiles = 0; //tiles traced (fewer than plan.tiles when resuming or sharding)
+	Tile_Plan plan; //(not summed by operator+=)
+
+	//time each thread spent tracing tiles, and the total time of the render:
+	std::unordered_map< std::thread::id, double > thread_busy;
+	double seconds = 0.0;
+
+	uint64_t indirect_rays() const { return traced_rays - camera_rays; }
+	double average_path_length() const;
+	//fraction of available thread time that was spent tracing:
+	double utilization() const;
+
+	void add_tile(double tile_seconds);
+	Render_Stats& operator+=(Render_Stats const &other);
+
+	std::string to_string() const; //multi-line, human-readable summary
+	std::string to_json() const;
+};
+
+namespace Stats {
+
+//counters for the tile being traced on this thread (or nullptr when not tracing):
+// (tiles count into their own Render_Stats and merge when they finish, so counting doesn't contend)
+inline thread_local Render_Stats* local = nullptr;
+
+inline void camera_ray() {
+	if constexpr (COLLECT_STATS) if (local) local->camera_rays += 1;
+}
+inline void traced_ray() {
+	if constexpr (COLLECT_STATS) if (local) local->traced_rays += 1;
+}
+inline void shadow_ray() {
+	if constexpr (COLLECT_STATS) if (local) local->shadow_rays += 1;
+}
+inline void visit_node() {
+	if constexpr (COLLECT_STATS) if (local) local->bvh_nodes += 1;
+}
+inline void primitive_test() {
+	if constexpr (COLLECT_STATS) if (local) local->primitive_tests += 1;
+}
+inline void path_vertex() {
+	if constexpr (COLLECT_STATS) if (local) local->path_vertices += 1;
+}
+
+} // namespace Stats
+
+} // namespace PT
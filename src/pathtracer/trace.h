@@ -22,6 +22,7 @@ struct Trace {
 	float distance = 0.0f;
 	Vec3 position, normal, origin;
 	Vec2 uv;
+	float uv_scale = 0.0f; //uv units per unit of distance along the surface near position (0 if unknown)
 
 	const Material* material = nullptr;
 
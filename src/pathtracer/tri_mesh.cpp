@@ -2,6 +2,7 @@
 #include "../test.h"
 
 #include "samplers.h"
+#include "stats.h"
 #include "tri_mesh.h"
 
 namespace PT {
@@ -21,6 +22,7 @@ BBox Triangle::bbox() const {
 
 Trace Triangle::hit(const Ray& ray) const {
 	//A3T2
+	Stats::primitive_test();
 	
 	// Each vertex contains a postion and surface normal
     Tri_Mesh_Vert v_0 = vertex_list[v0];
@@ -100,9 +102,16 @@ Tri_Mesh::Tri_Mesh(const Indexed_Mesh& mesh, bool use_bvh_) : use_bvh(use_bvh_)
 	const auto& idxs = mesh.indices();
 
 	std::vector<Triangle> tris;
+	double uv_area = 0.0, surface_area = 0.0;
 	for (size_t i = 0; i < idxs.size(); i += 3) {
 		tris.push_back(Triangle(verts.data(), idxs[i], idxs[i + 1], idxs[i + 2]));
+
+		Tri_Mesh_Vert const &a = verts[idxs[i]], &b = verts[idxs[i + 1]], &c = verts[idxs[i + 2]];
+		Vec2 duv1 = b.uv - a.uv, duv2 = c.uv - a.uv;
+		uv_area += 0.5 * std::abs(duv1.x * duv2.y - duv1.y * duv2.x);
+		surface_area += 0.5 * cross(b.position - a.position, c.position - a.position).norm();
 	}
+	if (surface_area > 0.0) average_uv_scale = float(std::sqrt(uv_area / surface_area));
 
 	if (use_bvh) {
 		triangle_bvh.build(std::move(tris), 4);
@@ -114,6 +123,7 @@ Tri_Mesh::Tri_Mesh(const Indexed_Mesh& mesh, bool use_bvh_) : use_bvh(use_bvh_)
 Tri_Mesh Tri_Mesh::copy() const {
 	Tri_Mesh ret;
 	ret.verts = verts;
+	ret.average_uv_scale = average_uv_scale;
 	ret.triangle_bvh = triangle_bvh.copy();
 	ret.triangle_list = triangle_list.copy();
 	ret.use_bvh = use_bvh;
@@ -56,6 +56,10 @@ public:
 
 	BBox bbox() const;
 	Trace hit(const Ray& ray) const;
+	//average uv units per unit of distance along the surface (for texture filtering):
+	float uv_scale() const {
+		return average_uv_scale;
+	}
 
 	uint32_t visualize(GL::Lines& lines, GL::Lines& active, uint32_t level,
 	                   const Mat4& trans) const;
@@ -69,6 +73,7 @@ public:
 private:
 	bool use_bvh = true;
 	std::vector<Tri_Mesh_Vert> verts;
+	float average_uv_scale = 0.0f; //sqrt(total uv area / total surface area)
 	BVH<Triangle> triangle_bvh;
 	List<Triangle> triangle_list;
 };
@@ -1,9 +1,15 @@
 #include "framebuffer.h"
 #include "../util/hdr_image.h"
+#include "../util/thread_pool.h"
+#include "quad.h"
 #include "sample_pattern.h"
 
+#include <algorithm>
+#include <atomic>
+
 Framebuffer::Framebuffer(uint32_t width_, uint32_t height_, SamplePattern const &sample_pattern_)
-	: width(width_), height(height_), sample_pattern(sample_pattern_)
+	: width(width_), height(height_), sample_pattern(sample_pattern_),
+	  samples(static_cast<uint32_t>(sample_pattern_.centers_and_weights.size()))
 {
 
 	// check that framebuffer isn't larger than allowed:
@@ -20,12 +26,22 @@ Framebuffer::Framebuffer(uint32_t width_, uint32_t height_, SamplePattern const
 								 std::to_string(height) + ") is not even.");
 	}
 
-	uint32_t samples =
-		width * height * static_cast<uint32_t>(sample_pattern.centers_and_weights.size());
+	scissor_x_end = width;
+	scissor_y_end = height;
+
+	uint32_t storage = width * height * samples;
 
 	// allocate storage for color and depth samples:
-	colors.assign(samples, Spectrum{0.0f, 0.0f, 0.0f});
-	depths.assign(samples, 1.0f);
+	colors.assign(storage, Spectrum{0.0f, 0.0f, 0.0f});
+	depths.assign(storage, 1.0f);
+}
+
+void Framebuffer::set_scissor(uint32_t x_begin, uint32_t x_end, uint32_t y_begin, uint32_t y_end)
+{
+	scissor_x_end = std::min(x_end, width);
+	scissor_y_end = std::min(y_end, height);
+	scissor_x_begin = std::min(x_begin, scissor_x_end);
+	scissor_y_begin = std::min(y_begin, scissor_y_end);
 }
 
 HDR_Image Framebuffer::resolve_colors() const
@@ -34,17 +50,75 @@ HDR_Image Framebuffer::resolve_colors() const
 	// TODO: update to support sample patterns with more than one sample.
 
 	HDR_Image image(width, height);
-	uint32_t sample_num = uint32_t(sample_pattern.centers_and_weights.size());
+	std::vector<Vec3> const &weights = sample_pattern.centers_and_weights;
 
-	for (uint32_t y = 0; y < height; ++y)
-	{
-		for (uint32_t x = 0; x < width; ++x)
+	// each tile's sample planes are summed as flat runs of floats, four at a time:
+	static_assert(sizeof(Spectrum) == 3 * sizeof(float), "Spectrum should be three packed floats.");
+
+	// walk storage in order -- a tile at a time, summing each of its sample planes in turn:
+	auto resolve_tile_row = [&](uint32_t tile_y) {
+		float sums[TileSize * TileSize * 3];
+		for (uint32_t tile_x = 0; tile_x < width; tile_x += TileSize)
 		{
-			for (uint32_t s = 0; s < sample_num; s++)
+			uint32_t tile_width = std::min(TileSize, width - tile_x);
+			uint32_t tile_height = std::min(TileSize, height - tile_y);
+			uint32_t floats = tile_width * tile_height * 3;
+			uint32_t quads_end = floats & ~3u;
+
+			std::fill(sums, sums + floats, 0.0f);
+			for (uint32_t s = 0; s < samples; s++)
+			{
+				float const *plane = colors[index(tile_x, tile_y, s)].data;
+				float weight = weights[s].z;
+				Quad weight4(weight);
+				for (uint32_t i = 0; i < quads_end; i += 4)
+				{
+					(Quad::load(sums + i) + Quad::load(plane + i) * weight4).store(sums + i);
+				}
+				for (uint32_t i = quads_end; i < floats; ++i)
+				{
+					sums[i] += plane[i] * weight;
+				}
+			}
+
+			for (uint32_t y = 0; y < tile_height; ++y)
 			{
-				image.at(x, y) += color_at(x, y, s) * sample_pattern.centers_and_weights[s].z;
+				Spectrum *row = &image.at(tile_x, tile_y + y);
+				float const *sum = sums + y * tile_width * 3;
+				for (uint32_t x = 0; x < tile_width; ++x)
+				{
+					row[x] = Spectrum{sum[3 * x], sum[3 * x + 1], sum[3 * x + 2]};
+				}
 			}
 		}
+	};
+
+	// rows of tiles write disjoint rows of the image, so they can be resolved on different threads:
+	uint32_t tile_rows = (height + TileSize - 1) / TileSize;
+	if (thread_pool && thread_pool->size() > 1 && tile_rows > 1)
+	{
+		std::atomic<uint32_t> next(0);
+		std::vector<std::future<void>> workers;
+		for (uint32_t w = 0; w < std::min(tile_rows, thread_pool->size()); ++w)
+		{
+			workers.emplace_back(thread_pool->enqueue([&]() {
+				for (uint32_t row = next++; row < tile_rows; row = next++)
+				{
+					resolve_tile_row(row * TileSize);
+				}
+			}));
+		}
+		for (auto &worker : workers)
+		{
+			worker.get();
+		}
+	}
+	else
+	{
+		for (uint32_t row = 0; row < tile_rows; ++row)
+		{
+			resolve_tile_row(row * TileSize);
+		}
 	}
 	return image;
 }
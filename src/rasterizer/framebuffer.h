@@ -1,11 +1,13 @@
 #pragma once
 
+#include <algorithm>
 #include <vector>
 
 #include "../lib/spectrum.h"
 
 class HDR_Image;
 struct SamplePattern;
+class Thread_Pool;
 
 struct Framebuffer
 {
@@ -24,17 +26,43 @@ struct Framebuffer
 
 	const uint32_t width, height;
 	SamplePattern const &sample_pattern;
+	const uint32_t samples; // samples per pixel (sample_pattern.centers_and_weights.size())
+
+	// scissor rectangle: only pixels in [scissor_x_begin,scissor_x_end)x[scissor_y_begin,scissor_y_end)
+	//  are written (the whole framebuffer, unless set_scissor is called)
+	uint32_t scissor_x_begin = 0, scissor_x_end = 0;
+	uint32_t scissor_y_begin = 0, scissor_y_end = 0;
+	void set_scissor(uint32_t x_begin, uint32_t x_end, uint32_t y_begin, uint32_t y_end);
+	bool scissored() const
+	{
+		return scissor_x_begin != 0 || scissor_x_end != width || scissor_y_begin != 0 || scissor_y_end != height;
+	}
+
+	// if set, Pipeline::run and resolve_colors split their work over this pool (not owned by the framebuffer):
+	Thread_Pool *thread_pool = nullptr;
 
 	// storage for color and depth samples:
 	std::vector<Spectrum> colors;
 	std::vector<float> depths;
 
+	// samples are stored in TileSize x TileSize tiles of pixels (TileSize is a power of two):
+	static constexpr uint32_t TileSize = 8;
+
 	// return storage index for sample s of pixel (x,y):
+	//  tiles are stored one after another (a row of tiles at a time, from the bottom), with tiles on the
+	//  right and top edges cut down to fit the framebuffer (so there is no padding). Each tile stores
+	//  all of its pixels' samples together: one plane per sample, each holding the tile's pixels row by row.
+	//  So all samples of a tile are one contiguous range, starting at index(tile_x, tile_y, 0), and
+	//  sample s of the tile's pixels is the contiguous run starting at index(tile_x, tile_y, s).
+	//  (code that walks storage directly relies only on these facts; index stays the one definition)
 	uint32_t index(uint32_t x, uint32_t y, uint32_t s) const
 	{
 		// A1T7: index
-		// TODO: update to provide different storage locations for different samples
-		return (s * height + y) * width + x;
+		uint32_t tile_x = x & ~(TileSize - 1), tile_y = y & ~(TileSize - 1);
+		uint32_t tile_width = std::min(TileSize, width - tile_x);
+		uint32_t tile_height = std::min(TileSize, height - tile_y);
+		return (tile_y * width + tile_x * tile_height) * samples + s * (tile_width * tile_height)
+		       + (y - tile_y) * tile_width + (x - tile_x);
 	}
 
 	// helpers that look up colors and depths for sample s of pixel (x,y):
@@ -1,58 +1,108 @@
 // clang-format off
 #include "pipeline.h"
 
+#include <algorithm>
+#include <atomic>
+#include <initializer_list>
 #include <iostream>
+#include <limits>
+#include <stdexcept>
+#include <string>
 
 #include "../lib/log.h"
 #include "../lib/mathlib.h"
+#include "../util/thread_pool.h"
 #include "framebuffer.h"
+#include "quad.h"
 #include "sample_pattern.h"
+
+// rasterize triangles in run() with rasterize_triangle_quads (instead of rasterize_triangle):
+constexpr bool RASTERIZE_QUADS = true;
+
+template<PrimitiveType primitive_type, class Program, uint32_t flags>
+void Pipeline<primitive_type, Program, flags>::run(std::vector<Vertex> const& vertices,
+                                                   typename Program::Parameters const& parameters,
+                                                   Framebuffer* framebuffer, PipelineStats* stats) {
+	run_impl(vertices, nullptr, parameters, framebuffer, stats);
+}
+
 template<PrimitiveType primitive_type, class Program, uint32_t flags>
 void Pipeline<primitive_type, Program, flags>::run(std::vector<Vertex> const& vertices,
+                                                   std::vector<uint32_t> const& indices,
                                                    typename Program::Parameters const& parameters,
-                                                   Framebuffer* framebuffer_) {
+                                                   Framebuffer* framebuffer, PipelineStats* stats) {
+	for (uint32_t index : indices) {
+		if (index >= vertices.size()) {
+			throw std::runtime_error("Pipeline::run given index " + std::to_string(index) + " of only " + std::to_string(vertices.size()) + " vertices.");
+		}
+	}
+	run_impl(vertices, &indices, parameters, framebuffer, stats);
+}
+
+template<PrimitiveType primitive_type, class Program, uint32_t flags>
+void Pipeline<primitive_type, Program, flags>::run_impl(std::vector<Vertex> const& vertices,
+                                                        std::vector<uint32_t> const* indices,
+                                                        typename Program::Parameters const& parameters,
+                                                        Framebuffer* framebuffer_, PipelineStats* stats) {
 	// Framebuffer must be non-null:
 	assert(framebuffer_);
 	auto& framebuffer = *framebuffer_;
 
-	// A1T7: sample loop
-	// TODO: update this function to rasterize to *all* sample locations in the framebuffer.
-	//  	 This will probably involve inserting a loop of the form:
-	// 		 	std::vector< Vec3 > const &samples = framebuffer.sample_pattern.centers_and_weights;
-	//      	for (uint32_t s = 0; s < samples.size(); ++s) { ... }
-	//   	 around some subset of the code.
-	// 		 You will also need to transform the input and output of the rasterize_* functions to
-	// 	     account for the fact they deal with pixels centered at (0.5,0.5).
+	//--------------------------
+	// work splitting:
+	//  if the framebuffer has a thread pool, vertices are shaded in parallel; primitives are split into
+	//  chunks that are clipped and rasterized in parallel, with fragments sorted into bins by screen tile;
+	//  and then each tile's fragments are depth tested, shaded, and blended by one thread, in primitive
+	//  order -- so results (even with blending) match running on one thread exactly, and framebuffer
+	//  writes need no locks. Chunks are rasterized a round at a time, so bins only hold a few chunks' fragments.
+	//  (without a pool, rounds are one chunk, and fragments are processed in small batches as they are rasterized)
+	//  Each round is drawn to every sample before the next round starts, so writes to a tile's samples --
+	//  which are stored together, see Framebuffer::index -- happen while they are still in cache.
+	constexpr uint32_t PrimitiveVertices = (primitive_type == PrimitiveType::Lines ? 2 : 3);
+	uint32_t const primitive_count = uint32_t((indices ? indices->size() : vertices.size()) / PrimitiveVertices);
+	Thread_Pool* const pool = framebuffer.thread_pool;
+	bool const parallel = pool && pool->size() > 1 && primitive_count >= ParallelMinPrimitives;
+
+	// run f(i) for every i in [0,count), on the pool (if parallel):
+	auto parallel_for = [&](uint32_t count, auto const& f) {
+		if (!parallel) {
+			for (uint32_t i = 0; i < count; ++i) f(i);
+			return;
+		}
+		std::atomic< uint32_t > next(0);
+		std::vector< std::future< void > > workers;
+		for (uint32_t w = 0; w < std::min(count, pool->size()); ++w) {
+			workers.emplace_back(pool->enqueue([&]() {
+				for (uint32_t i = next++; i < count; i = next++) f(i);
+			}));
+		}
+		for (auto& worker : workers) worker.get();
+	};
+
+	//(on one thread, chunks shrink as samples are added, so the tiles a chunk covers -- all of their samples -- stay in cache)
+	uint32_t const chunk_primitives = parallel ? ChunkPrimitives : std::max(1u, ChunkPrimitives / framebuffer.samples);
+	uint32_t const chunk_count = std::max(1u, (primitive_count + chunk_primitives - 1) / chunk_primitives);
+	uint32_t const tiles_x = parallel ? (framebuffer.width + TileSize - 1) / TileSize : 1;
+	uint32_t const tiles_y = parallel ? (framebuffer.height + TileSize - 1) / TileSize : 1;
+	//(so threads working on different tiles never write the same part of framebuffer storage)
+	static_assert(TileSize % Framebuffer::TileSize == 0, "Bins should hold whole framebuffer storage tiles.");
 
-	std::vector<ShadedVertex> shaded_vertices;
-	shaded_vertices.reserve(vertices.size());
+	std::vector<ShadedVertex> shaded_vertices(vertices.size());
 
 	//--------------------------
 	// shade vertices:
-	for (auto const& v : vertices) {
-		ShadedVertex sv;
-		Program::shade_vertex(parameters, v.attributes, &sv.clip_position, &sv.attributes);
-		shaded_vertices.emplace_back(sv);
-	}
-
+	//  each vertex is shaded once, even if indices use it in many primitives
+	//  (shaded vertices are kept for all of assembly, so they act as a post-transform cache that never misses)
+	uint32_t const vertex_blocks = uint32_t((vertices.size() + 1023) / 1024);
+	parallel_for(vertex_blocks, [&](uint32_t block) {
+		size_t end = std::min(vertices.size(), size_t(block + 1) * 1024);
+		for (size_t i = size_t(block) * 1024; i < end; ++i) {
+			ShadedVertex &sv = shaded_vertices[i];
+			Program::shade_vertex(parameters, vertices[i].attributes, &sv.clip_position, &sv.attributes);
+		}
+	});
 
-	std::vector< Vec3 > const &samples = framebuffer.sample_pattern.centers_and_weights;
-	for (uint32_t s = 0; s < samples.size(); s++) {
-	float s_x = samples[s].x;
-	float s_y = samples[s].y;
 
-	//--------------------------
-	// assemble + clip + homogeneous divide vertices:
-	std::vector<ClippedVertex> clipped_vertices;
-
-	// reserve some space to avoid reallocations later:
-	if constexpr (primitive_type == PrimitiveType::Lines) {
-		// clipping lines can never produce more than one vertex per input vertex:
-		clipped_vertices.reserve(shaded_vertices.size());
-	} else if constexpr (primitive_type == PrimitiveType::Triangles) {
-		// clipping triangles can produce up to 8 vertices per input vertex:
-		clipped_vertices.reserve(shaded_vertices.size() * 8);
-	}
 	// clang-format off
 
 	//coefficients to map from clip coordinates to framebuffer (i.e., "viewport") coordinates:
@@ -64,138 +114,403 @@ void Pipeline<primitive_type, Program, flags>::run(std::vector<Vertex> const& ve
 		framebuffer.height / 2.0f,
 		0.5f
 	};
-	Vec3 const clip_to_fb_offset = Vec3{
-		0.5f * framebuffer.width + (s_x - 0.5f),
-		0.5f * framebuffer.height + (s_y - 0.5f),
-		0.5f
-	};
 
-	// helper used to put output of clipping functions into clipped_vertices:
-	auto emit_vertex = [&](ShadedVertex const& sv) {
-		ClippedVertex cv;
-		float inv_w = 1.0f / sv.clip_position.w;
-		cv.fb_position = clip_to_fb_scale * inv_w * sv.clip_position.xyz() + clip_to_fb_offset;
-		cv.inv_w = inv_w;
-		cv.attributes = sv.attributes;
-		clipped_vertices.emplace_back(cv);
+	//--------------------------
+	// assemble + clip + homogeneous divide vertices:
+	//  clipping doesn't depend on the sample location, so this happens once for all samples;
+	//  clipped vertices hold the scaled position, and each sample adds its own offset before rasterizing.
+	//  (this is the same arithmetic as scaling and offsetting at once, so results don't change)
+	std::vector< std::vector<ClippedVertex> > clipped_chunks(chunk_count);
+
+	// with Pipeline_CullBackBit, back-facing triangles are dropped before clipping:
+	//  det[a.xyw; b.xyw; c.xyw] of the clip positions is positive for triangles that are counter-clockwise
+	//  in the framebuffer, and its sign gives the side of the triangle the camera is on even for triangles
+	//  that cross w = 0 (which only show up on screen once clipped).
+	auto back_facing = [](Vec4 const& a, Vec4 const& b, Vec4 const& c) {
+		float det = a.x * (b.y * c.w - b.w * c.y) - a.y * (b.x * c.w - b.w * c.x) + a.w * (b.x * c.y - b.y * c.x);
+		return det < 0.0f;
 	};
+	std::atomic< uint32_t > backfacing(0);
 
-	// actually do clipping:
-	if constexpr (primitive_type == PrimitiveType::Lines) {
-		for (uint32_t i = 0; i + 1 < shaded_vertices.size(); i += 2) {
-			clip_line(shaded_vertices[i], shaded_vertices[i + 1], emit_vertex);
-		}
-	} else if constexpr (primitive_type == PrimitiveType::Triangles) {
-		for (uint32_t i = 0; i + 2 < shaded_vertices.size(); i += 3) {
-			clip_triangle(shaded_vertices[i], shaded_vertices[i + 1], shaded_vertices[i + 2], emit_vertex);
-		}
-	} else {
-		static_assert(primitive_type == PrimitiveType::Lines, "Unsupported primitive type.");
-	}
+	// area of a triangle's bounding box in the framebuffer (the same for every sample, as offsets don't change it):
+	auto bbox_area = [](ClippedVertex const* v) {
+		float width = std::max({v[0].fb_position.x, v[1].fb_position.x, v[2].fb_position.x}) - std::min({v[0].fb_position.x, v[1].fb_position.x, v[2].fb_position.x});
+		float height = std::max({v[0].fb_position.y, v[1].fb_position.y, v[2].fb_position.y}) - std::min({v[0].fb_position.y, v[1].fb_position.y, v[2].fb_position.y});
+		return width * height;
+	};
+	// does any clipped triangle cover enough pixels for the coarse depth buffer (below) to pay off?
+	std::atomic< bool > large_triangles(false);
 
-	//--------------------------
-	// rasterize primitives:
+	// shaded vertex at corner i of the primitive list:
+	auto corner = [&](uint32_t i) -> ShadedVertex const& {
+		return shaded_vertices[indices ? (*indices)[i] : i];
+	};
 
-	std::vector<Fragment> fragments;
+	parallel_for(chunk_count, [&](uint32_t chunk) {
+		uint32_t const first = uint32_t(uint64_t(primitive_count) * chunk / chunk_count);
+		uint32_t const last = uint32_t(uint64_t(primitive_count) * (chunk + 1) / chunk_count);
 
-	// helper used to put output of rasterization functions into fragments:
-	auto emit_fragment = [&](Fragment const& f) { fragments.emplace_back(f); };
+		std::vector<ClippedVertex> &clipped_vertices = clipped_chunks[chunk];
 
-	// actually do rasterization:
-	if constexpr (primitive_type == PrimitiveType::Lines) {
-		for (uint32_t i = 0; i + 1 < clipped_vertices.size(); i += 2) {
-			rasterize_line(clipped_vertices[i], clipped_vertices[i + 1], emit_fragment);
-		}
-	} else if constexpr (primitive_type == PrimitiveType::Triangles) {
-		for (uint32_t i = 0; i + 2 < clipped_vertices.size(); i += 3) {
-			rasterize_triangle(clipped_vertices[i], clipped_vertices[i + 1], clipped_vertices[i + 2], emit_fragment);
+		// reserve some space to avoid reallocations later:
+		if constexpr (primitive_type == PrimitiveType::Lines) {
+			// clipping lines can never produce more than one vertex per input vertex:
+			clipped_vertices.reserve((last - first) * 2);
+		} else if constexpr (primitive_type == PrimitiveType::Triangles) {
+			// clipping triangles can produce up to 8 vertices per input vertex:
+			clipped_vertices.reserve((last - first) * 3 * 8);
 		}
-	} else {
-		static_assert(primitive_type == PrimitiveType::Lines, "Unsupported primitive type.");
-	}
 
-	//--------------------------
-	// depth test + shade + blend fragments:
-	uint32_t out_of_range = 0; // check if rasterization produced fragments outside framebuffer 
-							   // (indicates something is wrong with clipping)
-	for (auto const& f : fragments) {
-
-		// fragment location (in pixels):
-		int32_t x = (int32_t)std::floor(f.fb_position.x);
-		int32_t y = (int32_t)std::floor(f.fb_position.y);
-
-		// if clipping is working properly, this condition shouldn't be needed;
-		// however, it prevents crashes while you are working on your clipping functions,
-		// so we suggest leaving it in place:
-		if (x < 0 || (uint32_t)x >= framebuffer.width || 
-		    y < 0 || (uint32_t)y >= framebuffer.height) {
-			++out_of_range;
-			continue;
-		}
+		// helper used to put output of clipping functions into clipped_vertices:
+		auto emit_vertex = [&](ShadedVertex const& sv) {
+			ClippedVertex cv;
+			float inv_w = 1.0f / sv.clip_position.w;
+			cv.fb_position = clip_to_fb_scale * inv_w * sv.clip_position.xyz();
+			cv.inv_w = inv_w;
+			cv.attributes = sv.attributes;
+			clipped_vertices.emplace_back(cv);
+		};
 
-		// local names that refer to destination sample in framebuffer:
-		float& fb_depth = framebuffer.depth_at(x, y, s);
-		Spectrum& fb_color = framebuffer.color_at(x, y, s);
-
-
-		// depth test:
-		if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Always) {
-			// "Always" means the depth test always passes.
-		} else if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Never) {
-			// "Never" means the depth test never passes.
-			continue; //discard this fragment
-		} else if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Less) {
-			// "Less" means the depth test passes when the new fragment has depth less than the stored depth.
-			// A1T4: Depth_Less
-			// TODO: implement depth test! We want to only emit fragments that have a depth less than the stored depth, hence "Depth_Less".
-			if (f.fb_position.z >= fb_depth) {
-				continue;
+		// actually do clipping:
+		if constexpr (primitive_type == PrimitiveType::Lines) {
+			for (uint32_t i = first * 2; i < last * 2; i += 2) {
+				clip_line_impl(corner(i), corner(i + 1), emit_vertex);
+			}
+		} else if constexpr (primitive_type == PrimitiveType::Triangles) {
+			uint32_t culled = 0;
+			for (uint32_t i = first * 3; i < last * 3; i += 3) {
+				if constexpr ((flags & Pipeline_CullBackBit) != 0) {
+					if (back_facing(corner(i).clip_position, corner(i + 1).clip_position, corner(i + 2).clip_position)) {
+						++culled;
+						continue;
+					}
+				}
+				clip_triangle_impl(corner(i), corner(i + 1), corner(i + 2), emit_vertex);
+			}
+			backfacing += culled;
+			if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Less) {
+				for (uint32_t i = 0; i + 2 < clipped_vertices.size(); i += 3) {
+					if (bbox_area(&clipped_vertices[i]) >= float(HiZMinArea)) {
+						large_triangles.store(true, std::memory_order_relaxed);
+						break;
+					}
+				}
 			}
 		} else {
-			static_assert((flags & PipelineMask_Depth) <= Pipeline_Depth_Always, "Unknown depth test flag.");
+			static_assert(primitive_type == PrimitiveType::Lines, "Unsupported primitive type.");
 		}
+	});
+
+	// fragments waiting to be processed:
+	//  on one thread, a small batch that is processed whenever it fills;
+	//  in parallel, bins ([chunk][tile]) for each chunk of the current round. (allocated once and reused)
+	std::vector<Fragment> batch;
+	std::vector< std::vector< std::vector<Fragment> > > bins;
+	uint32_t const round_chunks = parallel ? 2 * pool->size() : 1;
+	if (parallel) {
+		bins.assign(std::min(round_chunks, chunk_count), std::vector< std::vector<Fragment> >(tiles_x * tiles_y));
+	} else {
+		batch.reserve(FragmentBatch);
+	}
 
-		// if depth test passes, and depth writes aren't disabled, write depth to depth buffer:
-		if constexpr (!(flags & Pipeline_DepthWriteDisableBit)) {
-			fb_depth = f.fb_position.z;
-		}
+	std::vector< Vec3 > const &samples = framebuffer.sample_pattern.centers_and_weights;
 
-		// shade fragment:
-		ShadedFragment sf;
-		sf.fb_position = f.fb_position;
-		Program::shade_fragment(parameters, f.attributes, f.derivatives, &sf.color, &sf.opacity);
-
-		// write color to framebuffer if color writes aren't disabled:
-		if constexpr (!(flags & Pipeline_ColorWriteDisableBit)) {
-			// blend fragment:
-			if constexpr ((flags & PipelineMask_Blend) == Pipeline_Blend_Replace) {
-				fb_color = sf.color;
-			} else if constexpr ((flags & PipelineMask_Blend) == Pipeline_Blend_Add) {
-				// A1T4: Blend_Add
-				// TODO: framebuffer color should have fragment color multiplied by fragment opacity added to it.
-				fb_color += sf.color * sf.opacity;
-			} else if constexpr ((flags & PipelineMask_Blend) == Pipeline_Blend_Over) {
-				// A1T4: Blend_Over
-				// TODO: set framebuffer color to the result of "over" blending (also called "alpha blending") the fragment color over the framebuffer color, using the fragment's opacity
-				// 		 You may assume that the framebuffer color has its alpha premultiplied already, and you just want to compute the resulting composite color
-				fb_color = sf.opacity * sf.color + (1 - sf.opacity) * fb_color;
+	// coarse depth buffer for early depth tests (see below), for each sample:
+	//  (only allocated when some triangle is large enough to be tested against it, so draws of small triangles don't pay for it)
+	bool const use_hiz = large_triangles.load(std::memory_order_relaxed);
+	uint32_t const hiz_w = (framebuffer.width + HiZTileSize - 1) / HiZTileSize;
+	uint32_t const hiz_h = (framebuffer.height + HiZTileSize - 1) / HiZTileSize;
+	std::vector< std::atomic< float > > hiz(use_hiz ? samples.size() * hiz_w * hiz_h : 0);
+	for (auto &tile : hiz) tile.store(std::numeric_limits< float >::quiet_NaN(), std::memory_order_relaxed);
+
+	// count of fragments outside the framebuffer for each sample
+	//  (if clipping is working properly, there won't be any):
+	std::vector< std::atomic< uint32_t > > out_of_range(samples.size());
+
+	for (uint32_t round = 0; round < chunk_count; round += round_chunks) {
+		uint32_t const round_count = std::min(round_chunks, chunk_count - round);
+		for (uint32_t s = 0; s < samples.size(); s++) {
+			float s_x = samples[s].x;
+			float s_y = samples[s].y;
+
+			Vec3 const clip_to_fb_offset = Vec3{
+				0.5f * framebuffer.width + (s_x - 0.5f),
+				0.5f * framebuffer.height + (s_y - 0.5f),
+				0.5f
+			};
+
+			// primitives entirely outside the scissor rectangle can be skipped:
+			//  (bounds are padded by a pixel, since lines also cover pixels they pass near)
+			bool const scissored = framebuffer.scissored();
+			auto outside_scissor = [&](std::initializer_list< ClippedVertex const * > vertices) {
+				float min_x = std::numeric_limits< float >::infinity(), max_x = -min_x;
+				float min_y = min_x, max_y = -min_x;
+				for (ClippedVertex const *v : vertices) {
+					min_x = std::min(min_x, v->fb_position.x);
+					max_x = std::max(max_x, v->fb_position.x);
+					min_y = std::min(min_y, v->fb_position.y);
+					max_y = std::max(max_y, v->fb_position.y);
+				}
+				return max_x + 1.0f < float(framebuffer.scissor_x_begin) || min_x - 1.0f >= float(framebuffer.scissor_x_end)
+				    || max_y + 1.0f < float(framebuffer.scissor_y_begin) || min_y - 1.0f >= float(framebuffer.scissor_y_end);
+			};
+
+			//--------------------------
+			// early depth tests:
+			//  with Depth_Less, fragments at or behind the depth already stored can never be drawn
+			//  (programs can't change fragment depth, and depths in the framebuffer only decrease during a run),
+			//  so they can be dropped before interpolation and shading -- per quad against the depth buffer,
+			//  and per triangle or per HiZTileSize x HiZTileSize block against a coarse depth buffer (hiz)
+			//  holding the largest depth in each block. Fragments outside the framebuffer are always kept,
+			//  so the late test still counts them.
+			//  (hiz blocks are computed when first needed and marked stale again when a depth in them is written;
+			//   depth writes only lower the true maximum, so a value computed before pending writes stays a safe bound)
+			auto hiz_max = [&](uint32_t tx, uint32_t ty) {
+				std::atomic< float > &tile = hiz[(s * hiz_h + ty) * hiz_w + tx];
+				float max = tile.load(std::memory_order_relaxed);
+				if (max != max) {
+					//(a hiz block is exactly one framebuffer storage tile, so this sample's depths in it are one contiguous run)
+					static_assert(HiZTileSize == Framebuffer::TileSize, "hiz blocks should match framebuffer storage tiles.");
+					uint32_t x = tx * HiZTileSize, y = ty * HiZTileSize;
+					uint32_t pixels = (std::min(framebuffer.width, x + HiZTileSize) - x) * (std::min(framebuffer.height, y + HiZTileSize) - y);
+					float const *depths = &framebuffer.depths[framebuffer.index(x, y, s)];
+					max = -std::numeric_limits< float >::infinity();
+					for (uint32_t i = 0; i < pixels; ++i) {
+						float depth = depths[i];
+						//(nothing is behind a NaN depth, since the late test never rejects against it)
+						max = std::max(max, depth == depth ? depth : std::numeric_limits< float >::infinity());
+					}
+					tile.store(max, std::memory_order_relaxed);
+				}
+				return max;
+			};
+			// a bound on the depths of a triangle's fragments, for hiz tests
+			//  (NaN -- no hiz tests -- if there is none, or if the triangle is small enough that updating hiz would cost more than it saves):
+			auto triangle_min_z = [&](ClippedVertex const* v) {
+				if (!use_hiz) return std::numeric_limits< float >::quiet_NaN();
+				float za = v[0].fb_position.z, zb = v[1].fb_position.z, zc = v[2].fb_position.z;
+				if (za != za || zb != zb || zc != zc) return std::numeric_limits< float >::quiet_NaN();
+				if (!(bbox_area(v) >= float(HiZMinArea))) return std::numeric_limits< float >::quiet_NaN();
+				//interpolated depths can round a little below the smallest vertex depth, so leave some slack:
+				return std::min({za, zb, zc}) - 1e-4f * std::max({std::abs(za), std::abs(zb), std::abs(zc)});
+			};
+			auto hidden_block = [&](float min_z, int32_t x, int32_t y) {
+				if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Less) {
+					if (min_z != min_z) return false;
+					if (x < 0 || y < 0 || uint32_t(x) + HiZTileSize > framebuffer.width || uint32_t(y) + HiZTileSize > framebuffer.height) return false;
+					return min_z >= hiz_max(uint32_t(x) / HiZTileSize, uint32_t(y) / HiZTileSize);
+				} else {
+					return false;
+				}
+			};
+			auto hidden_triangle = [&](ClippedVertex const* v, float min_z) {
+				if (min_z != min_z) return false;
+				float min_x = std::min({v[0].fb_position.x, v[1].fb_position.x, v[2].fb_position.x});
+				float max_x = std::max({v[0].fb_position.x, v[1].fb_position.x, v[2].fb_position.x});
+				float min_y = std::min({v[0].fb_position.y, v[1].fb_position.y, v[2].fb_position.y});
+				float max_y = std::max({v[0].fb_position.y, v[1].fb_position.y, v[2].fb_position.y});
+				if (!(min_x >= 0.0f && max_x <= float(framebuffer.width) && min_y >= 0.0f && max_y <= float(framebuffer.height))) return false;
+				// (pixels the rasterizer may visit, as in rasterize_triangle:)
+				uint32_t x_begin = uint32_t(std::floor(min_x)), x_end = uint32_t(std::ceil(max_x));
+				uint32_t y_begin = uint32_t(std::floor(min_y)), y_end = uint32_t(std::ceil(max_y));
+				if (x_begin >= x_end || y_begin >= y_end) return false;
+				for (uint32_t ty = y_begin / HiZTileSize; ty <= (y_end - 1) / HiZTileSize; ++ty) {
+					for (uint32_t tx = x_begin / HiZTileSize; tx <= (x_end - 1) / HiZTileSize; ++tx) {
+						if (!(min_z >= hiz_max(tx, ty))) return false;
+					}
+				}
+				return true;
+			};
+			auto early_depth = [&](int32_t x, int32_t y, float const z[4], uint32_t covered) -> uint32_t {
+				if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Less) {
+					//(quads that aren't entirely inside the framebuffer are left to the late test)
+					if (x < 0 || y < 0 || uint32_t(x) + 1 >= framebuffer.width || uint32_t(y) + 1 >= framebuffer.height) return covered;
+					uint32_t visible = 0;
+					for (uint32_t q = 0; q < 4; ++q) {
+						if ((covered & (1 << q)) && !(z[q] >= framebuffer.depth_at(x + (q & 1), y + (q >> 1), s))) visible |= (1 << q);
+					}
+					return visible;
+				} else {
+					return covered;
+				}
+			};
+			//--------------------------
+			// rasterize primitives:
+			auto rasterize_chunk = [&](uint32_t chunk, auto const& emit_fragment) {
+				std::vector<ClippedVertex> const &clipped_vertices = clipped_chunks[chunk];
+
+				// move a primitive's vertices to this sample's location:
+				ClippedVertex v[3];
+				auto place = [&](uint32_t count, ClippedVertex const *from) {
+					for (uint32_t i = 0; i < count; ++i) {
+						v[i] = from[i];
+						v[i].fb_position += clip_to_fb_offset;
+					}
+				};
+
+				// actually do rasterization:
+				if constexpr (primitive_type == PrimitiveType::Lines) {
+					for (uint32_t i = 0; i + 1 < clipped_vertices.size(); i += 2) {
+						place(2, &clipped_vertices[i]);
+						if (scissored && outside_scissor({&v[0], &v[1]})) continue;
+						rasterize_line_impl(v[0], v[1], emit_fragment);
+					}
+				} else if constexpr (primitive_type == PrimitiveType::Triangles) {
+					for (uint32_t i = 0; i + 2 < clipped_vertices.size(); i += 3) {
+						place(3, &clipped_vertices[i]);
+						if (scissored && outside_scissor({&v[0], &v[1], &v[2]})) continue;
+						float min_z = std::numeric_limits< float >::quiet_NaN();
+						if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Less) {
+							min_z = triangle_min_z(v);
+							if (hidden_triangle(v, min_z)) continue;
+						}
+						if constexpr (RASTERIZE_QUADS) {
+							rasterize_triangle_quads(v[0], v[1], v[2], emit_fragment,
+								[&](int32_t x, int32_t y) { return hidden_block(min_z, x, y); }, early_depth);
+						} else {
+							rasterize_triangle_impl(v[0], v[1], v[2], emit_fragment);
+						}
+					}
+				} else {
+					static_assert(primitive_type == PrimitiveType::Lines, "Unsupported primitive type.");
+				}
+			};
+
+			//--------------------------
+			// depth test + shade + blend fragments:
+			auto process_fragments = [&](std::vector<Fragment> const& fragments) {
+				uint32_t batch_out_of_range = 0;
+				for (auto const& f : fragments) {
+
+					// fragment location (in pixels):
+					int32_t x = (int32_t)std::floor(f.fb_position.x);
+					int32_t y = (int32_t)std::floor(f.fb_position.y);
+
+					// if clipping is working properly, this condition shouldn't be needed;
+					// however, it prevents crashes while you are working on your clipping functions,
+					// so we suggest leaving it in place:
+					if (x < 0 || (uint32_t)x >= framebuffer.width || 
+					    y < 0 || (uint32_t)y >= framebuffer.height) {
+						++batch_out_of_range;
+						continue;
+					}
+
+					// scissor test:
+					if (scissored && ((uint32_t)x < framebuffer.scissor_x_begin || (uint32_t)x >= framebuffer.scissor_x_end ||
+					                  (uint32_t)y < framebuffer.scissor_y_begin || (uint32_t)y >= framebuffer.scissor_y_end)) {
+						continue;
+					}
+
+					// local names that refer to destination sample in framebuffer:
+					float& fb_depth = framebuffer.depth_at(x, y, s);
+					Spectrum& fb_color = framebuffer.color_at(x, y, s);
+
+
+					// depth test:
+					if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Always) {
+						// "Always" means the depth test always passes.
+					} else if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Never) {
+						// "Never" means the depth test never passes.
+						continue; //discard this fragment
+					} else if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Less) {
+						// "Less" means the depth test passes when the new fragment has depth less than the stored depth.
+						// A1T4: Depth_Less
+						// TODO: implement depth test! We want to only emit fragments that have a depth less than the stored depth, hence "Depth_Less".
+						if (f.fb_position.z >= fb_depth) {
+							continue;
+						}
+					} else {
+						static_assert((flags & PipelineMask_Depth) <= Pipeline_Depth_Always, "Unknown depth test flag.");
+					}
+
+					// if depth test passes, and depth writes aren't disabled, write depth to depth buffer:
+					if constexpr (!(flags & Pipeline_DepthWriteDisableBit)) {
+						fb_depth = f.fb_position.z;
+						if constexpr ((flags & PipelineMask_Depth) == Pipeline_Depth_Less) {
+							if (use_hiz) hiz[(s * hiz_h + y / HiZTileSize) * hiz_w + x / HiZTileSize].store(std::numeric_limits< float >::quiet_NaN(), std::memory_order_relaxed);
+						}
+					}
+
+					// shade fragment:
+					ShadedFragment sf;
+					sf.fb_position = f.fb_position;
+					Program::shade_fragment(parameters, f.attributes, f.derivatives, &sf.color, &sf.opacity);
+
+					// write color to framebuffer if color writes aren't disabled:
+					if constexpr (!(flags & Pipeline_ColorWriteDisableBit)) {
+						// blend fragment:
+						if constexpr ((flags & PipelineMask_Blend) == Pipeline_Blend_Replace) {
+							fb_color = sf.color;
+						} else if constexpr ((flags & PipelineMask_Blend) == Pipeline_Blend_Add) {
+							// A1T4: Blend_Add
+							// TODO: framebuffer color should have fragment color multiplied by fragment opacity added to it.
+							fb_color += sf.color * sf.opacity;
+						} else if constexpr ((flags & PipelineMask_Blend) == Pipeline_Blend_Over) {
+							// A1T4: Blend_Over
+							// TODO: set framebuffer color to the result of "over" blending (also called "alpha blending") the fragment color over the framebuffer color, using the fragment's opacity
+							// 		 You may assume that the framebuffer color has its alpha premultiplied already, and you just want to compute the resulting composite color
+							fb_color = sf.opacity * sf.color + (1 - sf.opacity) * fb_color;
+						} else {
+							static_assert((flags & PipelineMask_Blend) <= Pipeline_Blend_Over, "Unknown blending flag.");
+						}
+					}
+				}
+				out_of_range[s] += batch_out_of_range;
+			};
+
+			if (!parallel) {
+				// stream fragments: process them in small batches as they are rasterized, so they never leave cache:
+				auto emit_fragment = [&](Fragment const& f) {
+					batch.emplace_back(f);
+					if (batch.size() == FragmentBatch) {
+						process_fragments(batch);
+						batch.clear();
+					}
+				};
+				rasterize_chunk(round, emit_fragment);
+				process_fragments(batch);
+				batch.clear();
 			} else {
-				static_assert((flags & PipelineMask_Blend) <= Pipeline_Blend_Over, "Unknown blending flag.");
+				// rasterize the round's chunks (binning fragments by tile), then process each tile's fragments in chunk order:
+				//  (so only one round's fragments are ever stored)
+				parallel_for(round_count, [&](uint32_t c) {
+					std::vector< std::vector<Fragment> > &chunk_bins = bins[c];
+					for (auto &bin : chunk_bins) bin.clear();
+
+					// helper used to put output of rasterization functions into bins:
+					//  (fragments outside the framebuffer are clamped into the nearest edge tile, which will count them as out of range)
+					rasterize_chunk(round + c, [&](Fragment const& f) {
+						uint32_t tx = uint32_t(std::clamp(int32_t(std::floor(f.fb_position.x)) / int32_t(TileSize), 0, int32_t(tiles_x) - 1));
+						uint32_t ty = uint32_t(std::clamp(int32_t(std::floor(f.fb_position.y)) / int32_t(TileSize), 0, int32_t(tiles_y) - 1));
+						chunk_bins[ty * tiles_x + tx].emplace_back(f);
+					});
+				});
+				parallel_for(tiles_x * tiles_y, [&](uint32_t tile) {
+					for (uint32_t c = 0; c < round_count; ++c) {
+						process_fragments(bins[c][tile]);
+					}
+				});
 			}
 		}
 	}
-	if (out_of_range > 0) {
-		if constexpr (primitive_type == PrimitiveType::Lines) {
-			warn("Produced %d fragments outside framebuffer; this indicates something is likely "
-			     "wrong with the clip_line function.",
-			     out_of_range);
-		} else if constexpr (primitive_type == PrimitiveType::Triangles) {
-			warn("Produced %d fragments outside framebuffer; this indicates something is likely "
-			     "wrong with the clip_triangle function.",
-			     out_of_range);
+
+	for (uint32_t s = 0; s < samples.size(); s++) {
+		if (out_of_range[s] > 0) {
+			if constexpr (primitive_type == PrimitiveType::Lines) {
+				warn("Produced %d fragments outside framebuffer; this indicates something is likely "
+				     "wrong with the clip_line function.",
+				     out_of_range[s].load());
+			} else if constexpr (primitive_type == PrimitiveType::Triangles) {
+				warn("Produced %d fragments outside framebuffer; this indicates something is likely "
+				     "wrong with the clip_triangle function.",
+				     out_of_range[s].load());
+			}
 		}
 	}
-}
+
+	if (stats) {
+		stats->backfacing_triangles += backfacing.load();
+	}
 }
 
 // -------------------------------------------------------------------------
@@ -226,6 +541,13 @@ auto Pipeline<p, P, F>::lerp(ShadedVertex const& a, ShadedVertex const& b, float
 template<PrimitiveType p, class P, uint32_t flags>
 void Pipeline<p, P, flags>::clip_line(ShadedVertex const& va, ShadedVertex const& vb,
                                       std::function<void(ShadedVertex const&)> const& emit_vertex) {
+	clip_line_impl(va, vb, emit_vertex);
+}
+
+template<PrimitiveType p, class P, uint32_t flags>
+template<typename EmitVertex>
+void Pipeline<p, P, flags>::clip_line_impl(ShadedVertex const& va, ShadedVertex const& vb,
+                                           EmitVertex const& emit_vertex) {
 	// Determine portion of line over which:
 	// 		pt = (b-a) * t + a
 	//  	-pt.w <= pt.x <= pt.w
@@ -316,6 +638,14 @@ template<PrimitiveType p, class P, uint32_t flags>
 void Pipeline<p, P, flags>::clip_triangle(
 	ShadedVertex const& va, ShadedVertex const& vb, ShadedVertex const& vc,
 	std::function<void(ShadedVertex const&)> const& emit_vertex) {
+	clip_triangle_impl(va, vb, vc, emit_vertex);
+}
+
+template<PrimitiveType p, class P, uint32_t flags>
+template<typename EmitVertex>
+void Pipeline<p, P, flags>::clip_triangle_impl(
+	ShadedVertex const& va, ShadedVertex const& vb, ShadedVertex const& vc,
+	EmitVertex const& emit_vertex) {
 	// A1EC: clip_triangle
 	// TODO: correct code!
 	emit_vertex(va);
@@ -362,6 +692,14 @@ template<PrimitiveType p, class P, uint32_t flags>
 void Pipeline<p, P, flags>::rasterize_line(
 	ClippedVertex const& va, ClippedVertex const& vb,
 	std::function<void(Fragment const&)> const& emit_fragment) {
+	rasterize_line_impl(va, vb, emit_fragment);
+}
+
+template<PrimitiveType p, class P, uint32_t flags>
+template<typename EmitFragment>
+void Pipeline<p, P, flags>::rasterize_line_impl(
+	ClippedVertex const& va, ClippedVertex const& vb,
+	EmitFragment const& emit_fragment) {
 	if constexpr ((flags & PipelineMask_Interp) != Pipeline_Interp_Flat) {
 		assert(0 && "rasterize_line should only be invoked in flat interpolation mode.");
 	}
@@ -507,6 +845,14 @@ template<PrimitiveType p, class P, uint32_t flags>
 void Pipeline<p, P, flags>::rasterize_triangle(
 	ClippedVertex const& va, ClippedVertex const& vb, ClippedVertex const& vc,
 	std::function<void(Fragment const&)> const& emit_fragment) {
+	rasterize_triangle_impl(va, vb, vc, emit_fragment);
+}
+
+template<PrimitiveType p, class P, uint32_t flags>
+template<typename EmitFragment>
+void Pipeline<p, P, flags>::rasterize_triangle_impl(
+	ClippedVertex const& va, ClippedVertex const& vb, ClippedVertex const& vc,
+	EmitFragment const& emit_fragment) {
 	// NOTE: it is okay to restructure this function to allow these tasks to use the
 	//  same code paths. Be aware, however, that all of them need to remain working!
 	//  (e.g., if you break Flat while implementing Correct, you won't get points
@@ -664,6 +1010,176 @@ void Pipeline<p, P, flags>::rasterize_triangle(
 	}
 }
 
+/*
+ * rasterize_triangle_quads(a,b,c,emit) emits the same fragments as rasterize_triangle(a,b,c,emit),
+ * but walks the triangle's bounding box in 2x2 pixel quads, testing coverage and interpolating
+ * depth and attributes for all four pixels of a quad at once (see quad.h).
+ *
+ * Coverage (including the top-left rule on shared edges), depth, and attributes follow exactly
+ * the same steps as rasterize_triangle, so they match it bit-for-bit. Derivatives, however, are
+ * differences between neighboring pixels in each quad (as GPUs compute them), so pixels of a quad
+ * that aren't covered still have their attributes computed to serve as neighbors.
+ *
+ * Fragments are emitted a quad at a time, in rows of quads within HiZTileSize x HiZTileSize blocks
+ * (aligned to multiples of HiZTileSize), rather than in rasterize_triangle's column order; this
+ * doesn't change the framebuffer, since a triangle covers each pixel once.
+ *
+ * Blocks for which hidden_block(x, y) -- called with the block's lower-left pixel -- returns true
+ * are skipped entirely.
+ *
+ * Before attributes are interpolated, early_depth(x, y, z, covered) is called with the quad's
+ * lower-left pixel, the depths of its four pixels, and the mask of covered pixels; it returns the
+ * mask of pixels that might still be visible (the others are skipped).
+ */
+template<PrimitiveType p, class P, uint32_t flags>
+template<typename EmitFragment, typename HiddenBlock, typename EarlyDepth>
+void Pipeline<p, P, flags>::rasterize_triangle_quads(
+	ClippedVertex const& va, ClippedVertex const& vb, ClippedVertex const& vc,
+	EmitFragment const& emit_fragment, HiddenBlock const& hidden_block, EarlyDepth const& early_depth) {
+
+	Vec3 ab = vb.fb_position - va.fb_position;
+	Vec3 ac = vc.fb_position - va.fb_position;
+	Vec3 bc = vc.fb_position - vb.fb_position;
+
+	float area = cross(ab, ac).z;
+
+	if (area == 0) return;
+
+	bool is_cw = area < 0;
+
+	// a pixel is inside an edge if sign * cross(side, pixel - start).z > 0 -- or == 0, for top and left edges:
+	struct Edge {
+		float start_x, start_y;
+		float side_x, side_y;
+		float sign;
+		bool inclusive;
+	};
+	auto make_edge = [&](Vec3 start, Vec3 side, Vec3 side_to_compare) {
+		Edge edge;
+		edge.start_x = start.x;
+		edge.start_y = start.y;
+		edge.side_x = side.x;
+		edge.side_y = side.y;
+		edge.sign = cross(side, side_to_compare).z;
+		if (side.y == 0) {
+			edge.inclusive = ((side.x > 0) == is_cw);
+		} else {
+			edge.inclusive = ((side.y > 0) == is_cw);
+		}
+		return edge;
+	};
+	Edge const edges[3] = {
+		make_edge(va.fb_position, ab, ac),
+		make_edge(vb.fb_position, bc, -ab),
+		make_edge(vc.fb_position, -ac, -bc),
+	};
+
+	int32_t minx = (int32_t)std::floor(std::min({va.fb_position.x, vb.fb_position.x, vc.fb_position.x}));
+	int32_t maxx = (int32_t)std::ceil(std::max({va.fb_position.x, vb.fb_position.x, vc.fb_position.x}));
+	int32_t miny = (int32_t)std::floor(std::min({va.fb_position.y, vb.fb_position.y, vc.fb_position.y}));
+	int32_t maxy = (int32_t)std::ceil(std::max({va.fb_position.y, vb.fb_position.y, vc.fb_position.y}));
+
+	// quads start on even pixels:
+	int32_t const quad_minx = minx - (minx & 1);
+	int32_t const quad_miny = miny - (miny & 1);
+
+	Fragment frag;
+	if constexpr ((flags & PipelineMask_Interp) == Pipeline_Interp_Flat) {
+		frag.attributes = va.attributes;
+		frag.derivatives.fill(Vec2(0.0f, 0.0f));
+	}
+
+	auto block_start = [](int32_t v) {
+		return v - ((v % int32_t(HiZTileSize)) + int32_t(HiZTileSize)) % int32_t(HiZTileSize);
+	};
+
+	for (int32_t block_y = block_start(quad_miny); block_y < maxy; block_y += HiZTileSize) {
+		for (int32_t block_x = block_start(quad_minx); block_x < maxx; block_x += HiZTileSize) {
+			if (hidden_block(block_x, block_y)) continue;
+			int32_t const block_minx = std::max(block_x, quad_minx), block_maxx = std::min(block_x + int32_t(HiZTileSize), maxx);
+			int32_t const block_maxy = std::min(block_y + int32_t(HiZTileSize), maxy);
+
+			for (int32_t y = std::max(block_y, quad_miny); y < block_maxy; y += 2) {
+				Quad const y_center(y + 0.5f, y + 0.5f, (y + 1) + 0.5f, (y + 1) + 0.5f);
+				uint32_t const row_mask = (y >= miny ? 0x3 : 0x0) | (y + 1 < maxy ? 0xc : 0x0);
+
+				// the part of each edge function that only depends on y:
+				Quad edge_rows[3] = {
+					Quad(edges[0].side_x) * (y_center - Quad(edges[0].start_y)),
+					Quad(edges[1].side_x) * (y_center - Quad(edges[1].start_y)),
+					Quad(edges[2].side_x) * (y_center - Quad(edges[2].start_y)),
+				};
+
+				Quad x_center(block_minx + 0.5f, (block_minx + 1) + 0.5f, block_minx + 0.5f, (block_minx + 1) + 0.5f);
+				for (int32_t x = block_minx; x < block_maxx; x += 2, x_center = x_center + Quad(2.0f)) {
+					uint32_t covered = row_mask & ((x >= minx ? 0x5 : 0x0) | (x + 1 < maxx ? 0xa : 0x0));
+					for (uint32_t e = 0; e < 3 && covered; ++e) {
+						Quad res = Quad(edges[e].sign) * (edge_rows[e] - Quad(edges[e].side_y) * (x_center - Quad(edges[e].start_x)));
+						covered &= res.positive_mask() | (edges[e].inclusive ? res.zero_mask() : 0x0);
+					}
+					if (!covered) continue;
+
+					// barycentric coordinates:
+					Quad ap_x = x_center - Quad(va.fb_position.x), ap_y = y_center - Quad(va.fb_position.y);
+					Quad bp_x = x_center - Quad(vb.fb_position.x), bp_y = y_center - Quad(vb.fb_position.y);
+					Quad cp_x = x_center - Quad(vc.fb_position.x), cp_y = y_center - Quad(vc.fb_position.y);
+					Quad bary_x = (bp_x * cp_y - bp_y * cp_x) / Quad(area);
+					Quad bary_y = (cp_x * ap_y - cp_y * ap_x) / Quad(area);
+					Quad bary_z = Quad(1.0f) - bary_x - bary_y;
+
+					float xs[4], ys[4], zs[4];
+					(bary_x * Quad(va.fb_position.z) + bary_y * Quad(vb.fb_position.z) + bary_z * Quad(vc.fb_position.z)).store(zs);
+					covered = early_depth(x, y, zs, covered);
+					if (!covered) continue;
+					x_center.store(xs);
+					y_center.store(ys);
+
+					// attributes (and derivatives) for every pixel of the quad:
+					float attributes[FA][4];
+					float derivatives[FD][2][4];
+					if constexpr ((flags & PipelineMask_Interp) != Pipeline_Interp_Flat) {
+						Quad inv_w_sum(0.0f);
+						if constexpr ((flags & PipelineMask_Interp) == Pipeline_Interp_Correct) {
+							inv_w_sum = bary_x * Quad(va.inv_w) + bary_y * Quad(vb.inv_w) + bary_z * Quad(vc.inv_w);
+						}
+						for (uint32_t i = 0; i < FA; i++) {
+							Quad attribute(0.0f);
+							if constexpr ((flags & PipelineMask_Interp) == Pipeline_Interp_Smooth) {
+								attribute = Quad(va.attributes[i]) * bary_x + Quad(vb.attributes[i]) * bary_y + Quad(vc.attributes[i]) * bary_z;
+							} else if constexpr ((flags & PipelineMask_Interp) == Pipeline_Interp_Correct) {
+								attribute = (
+									Quad(va.attributes[i]) * bary_x * Quad(va.inv_w)
+									+ Quad(vb.attributes[i]) * bary_y * Quad(vb.inv_w)
+									+ Quad(vc.attributes[i]) * bary_z * Quad(vc.inv_w)
+								) / inv_w_sum;
+							}
+							attribute.store(attributes[i]);
+							if (i < FD) {
+								attribute.dx().store(derivatives[i][0]);
+								attribute.dy().store(derivatives[i][1]);
+							}
+						}
+					}
+
+					for (uint32_t q = 0; q < 4; ++q) {
+						if (!(covered & (1 << q))) continue;
+						frag.fb_position = Vec3(xs[q], ys[q], zs[q]);
+						if constexpr ((flags & PipelineMask_Interp) != Pipeline_Interp_Flat) {
+							for (uint32_t i = 0; i < FA; i++) {
+								frag.attributes[i] = attributes[i][q];
+							}
+							for (uint32_t i = 0; i < FD; i++) {
+								frag.derivatives[i] = Vec2(derivatives[i][0][q], derivatives[i][1][q]);
+							}
+						}
+						emit_fragment(frag);
+					}
+				}
+			}
+		}
+	}
+}
+
 //-------------------------------------------------------------------------
 // compile instantiations for all programs and blending and testing types:
 
@@ -687,6 +1203,12 @@ template struct Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
                          Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Smooth>;
 template struct Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
                          Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Correct>;
+template struct Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
+                         Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Flat | Pipeline_CullBackBit>;
+template struct Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
+                         Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Smooth | Pipeline_CullBackBit>;
+template struct Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
+                         Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Correct | Pipeline_CullBackBit>;
 template struct Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
                          Pipeline_Blend_Add | Pipeline_Depth_Always | Pipeline_Interp_Flat>;
 template struct Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
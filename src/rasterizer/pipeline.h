@@ -19,6 +19,7 @@ enum class PrimitiveType {
 	Lines,    // interpret (vertices[2i], vertices[2i+1]) as a line
 	Triangles // interpret (vertices[3i], vertices[3i+1], vertices[3i+2]) as a triangle
 };
+// (indexed runs interpret indices the same way -- see Pipeline::run)
 
 //Other behavior is captured by a set of flags:
 enum PipelineFlags : uint32_t {
@@ -26,6 +27,8 @@ enum PipelineFlags : uint32_t {
 
 	Pipeline_ColorWriteDisableBit = 0x4000, //if 1, color buffer writes are disabled
 
+	Pipeline_CullBackBit = 0x2000, //if 1, back-facing (clockwise in the framebuffer) triangles are discarded after vertex shading
+
 	Pipeline_Blend_Replace  = 0x0, //incoming fragment color replaces framebuffer color
 	Pipeline_Blend_Add      = 0x1, //incoming fragment color sums with framebuffer color
 	Pipeline_Blend_Over     = 0x2, //incoming fragment color is 'over blended' using opacity
@@ -44,6 +47,11 @@ enum PipelineFlags : uint32_t {
 	PipelineMask_Interp     = 0x0f00, //next four bits for interpolation mode
 };
 
+//Pipeline::run can count the work it skipped (counts are added to, so one PipelineStats can total several runs):
+struct PipelineStats {
+	uint32_t backfacing_triangles = 0; //triangles discarded by Pipeline_CullBackBit
+};
+
 //A Pipeline processes vertices (fixed-length packets of opaque attributes):
 template<uint32_t VA>
 struct Vertex {
@@ -99,6 +107,21 @@ struct Pipeline {
 	static_assert(uint32_t(FD) <= uint32_t(FA),
 	              "Program requests no more derivatives than attributes.");
 
+	// parallel runs bin fragments into TileSize x TileSize pixel tiles:
+	enum { TileSize = 64 };
+	// ...but only for draws with at least this many primitives (smaller draws aren't worth splitting):
+	enum { ParallelMinPrimitives = 64 };
+	// ...and split primitives into chunks of this many for clipping and rasterizing:
+	//  (single-threaded runs use chunks of ChunkPrimitives / samples, drawn to every sample in turn)
+	enum { ChunkPrimitives = 256 };
+	// single-threaded runs process fragments in batches of this many as they are rasterized:
+	enum { FragmentBatch = 64 };
+	// Depth_Less runs skip triangles (and blocks of triangles) hidden behind the largest depth in
+	//  HiZTileSize x HiZTileSize blocks of the framebuffer (the framebuffer's storage tiles):
+	enum { HiZTileSize = 8 };
+	//  (only triangles whose bounding boxes cover at least this many pixels are tested against those blocks)
+	enum { HiZMinArea = 256 };
+
 	// When run, the pipeline...
 
 	//(1) starts with an array of Vertices:
@@ -139,6 +162,23 @@ struct Pipeline {
 		std::function< void(Fragment const &) > const &emit_fragment //call with every fragment covered by the triangle
 	);
 
+	// the functions above are wrappers around these versions, which take any callable, so that
+	// run() can call them with emit functions the compiler can inline:
+	template< typename EmitVertex >
+	static void clip_line_impl(ShadedVertex const &a, ShadedVertex const &b, EmitVertex const &emit_vertex);
+	template< typename EmitVertex >
+	static void clip_triangle_impl(ShadedVertex const &a, ShadedVertex const &b, ShadedVertex const &c, EmitVertex const &emit_vertex);
+	template< typename EmitFragment >
+	static void rasterize_line_impl(ClippedVertex const &a, ClippedVertex const &b, EmitFragment const &emit_fragment);
+	template< typename EmitFragment >
+	static void rasterize_triangle_impl(ClippedVertex const &a, ClippedVertex const &b, ClippedVertex const &c, EmitFragment const &emit_fragment);
+
+	// run() rasterizes triangles with this version, which works on 2x2 pixel quads at once
+	//  (same coverage, depth, and attributes as rasterize_triangle; derivatives come from the quads;
+	//   hidden_block and early_depth can skip hidden blocks and pixels before attributes are computed):
+	template< typename EmitFragment, typename HiddenBlock, typename EarlyDepth >
+	static void rasterize_triangle_quads(ClippedVertex const &a, ClippedVertex const &b, ClippedVertex const &c, EmitFragment const &emit_fragment, HiddenBlock const &hidden_block, EarlyDepth const &early_depth);
+
 	//(7) tests fragment depths vs depth buffer (based on flags)
 
 	//(8) transforms fragments via Program::shade_fragment() to produce a color and opacity, stored
@@ -151,6 +191,22 @@ struct Pipeline {
 	// 		vertices: list of vertices to rasterize
 	//  	parameters: global parameters for vertex and fragment programs
 	//  	framebuffer (must not be null): framebuffer to write results into
+	//  	stats (may be null): counts of skipped work are added here
+	//  (if the framebuffer has a thread_pool, steps run in parallel -- see run() for how -- with the same results)
 	static void run(std::vector<Vertex> const& vertices,
-	                typename Program::Parameters const& parameters, Framebuffer* framebuffer);
+	                typename Program::Parameters const& parameters, Framebuffer* framebuffer,
+	                PipelineStats* stats = nullptr);
+
+	// Indexed version -- primitives are assembled from vertices[indices[...]] instead of vertices[...]:
+	// 		vertices: list of vertices, each shaded once (however many primitives use it)
+	// 		indices: list of indices into vertices, interpreted like vertices in PrimitiveType
+	//  (throws if an index is out of range)
+	static void run(std::vector<Vertex> const& vertices, std::vector<uint32_t> const& indices,
+	                typename Program::Parameters const& parameters, Framebuffer* framebuffer,
+	                PipelineStats* stats = nullptr);
+
+	// both versions of run() call this (indices is null for the non-indexed version):
+	static void run_impl(std::vector<Vertex> const& vertices, std::vector<uint32_t> const* indices,
+	                     typename Program::Parameters const& parameters, Framebuffer* framebuffer,
+	                     PipelineStats* stats);
 };
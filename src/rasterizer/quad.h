@@ -0,0 +1,72 @@
+#pragma once
+// clang-format off
+/*
+ * Quad holds one float for each pixel of a 2x2 block ("quad") of pixels, stored in the order
+ *   (x,y), (x+1,y), (x,y+1), (x+1,y+1)
+ * and does arithmetic on all four at once -- with SSE where it is available, and with plain
+ * loops (which the compiler may vectorize on its own) elsewhere.
+ *
+ * Each operation rounds exactly like the same scalar float operation, so code written with Quads
+ * gets the same results as scalar code doing the same steps one pixel at a time.
+ *
+ */
+#include <cstdint>
+
+#include "../lib/simd.h"
+
+struct Quad {
+#if SIMD_SSE
+	__m128 v;
+	explicit Quad(__m128 v_) : v(v_) { }
+	Quad(float a, float b, float c, float d) : v(_mm_setr_ps(a, b, c, d)) { }
+	explicit Quad(float s) : v(_mm_set1_ps(s)) { }
+
+	float operator[](uint32_t i) const {
+		alignas(16) float f[4];
+		_mm_store_ps(f, v);
+		return f[i];
+	}
+	static Quad load(float const *in) { return Quad(_mm_loadu_ps(in)); }
+	void store(float *out) const { _mm_storeu_ps(out, v); }
+
+	Quad operator+(Quad o) const { return Quad(_mm_add_ps(v, o.v)); }
+	Quad operator-(Quad o) const { return Quad(_mm_sub_ps(v, o.v)); }
+	Quad operator*(Quad o) const { return Quad(_mm_mul_ps(v, o.v)); }
+	Quad operator/(Quad o) const { return Quad(_mm_div_ps(v, o.v)); }
+
+	// bit i of the result is set if pixel i's value is > 0 (or == 0):
+	uint32_t positive_mask() const { return uint32_t(_mm_movemask_ps(_mm_cmpgt_ps(v, _mm_setzero_ps()))); }
+	uint32_t zero_mask() const { return uint32_t(_mm_movemask_ps(_mm_cmpeq_ps(v, _mm_setzero_ps()))); }
+
+	// differences between horizontal (dx) and vertical (dy) neighbors, shared by both pixels of each pair:
+	Quad dx() const {
+		return Quad(_mm_sub_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 3, 1, 1)), _mm_shuffle_ps(v, v, _MM_SHUFFLE(2, 2, 0, 0))));
+	}
+	Quad dy() const {
+		return Quad(_mm_sub_ps(_mm_shuffle_ps(v, v, _MM_SHUFFLE(3, 2, 3, 2)), _mm_shuffle_ps(v, v, _MM_SHUFFLE(1, 0, 1, 0))));
+	}
+#else
+	float v[4];
+	Quad(float a, float b, float c, float d) : v{a, b, c, d} { }
+	explicit Quad(float s) : v{s, s, s, s} { }
+
+	float operator[](uint32_t i) const { return v[i]; }
+	static Quad load(float const *in) { return Quad(in[0], in[1], in[2], in[3]); }
+	void store(float *out) const { for (uint32_t i = 0; i < 4; ++i) out[i] = v[i]; }
+
+	Quad operator+(Quad o) const { return Quad(v[0] + o.v[0], v[1] + o.v[1], v[2] + o.v[2], v[3] + o.v[3]); }
+	Quad operator-(Quad o) const { return Quad(v[0] - o.v[0], v[1] - o.v[1], v[2] - o.v[2], v[3] - o.v[3]); }
+	Quad operator*(Quad o) const { return Quad(v[0] * o.v[0], v[1] * o.v[1], v[2] * o.v[2], v[3] * o.v[3]); }
+	Quad operator/(Quad o) const { return Quad(v[0] / o.v[0], v[1] / o.v[1], v[2] / o.v[2], v[3] / o.v[3]); }
+
+	uint32_t positive_mask() const {
+		return uint32_t(v[0] > 0.0f) | uint32_t(v[1] > 0.0f) << 1 | uint32_t(v[2] > 0.0f) << 2 | uint32_t(v[3] > 0.0f) << 3;
+	}
+	uint32_t zero_mask() const {
+		return uint32_t(v[0] == 0.0f) | uint32_t(v[1] == 0.0f) << 1 | uint32_t(v[2] == 0.0f) << 2 | uint32_t(v[3] == 0.0f) << 3;
+	}
+
+	Quad dx() const { return Quad(v[1] - v[0], v[1] - v[0], v[3] - v[2], v[3] - v[2]); }
+	Quad dy() const { return Quad(v[2] - v[0], v[3] - v[1], v[2] - v[0], v[3] - v[1]); }
+#endif
+};
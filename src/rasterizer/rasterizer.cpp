@@ -2,12 +2,16 @@
 #include "rasterizer.h"
 #include "../geometry/util.h"
 #include "../scene/scene.h"
+#include "../util/thread_pool.h"
 #include "../util/timer.h"
 #include "framebuffer.h"
 #include "pipeline.h"
 #include "programs.h"
 #include "sample_pattern.h"
 
+#include <cstring>
+#include <unordered_map>
+
 struct RasterJob {
 	// used to tell the job to quit early:
 	bool quit = false;
@@ -54,6 +58,16 @@ struct RasterJob {
 	using Lambertian_Triangles_Replace_Less_Correct_Pipeline =
 		Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
 	             Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Correct>;
+	// ...and versions of the Replace + Less ones that skip back faces (used when they are sure to be hidden):
+	using Lambertian_Triangles_Replace_Less_Flat_Cull_Pipeline =
+		Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
+	             Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Flat | Pipeline_CullBackBit>;
+	using Lambertian_Triangles_Replace_Less_Smooth_Cull_Pipeline =
+		Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
+	             Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Smooth | Pipeline_CullBackBit>;
+	using Lambertian_Triangles_Replace_Less_Correct_Cull_Pipeline =
+		Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
+	             Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Correct | Pipeline_CullBackBit>;
 	using Lambertian_Triangles_Add_Always_Flat_Pipeline =
 		Pipeline<PrimitiveType::Triangles, Programs::Lambertian,
 	             Pipeline_Blend_Add | Pipeline_Depth_Always | Pipeline_Interp_Flat>;
@@ -142,8 +156,13 @@ struct RasterJob {
 
 	struct Mesh {
 		Halfedge_Mesh source;
-		std::vector<Lambertian_Replace_Less_Correct_Vertex> lamb_triangles;
-		std::vector<Lambertian_Replace_Less_Correct_Vertex> lamb_edges;
+		std::vector<Lambertian_Replace_Less_Correct_Vertex> lamb_vertices; // corners of faces (identical corners merged)
+		std::vector<uint32_t> lamb_triangles; // indices into lamb_vertices, three per triangle
+		std::vector<uint32_t> lamb_edges; // indices into lamb_vertices, two per line
+		// computed at the start of run(), for culling:
+		BBox bbox; // bounds of source's vertices
+		uint32_t triangles = 0; // number of triangles drawn for source (faces split into fans)
+		bool closed_outward = false; // source has no boundary, and its faces are counter-clockwise seen from outside
 	};
 	std::vector<Mesh> meshes;
 	struct Instance {
@@ -167,6 +186,10 @@ struct RasterJob {
 
 	// camera info:
 	Mat4 world_to_clip; // camera.proj() * camera.world_to_local()
+	bool mirrored_view; // camera.world_to_local() flips handedness (so front faces look clockwise)
+
+	// culling counts (see Rasterizer::Cull_Stats):
+	Rasterizer::Cull_Stats cull_stats;
 
 	// reporting function:
 	std::function<void(Rasterizer::Render_Report)> report_fn;
@@ -176,11 +199,21 @@ struct RasterJob {
 
 	// copy data into this raster job:
 	RasterJob(Scene const& scene, ::Instance::Camera const& camera,
-	          std::function<void(Rasterizer::Render_Report)>&& report_fn_)
+	          std::function<void(Rasterizer::Render_Report)>&& report_fn_, Thread_Pool* thread_pool)
 		: report_fn(report_fn_),
 		  framebuffer(camera.camera.lock()->film.width, camera.camera.lock()->film.height,
 	                  *SamplePattern::from_id(camera.camera.lock()->film.sample_pattern)) {
 
+		// only the camera's crop window gets drawn:
+		Camera::Film_Rect crop = camera.camera.lock()->crop_rect();
+		framebuffer.set_scissor(crop.x_begin, crop.x_end, crop.y_begin, crop.y_end);
+
+		// split draws over the caller's workers, if there are several:
+		//  (the job itself runs on its own thread, so waiting on these can't deadlock)
+		if (thread_pool && thread_pool->size() > 1) {
+			framebuffer.thread_pool = thread_pool;
+		}
+
 		// copy scene data:
 
 		// Scene Textures get converted to images:
@@ -356,6 +389,42 @@ struct RasterJob {
 		// copy camera info:
 		world_to_clip =
 			camera.camera.lock()->projection() * camera.transform.lock()->world_to_local();
+		mirrored_view = camera.transform.lock()->world_to_local().det() < 0.0f;
+	}
+
+	// true if box (in local space) is entirely outside the view -- that is, if all of its corners are
+	// outside one clipping plane (-w <= x,y,z <= w, with x and y narrowed to the scissor rectangle):
+	bool outside_view(BBox const& box, Mat4 const& local_to_clip) const {
+		// scissor rectangle in normalized device coordinates, padded by a pixel (lines cover pixels they pass near):
+		float x_min = 2.0f * (float(framebuffer.scissor_x_begin) - 1.0f) / framebuffer.width - 1.0f;
+		float x_max = 2.0f * (float(framebuffer.scissor_x_end) + 1.0f) / framebuffer.width - 1.0f;
+		float y_min = 2.0f * (float(framebuffer.scissor_y_begin) - 1.0f) / framebuffer.height - 1.0f;
+		float y_max = 2.0f * (float(framebuffer.scissor_y_end) + 1.0f) / framebuffer.height - 1.0f;
+
+		// bit i set for corners outside plane i:
+		uint32_t outside_all = 0x3f;
+		for (Vec3 const& corner : box.corners()) {
+			Vec4 p = local_to_clip * Vec4(corner, 1.0f);
+			uint32_t outside = 0;
+			if (p.x < x_min * p.w) outside |= 0x01;
+			if (p.x > x_max * p.w) outside |= 0x02;
+			if (p.y < y_min * p.w) outside |= 0x04;
+			if (p.y > y_max * p.w) outside |= 0x08;
+			if (p.z < -p.w) outside |= 0x10;
+			if (p.z > p.w) outside |= 0x20;
+			outside_all &= outside;
+		}
+		return outside_all != 0;
+	}
+
+	// true if box (in local space) is entirely in front of the near plane -- so the camera is outside anything
+	// inside it, and nothing inside it gets clipped by the near plane:
+	static bool in_front_of_near(BBox const& box, Mat4 const& local_to_clip) {
+		for (Vec3 const& corner : box.corners()) {
+			Vec4 p = local_to_clip * Vec4(corner, 1.0f);
+			if (!(p.z > -p.w)) return false;
+		}
+		return true;
 	}
 
 	// actually run the raster job:
@@ -370,6 +439,28 @@ struct RasterJob {
 			std::vector<Indexed_Mesh::Vert> const& vertices = indexed.vertices();
 			std::vector<Indexed_Mesh::Index> const& indices = indexed.indices();
 
+			// SplitEdges gives every corner of every face its own vertex; corners with the same attributes
+			// (e.g., at a vertex of a smooth-shaded mesh) are merged so Pipeline::run only shades them once:
+			using Attributes = decltype(Lambertian_Replace_Less_Correct_Vertex::attributes);
+			struct Hash {
+				size_t operator()(Attributes const& attributes) const {
+					size_t h = 0;
+					for (float f : attributes) {
+						uint32_t bits;
+						std::memcpy(&bits, &f, sizeof(bits));
+						h = h * 0x9e3779b1u + bits;
+					}
+					return h;
+				}
+			};
+			struct Equal { //(compares bits, so 0.0f and -0.0f stay separate, since they might shade differently)
+				bool operator()(Attributes const& a, Attributes const& b) const {
+					return std::memcmp(a.data(), b.data(), sizeof(Attributes)) == 0;
+				}
+			};
+			std::unordered_map<Attributes, uint32_t, Hash, Equal> merged;
+			merged.reserve(vertices.size());
+
 			mesh->lamb_triangles.reserve(indices.size());
 			for (auto i : indices) {
 				Indexed_Mesh::Vert const& iv = vertices[i];
@@ -382,8 +473,11 @@ struct RasterJob {
 				v.attributes[Programs::Lambertian::VA_NormalZ] = iv.norm.z;
 				v.attributes[Programs::Lambertian::VA_TexCoordU] = iv.uv.x;
 				v.attributes[Programs::Lambertian::VA_TexCoordV] = iv.uv.y;
-				mesh->lamb_triangles.emplace_back(v);
+				auto [at, added] = merged.emplace(v.attributes, uint32_t(mesh->lamb_vertices.size()));
+				if (added) mesh->lamb_vertices.emplace_back(v);
+				mesh->lamb_triangles.emplace_back(at->second);
 			}
+
 		};
 
 		// helper function that caches triangle attributes for using Programs::Lambertian to draw
@@ -422,15 +516,53 @@ struct RasterJob {
 		parameters.ground_energy = ground_energy;
 		parameters.sky_direction = sky_direction;
 
+		// bounds, triangle counts, and orientation of every mesh (for culling):
+		for (auto& mesh : meshes) {
+			for (auto const& vertex : mesh.source.vertices) {
+				mesh.bbox.enclose(vertex.position);
+			}
+			float volume = 0.0f; // (six times the enclosed volume, if the mesh is closed)
+			for (auto const& face : mesh.source.faces) {
+				if (face.boundary) continue;
+				// (split into a fan, as Indexed_Mesh::from_halfedge_mesh does:)
+				auto h = face.halfedge;
+				Vec3 first = h->vertex->position;
+				for (h = h->next; h->next != face.halfedge; h = h->next) {
+					volume += dot(first, cross(h->vertex->position, h->next->vertex->position));
+					mesh.triangles += 1;
+				}
+			}
+			mesh.closed_outward = mesh.source.n_boundaries() == 0 && volume > 0.0f;
+		}
+
 		uint32_t done = 0;
 		uint32_t count = static_cast<uint32_t>(instances.size());
 
+		// counts of triangles skipped by pipelines:
+		PipelineStats pipeline_stats;
+
 		for (auto const& instance : instances) {
 			if (quit) break;
 			if (instance.material->type == Material::Type::Lambertian) {
 				parameters.local_to_clip = world_to_clip * instance.local_to_world;
 				parameters.normal_to_world = normal_to_world(instance.local_to_world);
 
+				// skip instances that can't cover any pixels:
+				cull_stats.instances += 1;
+				if (outside_view(instance.mesh->bbox, parameters.local_to_clip)) {
+					cull_stats.culled_instances += 1;
+					cull_stats.culled_triangles += instance.mesh->triangles;
+					done += 1;
+					continue;
+				}
+
+				// with depth testing and no blending, back faces of a closed mesh are always hidden behind its
+				// front faces -- as long as the camera is outside the mesh and the near plane doesn't cut it open:
+				bool const cull_back_faces =
+					instance.blend_style == BlendStyle::Replace && instance.depth_style == DepthStyle::Less &&
+					instance.mesh->closed_outward && (instance.local_to_world.det() < 0.0f) == mirrored_view &&
+					in_front_of_near(instance.mesh->bbox, parameters.local_to_clip);
+
 				parameters.image = instance.material->image;
 				// std::string desc = "Rasterizing instance '" + instance.name + "'"; //DEBUG
 				if (instance.draw_style == DrawStyle::Wireframe) {
@@ -441,13 +573,13 @@ struct RasterJob {
 					// info("%s",desc.c_str()); //DEBUG
 					if (instance.blend_style == BlendStyle::Replace) {
 						if (instance.depth_style == DepthStyle::Always) {
-							Lambertian_Lines_Replace_Always_Pipeline::run(instance.mesh->lamb_edges,
+							Lambertian_Lines_Replace_Always_Pipeline::run(instance.mesh->lamb_vertices, instance.mesh->lamb_edges,
 							                                              parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
-							Lambertian_Lines_Replace_Never_Pipeline::run(instance.mesh->lamb_edges,
+							Lambertian_Lines_Replace_Never_Pipeline::run(instance.mesh->lamb_vertices, instance.mesh->lamb_edges,
 							                                             parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
-							Lambertian_Lines_Replace_Less_Pipeline::run(instance.mesh->lamb_edges,
+							Lambertian_Lines_Replace_Less_Pipeline::run(instance.mesh->lamb_vertices, instance.mesh->lamb_edges,
 							                                            parameters, &framebuffer);
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
@@ -455,13 +587,13 @@ struct RasterJob {
 						}
 					} else if (instance.blend_style == BlendStyle::Add) {
 						if (instance.depth_style == DepthStyle::Always) {
-							Lambertian_Lines_Add_Always_Pipeline::run(instance.mesh->lamb_edges,
+							Lambertian_Lines_Add_Always_Pipeline::run(instance.mesh->lamb_vertices, instance.mesh->lamb_edges,
 							                                          parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
-							Lambertian_Lines_Add_Never_Pipeline::run(instance.mesh->lamb_edges,
+							Lambertian_Lines_Add_Never_Pipeline::run(instance.mesh->lamb_vertices, instance.mesh->lamb_edges,
 							                                         parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
-							Lambertian_Lines_Add_Less_Pipeline::run(instance.mesh->lamb_edges,
+							Lambertian_Lines_Add_Less_Pipeline::run(instance.mesh->lamb_vertices, instance.mesh->lamb_edges,
 							                                        parameters, &framebuffer);
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
@@ -469,13 +601,13 @@ struct RasterJob {
 						}
 					} else if (instance.blend_style == BlendStyle::Over) {
 						if (instance.depth_style == DepthStyle::Always) {
-							Lambertian_Lines_Over_Always_Pipeline::run(instance.mesh->lamb_edges,
+							Lambertian_Lines_Over_Always_Pipeline::run(instance.mesh->lamb_vertices, instance.mesh->lamb_edges,
 							                                           parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
-							Lambertian_Lines_Over_Never_Pipeline::run(instance.mesh->lamb_edges,
+							Lambertian_Lines_Over_Never_Pipeline::run(instance.mesh->lamb_vertices, instance.mesh->lamb_edges,
 							                                          parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
-							Lambertian_Lines_Over_Less_Pipeline::run(instance.mesh->lamb_edges,
+							Lambertian_Lines_Over_Less_Pipeline::run(instance.mesh->lamb_vertices, instance.mesh->lamb_edges,
 							                                         parameters, &framebuffer);
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
@@ -494,13 +626,18 @@ struct RasterJob {
 					if (instance.blend_style == BlendStyle::Replace) {
 						if (instance.depth_style == DepthStyle::Always) {
 							Lambertian_Triangles_Replace_Always_Flat_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
 							Lambertian_Triangles_Replace_Never_Flat_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
-							Lambertian_Triangles_Replace_Less_Flat_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+							if (cull_back_faces) {
+								Lambertian_Triangles_Replace_Less_Flat_Cull_Pipeline::run(
+									instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer, &pipeline_stats);
+							} else {
+								Lambertian_Triangles_Replace_Less_Flat_Pipeline::run(
+									instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
+							}
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
 							// depth style)"; //DEBUG
@@ -508,13 +645,13 @@ struct RasterJob {
 					} else if (instance.blend_style == BlendStyle::Add) {
 						if (instance.depth_style == DepthStyle::Always) {
 							Lambertian_Triangles_Add_Always_Flat_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
 							Lambertian_Triangles_Add_Never_Flat_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
 							Lambertian_Triangles_Add_Less_Flat_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
 							// depth style)"; //DEBUG
@@ -522,13 +659,13 @@ struct RasterJob {
 					} else if (instance.blend_style == BlendStyle::Over) {
 						if (instance.depth_style == DepthStyle::Always) {
 							Lambertian_Triangles_Over_Always_Flat_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
 							Lambertian_Triangles_Over_Never_Flat_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
 							Lambertian_Triangles_Over_Less_Flat_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
 							// depth style)"; //DEBUG
@@ -546,13 +683,18 @@ struct RasterJob {
 					if (instance.blend_style == BlendStyle::Replace) {
 						if (instance.depth_style == DepthStyle::Always) {
 							Lambertian_Triangles_Replace_Always_Smooth_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
 							Lambertian_Triangles_Replace_Never_Smooth_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
-							Lambertian_Triangles_Replace_Less_Smooth_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+							if (cull_back_faces) {
+								Lambertian_Triangles_Replace_Less_Smooth_Cull_Pipeline::run(
+									instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer, &pipeline_stats);
+							} else {
+								Lambertian_Triangles_Replace_Less_Smooth_Pipeline::run(
+									instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
+							}
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
 							// depth style)"; //DEBUG
@@ -560,13 +702,13 @@ struct RasterJob {
 					} else if (instance.blend_style == BlendStyle::Add) {
 						if (instance.depth_style == DepthStyle::Always) {
 							Lambertian_Triangles_Add_Always_Smooth_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
 							Lambertian_Triangles_Add_Never_Smooth_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
 							Lambertian_Triangles_Add_Less_Smooth_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
 							// depth style)"; //DEBUG
@@ -574,13 +716,13 @@ struct RasterJob {
 					} else if (instance.blend_style == BlendStyle::Over) {
 						if (instance.depth_style == DepthStyle::Always) {
 							Lambertian_Triangles_Over_Always_Smooth_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
 							Lambertian_Triangles_Over_Never_Smooth_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
 							Lambertian_Triangles_Over_Less_Smooth_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
 							// depth style)"; //DEBUG
@@ -598,13 +740,18 @@ struct RasterJob {
 					if (instance.blend_style == BlendStyle::Replace) {
 						if (instance.depth_style == DepthStyle::Always) {
 							Lambertian_Triangles_Replace_Always_Correct_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
 							Lambertian_Triangles_Replace_Never_Correct_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
-							Lambertian_Triangles_Replace_Less_Correct_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+							if (cull_back_faces) {
+								Lambertian_Triangles_Replace_Less_Correct_Cull_Pipeline::run(
+									instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer, &pipeline_stats);
+							} else {
+								Lambertian_Triangles_Replace_Less_Correct_Pipeline::run(
+									instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
+							}
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
 							// depth style)"; //DEBUG
@@ -612,13 +759,13 @@ struct RasterJob {
 					} else if (instance.blend_style == BlendStyle::Add) {
 						if (instance.depth_style == DepthStyle::Always) {
 							Lambertian_Triangles_Add_Always_Correct_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
 							Lambertian_Triangles_Add_Never_Correct_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
 							Lambertian_Triangles_Add_Less_Correct_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
 							// depth style)"; //DEBUG
@@ -626,13 +773,13 @@ struct RasterJob {
 					} else if (instance.blend_style == BlendStyle::Over) {
 						if (instance.depth_style == DepthStyle::Always) {
 							Lambertian_Triangles_Over_Always_Correct_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Never) {
 							Lambertian_Triangles_Over_Never_Correct_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else if (instance.depth_style == DepthStyle::Less) {
 							Lambertian_Triangles_Over_Less_Correct_Pipeline::run(
-								instance.mesh->lamb_triangles, parameters, &framebuffer);
+								instance.mesh->lamb_vertices, instance.mesh->lamb_triangles, parameters, &framebuffer);
 						} else {
 							// desc = "!!!SKIPPING!!! instance '" + instance.name + "' (unknown
 							// depth style)"; //DEBUG
@@ -651,15 +798,16 @@ struct RasterJob {
 			done += 1;
 			report_fn(std::make_pair(done / float(count), framebuffer.resolve_colors()));
 		}
+		cull_stats.backfacing_triangles = pipeline_stats.backfacing_triangles;
 		report_fn(std::make_pair(1.0f, framebuffer.resolve_colors()));
 	}
 };
 
 Rasterizer::Rasterizer(Scene const& scene, Instance::Camera const& camera,
-                       std::function<void(Render_Report)>&& report_fn) {
+                       std::function<void(Render_Report)>&& report_fn, Thread_Pool* thread_pool) {
 
 	// copy data into the rasterization job:
-	job = std::make_unique<RasterJob>(scene, camera, std::move(report_fn));
+	job = std::make_unique<RasterJob>(scene, camera, std::move(report_fn), thread_pool);
 
 	// get pointer to output framebuffer (for later use):
 	framebuffer = &job->framebuffer;
@@ -667,12 +815,13 @@ Rasterizer::Rasterizer(Scene const& scene, Instance::Camera const& camera,
 	// start the rasterization job (asynchronously):
 	future = std::async(
 		std::launch::async,
-		[](RasterJob* job, float* completion_time) {
+		[](RasterJob* job, float* completion_time, Cull_Stats* cull_stats) {
 			Timer timer;
 			job->run();
 			*completion_time = timer.s();
+			*cull_stats = job->cull_stats;
 		},
-		job.get(), &completion_time);
+		job.get(), &completion_time, &cull_stats);
 }
 
 Rasterizer::~Rasterizer() {
@@ -14,6 +14,7 @@
 #include "../util/hdr_image.h"
 
 class Scene;
+class Thread_Pool;
 struct RasterJob;
 struct Framebuffer;
 namespace Instance {
@@ -39,8 +40,11 @@ public:
 	// render) camera does not need to be member of the scene report_fn will be called with updates
 	// on progress and copies of the image produced so far.
 	// 		(report_fn will run in a separate thread! be careful to synchronize.)
+	//
+	// if thread_pool is given, draws are split over its workers. it must outlive the rasterizer, and
+	// is meant to be kept for many renders (rather than starting new threads for every render).
 	Rasterizer(Scene const& scene, Instance::Camera const& camera,
-	           std::function<void(Render_Report)>&& report_fn);
+	           std::function<void(Render_Report)>&& report_fn, Thread_Pool* thread_pool = nullptr);
 
 	// Destroying the rasterizer will cancel rasterization:
 	~Rasterizer();
@@ -62,6 +66,15 @@ public:
 	float completion_time = std::numeric_limits<float>::quiet_NaN();
 	Framebuffer const* framebuffer; // points into the RasterJob
 
+	// work skipped by culling:
+	struct Cull_Stats {
+		uint32_t instances = 0; // instances considered for drawing
+		uint32_t culled_instances = 0; // ...of which were skipped for being outside the view
+		uint32_t culled_triangles = 0; // triangles in those skipped instances
+		uint32_t backfacing_triangles = 0; // back-facing triangles discarded by pipelines
+	};
+	Cull_Stats cull_stats;
+
 	// since 'Rasterizer' represents a unique running rasterization thread, you can't copy it:
 	Rasterizer(Rasterizer const&) = delete;
 
@@ -33,11 +33,41 @@ std::pair<Ray, float> Camera::sample_ray(RNG &rng, uint32_t px, uint32_t py) {
 	ray.point = Vec3(); //ray should start at the origin
 	ray.dir = Vec3(0,0,-1); //TODO: compute from sensor plane position
 	ray.depth = film.max_ray_depth; //rays should, by default, go as deep as the max depth parameter allows
+	ray.cone_spread = 2.0f * std::tan(Radians(vertical_fov) / 2.0f) / film.height; //(angle covered by one pixel)
 	
    	return {ray, offset_pdf};
 }
 
 
+Camera::Film_Rect Camera::crop_rect() const {
+	Film_Rect rect;
+	rect.x_end = film.width;
+	rect.y_end = film.height;
+	if (film.crop_width == 0 || film.crop_height == 0) return rect;
+
+	//(64-bit sums, so huge crop sizes can't wrap around)
+	rect.x_begin = uint32_t(std::min< uint64_t >(film.crop_x, film.width));
+	rect.y_begin = uint32_t(std::min< uint64_t >(film.crop_y, film.height));
+	rect.x_end = uint32_t(std::min< uint64_t >(uint64_t(film.crop_x) + film.crop_width, film.width));
+	rect.y_end = uint32_t(std::min< uint64_t >(uint64_t(film.crop_y) + film.crop_height, film.height));
+	return rect;
+}
+
+bool Camera::cropped() const {
+	Film_Rect rect = crop_rect();
+	return rect.width() != film.width || rect.height() != film.height;
+}
+
+void Camera::crop_from_top_left(uint32_t x, uint32_t y, uint32_t width, uint32_t height) {
+	x = std::min(x, film.width);
+	y = std::min(y, film.height);
+	film.crop_x = x;
+	film.crop_width = std::min(width, film.width - x);
+	film.crop_height = std::min(height, film.height - y);
+	//(film pixels count from the bottom-left)
+	film.crop_y = film.height - y - film.crop_height;
+}
+
 Mat4 Camera::projection() const {
 	return Mat4::perspective(vertical_fov, aspect_ratio, near_plane);
 }
@@ -84,5 +114,7 @@ bool operator!=(const Camera& a, const Camera& b) {
 	       || a.film.width != b.film.width || a.film.height != b.film.height
 	       || a.film.samples != b.film.samples || a.film.max_ray_depth != b.film.max_ray_depth
 	       || a.film.sample_pattern != b.film.sample_pattern
+	       || a.film.crop_x != b.film.crop_x || a.film.crop_y != b.film.crop_y
+	       || a.film.crop_width != b.film.crop_width || a.film.crop_height != b.film.crop_height
 	;
 }
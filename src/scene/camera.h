@@ -30,8 +30,29 @@ public:
 		uint32_t max_ray_depth = 8; //how deep rays can traverse
 		//rasterizer parameters:
 		uint32_t sample_pattern = 1; //supersampling pattern id
+		//crop window (pixels from the bottom-left of the film); only pixels inside it are rendered:
+		// (crop_width or crop_height of zero means no crop; not saved with the scene)
+		uint32_t crop_x = 0, crop_y = 0, crop_width = 0, crop_height = 0;
 	} film;
 
+	//pixels to render, [x_begin,x_end)x[y_begin,y_end) -- the crop window clamped to the film, or the whole film:
+	struct Film_Rect {
+		uint32_t x_begin = 0, x_end = 0;
+		uint32_t y_begin = 0, y_end = 0;
+		uint32_t width() const { return x_end - x_begin; }
+		uint32_t height() const { return y_end - y_begin; }
+		bool operator==(Film_Rect const &o) const {
+			return x_begin == o.x_begin && x_end == o.x_end && y_begin == o.y_begin && y_end == o.y_end;
+		}
+		bool operator!=(Film_Rect const &o) const { return !(*this == o); }
+	};
+	Film_Rect crop_rect() const;
+	//is only part of the film rendered?
+	bool cropped() const;
+	//set the crop window from a rectangle given from the top-left of the film (like in an image viewer),
+	// clamped to the film:
+	void crop_from_top_left(uint32_t x, uint32_t y, uint32_t width, uint32_t height);
+
 	template< Intent I, typename F, typename C >
 	static void introspect(F&& f, C&& c) {
 		f("vertical_fov", c.vertical_fov);
@@ -35,7 +35,7 @@ float schlick(Vec3 in_dir, float index_of_refraction) {
 	return 0.0f;
 }
 
-Spectrum Lambertian::evaluate(Vec3 out, Vec3 in, Vec2 uv) const {
+Spectrum Lambertian::evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint) const {
 	//A3T4: Materials - Lambertian BSDF evaluation
 
     // Compute the ratio of outgoing/incoming radiance when light from in_dir
@@ -45,7 +45,7 @@ Spectrum Lambertian::evaluate(Vec3 out, Vec3 in, Vec2 uv) const {
     return Spectrum{};
 }
 
-Scatter Lambertian::scatter(RNG &rng, Vec3 out, Vec2 uv) const {
+Scatter Lambertian::scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint) const {
 	//A3T4: Materials - Lambertian BSDF scattering
 	//Select a scattered light direction at random from the Lambertian BSDF
 
@@ -69,7 +69,7 @@ float Lambertian::pdf(Vec3 out, Vec3 in) const {
     return 0.0f;
 }
 
-Spectrum Lambertian::emission(Vec2 uv) const {
+Spectrum Lambertian::emission(Vec2 uv, float footprint) const {
 	return {};
 }
 
@@ -81,11 +81,11 @@ void Lambertian::for_each(const std::function<void(std::weak_ptr<Texture>&)>& f)
 	f(albedo);
 }
 
-Spectrum Mirror::evaluate(Vec3 out, Vec3 in, Vec2 uv) const {
+Spectrum Mirror::evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint) const {
 	return {};
 }
 
-Scatter Mirror::scatter(RNG &rng, Vec3 out, Vec2 uv) const {
+Scatter Mirror::scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint) const {
 	//A3T5: mirror
 
 	// Use reflect to compute the new direction
@@ -102,7 +102,7 @@ float Mirror::pdf(Vec3 out, Vec3 in) const {
 	return 0.0f;
 }
 
-Spectrum Mirror::emission(Vec2 uv) const {
+Spectrum Mirror::emission(Vec2 uv, float footprint) const {
 	return {};
 }
 
@@ -114,11 +114,11 @@ void Mirror::for_each(const std::function<void(std::weak_ptr<Texture>&)>& f) {
 	f(reflectance);
 }
 
-Spectrum Refract::evaluate(Vec3 out, Vec3 in, Vec2 uv) const {
+Spectrum Refract::evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint) const {
 	return {};
 }
 
-Scatter Refract::scatter(RNG &rng, Vec3 out, Vec2 uv) const {
+Scatter Refract::scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint) const {
 	//A3T5 - refract
 
 	// Use refract to determine the new direction - what happens in the total internal reflection case?
@@ -137,7 +137,7 @@ float Refract::pdf(Vec3 out, Vec3 in) const {
 	return 0.0f;
 }
 
-Spectrum Refract::emission(Vec2 uv) const {
+Spectrum Refract::emission(Vec2 uv, float footprint) const {
 	return {};
 }
 
@@ -161,11 +161,11 @@ void Refract::for_each(const std::function<void(std::weak_ptr<Texture>&)>& f) {
 	f(transmittance);
 }
 
-Spectrum Glass::evaluate(Vec3 out, Vec3 in, Vec2 uv) const {
+Spectrum Glass::evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint) const {
 	return {};
 }
 
-Scatter Glass::scatter(RNG &rng, Vec3 out, Vec2 uv) const {
+Scatter Glass::scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint) const {
 	//A3T5 - glass
 
     // (1) Compute Fresnel coefficient. Tip: Schlick's approximation.
@@ -188,7 +188,7 @@ float Glass::pdf(Vec3 out, Vec3 in) const {
 	return 0.0f;
 }
 
-Spectrum Glass::emission(Vec2 uv) const {
+Spectrum Glass::emission(Vec2 uv, float footprint) const {
 	return {};
 }
 
@@ -213,11 +213,11 @@ void Glass::for_each(const std::function<void(std::weak_ptr<Texture>&)>& f) {
 	f(transmittance);
 }
 
-Spectrum Emissive::evaluate(Vec3 out, Vec3 in, Vec2 uv) const {
+Spectrum Emissive::evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint) const {
 	return {};
 }
 
-Scatter Emissive::scatter(RNG &rng, Vec3 out, Vec2 uv) const {
+Scatter Emissive::scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint) const {
 	Scatter ret;
 	ret.direction = {};
 	ret.attenuation = {};
@@ -228,8 +228,9 @@ float Emissive::pdf(Vec3 out, Vec3 in) const {
 	return 0.0f;
 }
 
-Spectrum Emissive::emission(Vec2 uv) const {
-	return emissive.lock()->evaluate(uv);
+Spectrum Emissive::emission(Vec2 uv, float footprint) const {
+	auto texture = emissive.lock();
+	return texture->evaluate(uv, texture->lod(footprint));
 }
 
 bool Emissive::is_emissive() const {
@@ -25,6 +25,9 @@ namespace Materials {
 // emission(uv):
 //  report uniform emission from the surface at location `uv`.
 //
+//evaluate, scatter, and emission also take an optional `footprint`: the width (in uv units) of the area
+// being shaded, for filtering textures. Look textures up with `texture->evaluate(uv, texture->lod(footprint))`.
+//
 //NOTE: that these functions always talk about directions *to* lights.
 // (particularly, for incoming light, this is opposite the direction the light is traveling.)
 //
@@ -48,10 +51,10 @@ public:
 	Lambertian(std::weak_ptr<Texture> albedo) : albedo(albedo) {
 	}
 
-	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv) const;
-	Scatter scatter(RNG &rng, Vec3 out, Vec2 uv) const;
+	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint = 0.0f) const;
+	Scatter scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint = 0.0f) const;
 	float pdf(Vec3 out, Vec3 in) const;
-	Spectrum emission(Vec2 uv) const;
+	Spectrum emission(Vec2 uv, float footprint = 0.0f) const;
 
 	constexpr bool is_emissive() const { return false; }
 	constexpr bool is_specular() const { return false; }
@@ -72,10 +75,10 @@ public:
 
 class Mirror {
 public:
-	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv) const;
-	Scatter scatter(RNG &rng, Vec3 out, Vec2 uv) const;
+	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint = 0.0f) const;
+	Scatter scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint = 0.0f) const;
 	float pdf(Vec3 out, Vec3 in) const;
-	Spectrum emission(Vec2 uv) const;
+	Spectrum emission(Vec2 uv, float footprint = 0.0f) const;
 
 	constexpr bool is_emissive() const { return false; }
 	constexpr bool is_specular() const { return true; }
@@ -95,10 +98,10 @@ public:
 
 class Refract {
 public:
-	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv) const;
-	Scatter scatter(RNG &rng, Vec3 out, Vec2 uv) const;
+	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint = 0.0f) const;
+	Scatter scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint = 0.0f) const;
 	float pdf(Vec3 out, Vec3 in) const;
-	Spectrum emission(Vec2 uv) const;
+	Spectrum emission(Vec2 uv, float footprint = 0.0f) const;
 
 	bool is_emissive() const;
 	bool is_specular() const;
@@ -120,10 +123,10 @@ public:
 
 class Glass {
 public:
-	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv) const;
-	Scatter scatter(RNG &rng, Vec3 out, Vec2 uv) const;
+	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint = 0.0f) const;
+	Scatter scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint = 0.0f) const;
 	float pdf(Vec3 out, Vec3 in) const;
-	Spectrum emission(Vec2 uv) const;
+	Spectrum emission(Vec2 uv, float footprint = 0.0f) const;
 
 	bool is_emissive() const;
 	bool is_specular() const;
@@ -146,10 +149,10 @@ public:
 
 class Emissive {
 public:
-	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv) const;
-	Scatter scatter(RNG &rng, Vec3 out, Vec2 uv) const;
+	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint = 0.0f) const;
+	Scatter scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint = 0.0f) const;
 	float pdf(Vec3 out, Vec3 in) const;
-	Spectrum emission(Vec2 uv) const;
+	Spectrum emission(Vec2 uv, float footprint = 0.0f) const;
 
 	bool is_emissive() const;
 	bool is_specular() const;
@@ -179,17 +182,17 @@ public:
 	Material() : material(Materials::Lambertian{}) {
 	}
 
-	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv) const {
-		return std::visit([&](auto&& m) { return m.evaluate(out, in, uv); }, material);
+	Spectrum evaluate(Vec3 out, Vec3 in, Vec2 uv, float footprint = 0.0f) const {
+		return std::visit([&](auto&& m) { return m.evaluate(out, in, uv, footprint); }, material);
 	}
-	Materials::Scatter scatter(RNG &rng, Vec3 out, Vec2 uv) const {
-		return std::visit([&](auto&& m) { return m.scatter(rng, out, uv); }, material);
+	Materials::Scatter scatter(RNG &rng, Vec3 out, Vec2 uv, float footprint = 0.0f) const {
+		return std::visit([&](auto&& m) { return m.scatter(rng, out, uv, footprint); }, material);
 	}
 	float pdf(Vec3 out, Vec3 in) const {
 		return std::visit([&](auto&& m) { return m.pdf(out, in); }, material);
 	}
-	Spectrum emission(Vec2 uv) const {
-		return std::visit([&](auto&& m) { return m.emission(uv); }, material);
+	Spectrum emission(Vec2 uv, float footprint = 0.0f) const {
+		return std::visit([&](auto&& m) { return m.emission(uv, footprint); }, material);
 	}
 
 	bool is_emissive() const {
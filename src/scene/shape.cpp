@@ -1,6 +1,7 @@
 
 #include "shape.h"
 #include "../geometry/util.h"
+#include "../pathtracer/stats.h"
 
 namespace Shapes {
 
@@ -20,6 +21,7 @@ BBox Sphere::bbox() const {
 
 PT::Trace Sphere::hit(Ray ray) const {
 	//A3T2 - sphere hit
+	PT::Stats::primitive_test();
 
     // TODO (PathTracer): Task 2
     // Intersect this ray with a sphere of radius Sphere::radius centered at the origin.
@@ -22,6 +22,11 @@ public:
 
 	BBox bbox() const;
 	PT::Trace hit(Ray ray) const;
+	//typical uv units per unit of distance along the surface (for texture filtering):
+	float uv_scale() const {
+		//(v runs pole-to-pole over pi * radius, u around the equator over 2 pi * radius)
+		return 1.0f / (std::sqrt(2.0f) * PI_F * radius);
+	}
 	Vec3 sample(RNG &rng, Vec3 from) const;
 	float pdf(Ray ray, Mat4 pdf_T = Mat4::I, Mat4 pdf_iT = Mat4::I) const;
 
@@ -55,6 +60,10 @@ public:
 		return std::visit([&](auto& s) { return s.hit(ray); }, shape);
 	}
 
+	float uv_scale() const {
+		return std::visit([&](auto& s) { return s.uv_scale(); }, shape);
+	}
+
 	Vec3 sample(RNG &rng, Vec3 from) const {
 		return std::visit([&](auto& s) { return s.sample(rng, from); }, shape);
 	}
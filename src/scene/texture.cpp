@@ -6,7 +6,21 @@
 namespace Textures
 {
 
-	Spectrum sample_nearest(HDR_Image const &image, Vec2 uv)
+	//the samplers below are written once, against anything with w, h, and at(x,y): HDR_Images and Packed_Images
+	// (or Packed_Texels views of Packed_Images, which decode without checking the encoding per texel):
+	Spectrum sample_bilinear(HDR_Image const &image, Vec2 uv);
+	Spectrum sample_bilinear(Packed_Image const &image, Vec2 uv);
+
+	template< Packed_Image::Encoding E >
+	struct Packed_Texels
+	{
+		Packed_Image const &image;
+		uint32_t w = image.w, h = image.h;
+		Spectrum at(uint32_t x, uint32_t y) const { return image.at< E >(x, y); }
+	};
+
+	template< typename Texels >
+	Spectrum sample_nearest(Texels const &image, Vec2 uv)
 	{
 		// clamp texture coordinates, convert to [0,w]x[0,h] pixel space:
 		float x = image.w * std::clamp(uv.x, 0.0f, 1.0f);
@@ -23,7 +37,8 @@ namespace Textures
 		return image.at(ix, iy);
 	}
 
-	Spectrum sample_bilinear(HDR_Image const &image, Vec2 uv)
+	template< typename Texels >
+	Spectrum sample_bilinear(Texels const &image, Vec2 uv)
 	{
 		// A1T6: sample_bilinear
 		// TODO: implement bilinear sampling strategy on texture 'image'
@@ -44,6 +59,7 @@ namespace Textures
 		y0 = std::clamp(y0, 0, int32_t(image.h) - 1);
 		y1 = std::clamp(y1, 0, int32_t(image.h) - 1);
 
+		//(in a Packed_Image's 4x4 tiles, these four texels share a tile unless the tap straddles a tile edge)
 		Spectrum tex00 = image.at(x0, y0);
 		Spectrum tex01 = image.at(x0, y1);
 		Spectrum tex10 = image.at(x1, y0);
@@ -55,17 +71,21 @@ namespace Textures
 		return (1 - dy) * texlo + dy * texhi;
 	}
 
-	Spectrum sample_trilinear(HDR_Image const &base, std::vector<HDR_Image> const &levels, Vec2 uv, float lod)
+	template< typename Texels >
+	Spectrum sample_trilinear(Texels const &base, std::vector<Texels> const &levels, Vec2 uv, float lod)
 	{
 		// A1T6: sample_trilinear
 		// TODO: implement trilinear sampling strategy on using mip-map 'levels'
 
+		//(a 1x1 base image has no levels to blend with)
+		if (levels.empty()) return sample_bilinear(base, uv);
+
 		int32_t levels_num = int32_t(levels.size());
 		int32_t lodlo = int32_t(std::floor(lod));
 		float dlod = lod - lodlo;
 
-		const HDR_Image &levello = (lodlo - 1 < 0) ? base : levels[std::min(lodlo - 1, levels_num - 1)];
-		const HDR_Image &levelhi = (lodlo < 0) ? base : levels[std::min(lodlo, levels_num - 1)];
+		const Texels &levello = (lodlo - 1 < 0) ? base : levels[std::min(lodlo - 1, levels_num - 1)];
+		const Texels &levelhi = (lodlo < 0) ? base : levels[std::min(lodlo, levels_num - 1)];
 
 		Spectrum speclo = sample_bilinear(levello, uv);
 		Spectrum spechi = sample_bilinear(levelhi, uv);
@@ -73,6 +93,43 @@ namespace Textures
 		return (1 - dlod) * speclo + dlod * spechi;
 	}
 
+	Spectrum sample_nearest(HDR_Image const &image, Vec2 uv)
+	{
+		return sample_nearest< HDR_Image >(image, uv);
+	}
+
+	Spectrum sample_bilinear(HDR_Image const &image, Vec2 uv)
+	{
+		return sample_bilinear< HDR_Image >(image, uv);
+	}
+
+	Spectrum sample_trilinear(HDR_Image const &base, std::vector<HDR_Image> const &levels, Vec2 uv, float lod)
+	{
+		return sample_trilinear< HDR_Image >(base, levels, uv, lod);
+	}
+
+	Spectrum sample_nearest(Packed_Image const &image, Vec2 uv)
+	{
+		return sample_nearest< Packed_Image >(image, uv);
+	}
+
+	//(picks the decoder once per lookup, rather than once per texel)
+	Spectrum sample_bilinear(Packed_Image const &image, Vec2 uv)
+	{
+		switch (image.encoding)
+		{
+		case Packed_Image::Encoding::f32: return sample_bilinear(Packed_Texels< Packed_Image::Encoding::f32 >{image}, uv);
+		case Packed_Image::Encoding::f16: return sample_bilinear(Packed_Texels< Packed_Image::Encoding::f16 >{image}, uv);
+		case Packed_Image::Encoding::rgb9e5: return sample_bilinear(Packed_Texels< Packed_Image::Encoding::rgb9e5 >{image}, uv);
+		}
+		return Spectrum();
+	}
+
+	Spectrum sample_trilinear(Packed_Image const &base, std::vector<Packed_Image> const &levels, Vec2 uv, float lod)
+	{
+		return sample_trilinear< Packed_Image >(base, levels, uv, lod);
+	}
+
 	/*
 	 * generate_mipmap- generate mipmap levels from a base image.
 	 *  base: the base image
@@ -163,10 +220,11 @@ namespace Textures
 		std::cout << std::endl;
 	}
 
-	Image::Image(Sampler sampler_, HDR_Image const &image_)
+	Image::Image(Sampler sampler_, HDR_Image const &image_, Storage storage_)
 	{
 		sampler = sampler_;
 		image = image_.copy();
+		storage = storage_;
 		update_mipmap();
 	}
 
@@ -174,6 +232,12 @@ namespace Textures
 	{
 		if (image.w == 0 && image.h == 0)
 			return Spectrum();
+		if (storage != Storage::rows)
+		{
+			if (sampler == Sampler::nearest) return sample_nearest(packed, uv);
+			if (sampler == Sampler::bilinear) return sample_bilinear(packed, uv);
+			return sample_trilinear(packed, packed_levels, uv, lod);
+		}
 		if (sampler == Sampler::nearest)
 		{
 			return sample_nearest(image, uv);
@@ -188,6 +252,14 @@ namespace Textures
 		}
 	}
 
+	float Image::lod(float footprint) const
+	{
+		//(same as the rasterizer: log2 of the footprint in texels, clamped to the base level)
+		float texels = footprint * float(std::max(image.w, image.h));
+		if (!(texels > 1.0f)) return 0.0f;
+		return std::min(std::log2(texels), 32.0f);
+	}
+
 	void Image::update_mipmap()
 	{
 		if (sampler == Sampler::trilinear)
@@ -198,6 +270,31 @@ namespace Textures
 		{
 			levels.clear();
 		}
+
+		packed = Packed_Image();
+		packed_levels.clear();
+		if (storage != Storage::rows && image.w > 0 && image.h > 0)
+		{
+			Packed_Image::Encoding encoding = Packed_Image::Encoding::f32;
+			if (storage == Storage::tiled_f16) encoding = Packed_Image::Encoding::f16;
+			if (storage == Storage::tiled_rgb9e5) encoding = Packed_Image::Encoding::rgb9e5;
+
+			packed = Packed_Image(image, encoding);
+			packed_levels.reserve(levels.size());
+			for (HDR_Image const &level : levels)
+			{
+				packed_levels.emplace_back(level, encoding);
+			}
+			//(samples come from the packed copies now, so don't keep the levels twice)
+			levels.clear();
+		}
+	}
+
+	void Image::set_storage(Storage storage_)
+	{
+		if (storage_ == storage) return;
+		storage = storage_;
+		update_mipmap();
 	}
 
 	GL::Tex2D Image::to_gl() const
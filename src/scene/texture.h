@@ -4,6 +4,7 @@
 
 #include "../lib/mathlib.h"
 #include "../util/hdr_image.h"
+#include "../util/packed_image.h"
 
 #include <memory>
 #include <variant>
@@ -19,11 +20,20 @@ public:
 		bilinear,
 		trilinear,
 	};
+	//how the image (and its mipmap levels) are stored for sampling:
+	// rows samples `image` and `levels` directly; the others sample copies in `packed` (see Packed_Image)
+	enum class Storage : uint8_t {
+		rows,
+		tiled,
+		tiled_f16,
+		tiled_rgb9e5,
+	};
+
 	Image() = default;
-	Image(Sampler sampler_, HDR_Image const &image_);
+	Image(Sampler sampler_, HDR_Image const &image_, Storage storage_ = Storage::rows);
 	
 	Image copy() const {
-		return Image{sampler, image};
+		return Image{sampler, image, storage};
 	}
 
 	//Read value from the image.
@@ -32,13 +42,21 @@ public:
 	//  lod is mipmap level to sample from. Ignored unless Sampler is trilinear.
 	Spectrum evaluate(Vec2 uv, float lod) const;
 
+	//mipmap level for a lookup covering `footprint` uv units:
+	float lod(float footprint) const;
 
 	Sampler sampler;
 	HDR_Image image;
 
-	//updates 'levels' for current sampler and image:
+	//updates 'levels' (and 'packed') for current sampler, image, and storage:
 	void update_mipmap();
-	std::vector<HDR_Image> levels; //mipmap levels (if needed)
+	std::vector<HDR_Image> levels; //mipmap levels (if needed and storage is rows)
+
+	Storage storage = Storage::rows;
+	Packed_Image packed; //image and mipmap levels (if storage isn't rows)
+	std::vector<Packed_Image> packed_levels;
+	//change storage (re-packing the image and levels):
+	void set_storage(Storage storage_);
 
 	GL::Tex2D to_gl() const;
 
@@ -75,6 +93,9 @@ public:
 	}
 
 	Spectrum evaluate(Vec2 uv, float lod) const;
+	float lod(float footprint) const {
+		return 0.0f;
+	}
 
 	Spectrum color = Spectrum(0.75f, 0.75f, 0.75f);
 	float scale = 1.0f;
@@ -103,6 +124,9 @@ public:
 	Spectrum evaluate(Vec2 uv, float lod = 0.0f) const {
 		return std::visit([&](auto&& t) { return t.evaluate(uv, lod); }, texture);
 	}
+	float lod(float footprint) const {
+		return std::visit([&](auto&& t) { return t.lod(footprint); }, texture);
+	}
 
 	template<typename T> bool is() const {
 		return std::holds_alternative<T>(texture);
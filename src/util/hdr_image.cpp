@@ -1,12 +1,20 @@
 
 #include "hdr_image.h"
 #include "../lib/log.h"
+#include "../lib/simd.h"
 
 #include <sf_libs/stb_image.h>
 #include <sf_libs/tinyexr.h>
 
+#include "thread_pool.h"
+
+#include <algorithm>
+#include <atomic>
 #include <cstring>
 
+//with a thread pool, images are tonemapped in ranges of this many pixels (a multiple of four):
+static constexpr uint32_t TonemapRangePixels = 1 << 16;
+
 HDR_Image::HDR_Image(uint32_t w, uint32_t h, Spectrum color) : w(w), h(h) {
 	pixels.resize(w * h, color);
 }
@@ -198,29 +206,170 @@ GL::Tex2D HDR_Image::to_gl(float e) const {
 	return tex;
 }
 
-void HDR_Image::tonemap_to(std::vector<uint8_t>& data, float e) const {
+//tonemap one channel: exposure, then gamma, then quantize to 8 bits.
+//(this is the reference -- the vectorized path below must produce exactly the same bytes)
+uint8_t HDR_Image::tonemap_channel(float v, float e) {
+	float t = 1.0f - std::exp(-v * e);
+	float s = std::round(Spectrum::to_srgb(t) * 255.0f);
+	//(checked this way around so NaN doesn't reach the cast, either)
+	return s > 0.0f ? static_cast<uint8_t>(s) : 0;
+}
 
-	if (data.size() != w * h * 4) data.resize(w * h * 4);
+namespace {
+
+#if SIMD_SSE
+//exp(r) for |r| <= ln(2)/2 (degree-7 Taylor polynomial; error well under a float ulp):
+__m128 exp_reduced(__m128 r) {
+	__m128 p = _mm_set1_ps(1.0f / 5040.0f);
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.0f / 720.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.0f / 120.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.0f / 24.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.0f / 6.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(0.5f));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.0f));
+	return _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(1.0f));
+}
 
-	for (uint32_t j = 0; j < h; j++) {
-		for (uint32_t i = 0; i < w; i++) {
+//2^n for integer n in [-126, 127]:
+__m128 exp2_int(__m128i n) {
+	return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+}
 
-			uint32_t pidx = j * w + i;
-			const Spectrum& sample = pixels[pidx];
+//exp(x) for x in [-80, 0]:
+__m128 exp_ps(__m128 x) {
+	__m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(1.44269504f)));
+	__m128 nf = _mm_cvtepi32_ps(n);
+	//ln(2) split in two, so r = x - n*ln(2) stays accurate:
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(nf, _mm_set1_ps(0.693145752f)));
+	r = _mm_sub_ps(r, _mm_mul_ps(nf, _mm_set1_ps(1.42860677e-6f)));
+	return _mm_mul_ps(exp_reduced(r), exp2_int(n));
+}
 
-			float r = 1.0f - std::exp(-sample.r * e);
-			float g = 1.0f - std::exp(-sample.g * e);
-			float b = 1.0f - std::exp(-sample.b * e);
+//2^x for x in [-126, 0]:
+__m128 exp2_ps(__m128 x) {
+	__m128i n = _mm_cvtps_epi32(x);
+	__m128 r = _mm_mul_ps(_mm_sub_ps(x, _mm_cvtepi32_ps(n)), _mm_set1_ps(0.693147181f));
+	return _mm_mul_ps(exp_reduced(r), exp2_int(n));
+}
 
-			Spectrum out(r, g, b);
-			out = out.to_srgb();
+//log2(x) for normal, positive x:
+__m128 log2_ps(__m128 x) {
+	__m128i bits = _mm_castps_si128(x);
+	__m128i k = _mm_sub_epi32(_mm_srli_epi32(bits, 23), _mm_set1_epi32(127));
+	__m128 m = _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007fffff)), _mm_set1_epi32(0x3f800000)));
+	//move m into [sqrt(1/2), sqrt(2)) so the series below converges quickly:
+	__m128 big = _mm_cmpgt_ps(m, _mm_set1_ps(1.41421356f));
+	m = _mm_or_ps(_mm_and_ps(big, _mm_mul_ps(m, _mm_set1_ps(0.5f))), _mm_andnot_ps(big, m));
+	__m128 kf = _mm_add_ps(_mm_cvtepi32_ps(k), _mm_and_ps(big, _mm_set1_ps(1.0f)));
+	//ln(m) = 2 atanh(f) = 2 (f + f^3/3 + f^5/5 + ...) with f = (m-1)/(m+1):
+	__m128 f = _mm_div_ps(_mm_sub_ps(m, _mm_set1_ps(1.0f)), _mm_add_ps(m, _mm_set1_ps(1.0f)));
+	__m128 f2 = _mm_mul_ps(f, f);
+	__m128 p = _mm_set1_ps(1.0f / 9.0f);
+	p = _mm_add_ps(_mm_mul_ps(p, f2), _mm_set1_ps(1.0f / 7.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, f2), _mm_set1_ps(1.0f / 5.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, f2), _mm_set1_ps(1.0f / 3.0f));
+	p = _mm_add_ps(_mm_mul_ps(p, f2), _mm_set1_ps(1.0f));
+	//(2 * log2(e) = 2.88539008)
+	return _mm_add_ps(kf, _mm_mul_ps(_mm_mul_ps(f, p), _mm_set1_ps(2.88539008f)));
+}
+
+//tonemap twelve channel values (four pixels) at once, as three independent vectors so their
+//(long, serial) polynomial evaluations overlap.
+//The polynomials above aren't exactly std::exp / std::pow, so any value that lands within
+//RoundingMargin of a rounding boundary (or outside the range the polynomials handle)
+//is redone with tonemap_channel -- so the output matches the scalar path exactly.
+constexpr float RoundingMargin = 1.0f / 64.0f;
+void tonemap_channels12(float const* in, float e, uint8_t* out) {
+	__m128 y[3], ok[3], t[3], scaled[3];
+	for (uint32_t k = 0; k < 3; k++) {
+		y[k] = _mm_mul_ps(_mm_loadu_ps(in + 4 * k), _mm_set1_ps(e));
+		ok[k] = _mm_and_ps(_mm_cmpge_ps(y[k], _mm_setzero_ps()), _mm_cmple_ps(y[k], _mm_set1_ps(80.0f)));
+		y[k] = _mm_and_ps(ok[k], y[k]);
+	}
+	for (uint32_t k = 0; k < 3; k++) {
+		t[k] = _mm_sub_ps(_mm_set1_ps(1.0f), exp_ps(_mm_sub_ps(_mm_setzero_ps(), y[k])));
+	}
+	//sRGB curve: linear below the knee, 1.055 t^(1/2.4) - 0.055 above it:
+	for (uint32_t k = 0; k < 3; k++) {
+		__m128 knee = _mm_cmpgt_ps(t[k], _mm_set1_ps(0.0031308f));
+		__m128 safe_t = _mm_or_ps(_mm_and_ps(knee, t[k]), _mm_andnot_ps(knee, _mm_set1_ps(1.0f)));
+		__m128 curve = _mm_sub_ps(
+			_mm_mul_ps(_mm_set1_ps(1.055f), exp2_ps(_mm_mul_ps(log2_ps(safe_t), _mm_set1_ps(1.0f / 2.4f)))),
+			_mm_set1_ps(0.055f));
+		__m128 linear = _mm_mul_ps(t[k], _mm_set1_ps(12.92f));
+		scaled[k] = _mm_mul_ps(_mm_or_ps(_mm_and_ps(knee, curve), _mm_andnot_ps(knee, linear)), _mm_set1_ps(255.0f));
+	}
+
+	//values are >= 0, so (outside the margin) rounding to nearest matches std::round:
+	alignas(16) int32_t bytes[12];
+	int redo = 0;
+	for (uint32_t k = 0; k < 3; k++) {
+		_mm_store_si128(reinterpret_cast<__m128i*>(bytes + 4 * k), _mm_cvtps_epi32(scaled[k]));
+		__m128 frac = _mm_sub_ps(scaled[k], _mm_cvtepi32_ps(_mm_cvttps_epi32(scaled[k])));
+		__m128 tie = _mm_cmplt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), _mm_sub_ps(frac, _mm_set1_ps(0.5f))),
+		                          _mm_set1_ps(RoundingMargin));
+		redo |= (_mm_movemask_ps(tie) | (_mm_movemask_ps(ok[k]) ^ 0xf)) << (4 * k);
+	}
 
-			uint32_t didx = 4 * (j * w + i);
-			data[didx] = static_cast<uint8_t>(std::round(out.r * 255.0f));
-			data[didx + 1] = static_cast<uint8_t>(std::round(out.g * 255.0f));
-			data[didx + 2] = static_cast<uint8_t>(std::round(out.b * 255.0f));
-			data[didx + 3] = 255;
+	for (uint32_t i = 0; i < 12; i++) {
+		out[i] = (redo & (1 << i)) ? HDR_Image::tonemap_channel(in[i], e) : static_cast<uint8_t>(bytes[i]);
+	}
+}
+#endif
+
+} // namespace
+
+void HDR_Image::tonemap_to(std::vector<uint8_t>& data, float e, Thread_Pool* thread_pool) const {
+
+	if (data.size() != w * h * 4) data.resize(w * h * 4);
+
+	//tonemap pixels [begin,end):
+	auto tonemap_range = [&](uint32_t begin, uint32_t end) {
+		uint32_t i = begin;
+#if SIMD_SSE
+		//four pixels (twelve channel values) at a time:
+		static_assert(sizeof(Spectrum) == 3 * sizeof(float), "Spectrum should be three packed floats.");
+		if (e > 0.0f && std::isfinite(e)) {
+			for (; i + 4 <= end; i += 4) {
+				uint8_t channels[12];
+				tonemap_channels12(pixels[i].data, e, channels);
+				uint8_t* out = &data[4 * i];
+				for (uint32_t p = 0; p < 4; p++) {
+					out[4 * p] = channels[3 * p];
+					out[4 * p + 1] = channels[3 * p + 1];
+					out[4 * p + 2] = channels[3 * p + 2];
+					out[4 * p + 3] = 255;
+				}
+			}
+		}
+#endif
+		for (; i < end; i++) {
+			const Spectrum& sample = pixels[i];
+			data[4 * i] = tonemap_channel(sample.r, e);
+			data[4 * i + 1] = tonemap_channel(sample.g, e);
+			data[4 * i + 2] = tonemap_channel(sample.b, e);
+			data[4 * i + 3] = 255;
 		}
+	};
+
+	//large images are split into ranges of pixels, handed out to the pool's workers:
+	uint32_t count = w * h;
+	uint32_t ranges = (count + TonemapRangePixels - 1) / TonemapRangePixels;
+	if (thread_pool && thread_pool->size() > 1 && ranges > 1) {
+		std::atomic<uint32_t> next(0);
+		std::vector<std::future<void>> workers;
+		for (uint32_t t = 0; t < std::min(ranges, thread_pool->size()); t++) {
+			workers.emplace_back(thread_pool->enqueue([&]() {
+				for (uint32_t r = next++; r < ranges; r = next++) {
+					tonemap_range(r * TonemapRangePixels, std::min(count, (r + 1) * TonemapRangePixels));
+				}
+			}));
+		}
+		for (auto& worker : workers) {
+			worker.get();
+		}
+	} else {
+		tonemap_range(0, count);
 	}
 }
 
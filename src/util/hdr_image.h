@@ -6,6 +6,8 @@
 #include "../lib/spectrum.h"
 #include "../platform/gl.h"
 
+class Thread_Pool;
+
 /*
  *
  * HDR_Image stores an image with a floating-point Spectrum per pixel.
@@ -67,7 +69,10 @@ public:
 	static HDR_Image missing_image();
 
 	GL::Tex2D to_gl(float exposure) const;
-	void tonemap_to(std::vector<uint8_t>& data, float exposure) const;
+	//tonemap to 8-bit RGBA (if thread_pool is given, large images are split over its workers):
+	void tonemap_to(std::vector<uint8_t>& data, float exposure, Thread_Pool* thread_pool = nullptr) const;
+	//tonemap one channel value the way tonemap_to does (negative and NaN values map to 0):
+	static uint8_t tonemap_channel(float v, float exposure);
 
 	uint32_t w = 0, h = 0;
 
@@ -0,0 +1,77 @@
+
+#include "packed_image.h"
+
+#include <algorithm>
+#include <cmath>
+
+Packed_Image::Packed_Image(HDR_Image const &image, Encoding encoding_)
+	: w(image.w), h(image.h), encoding(encoding_) {
+	tiles_w = (w + 3) / 4;
+	uint32_t tiles_h = (h + 3) / 4;
+	switch (encoding) {
+	case Encoding::f32: texel_bytes = 3 * sizeof(float); break;
+	case Encoding::f16: texel_bytes = 3 * sizeof(uint16_t); break;
+	case Encoding::rgb9e5: texel_bytes = sizeof(uint32_t); break;
+	}
+	//(tiles past the right and top edges are padded with zeros)
+	data.assign(size_t(tiles_w) * tiles_h * 16 * texel_bytes, 0);
+
+	for (uint32_t y = 0; y < h; ++y) {
+		for (uint32_t x = 0; x < w; ++x) {
+			Spectrum s = image.at(x, y);
+			uint8_t *texel = data.data() + size_t(index(x, y)) * texel_bytes;
+			if (encoding == Encoding::f32) {
+				float c[3] = {s.r, s.g, s.b};
+				std::memcpy(texel, c, sizeof(c));
+			} else if (encoding == Encoding::f16) {
+				uint16_t c[3] = {float_to_half(s.r), float_to_half(s.g), float_to_half(s.b)};
+				std::memcpy(texel, c, sizeof(c));
+			} else {
+				uint32_t bits = spectrum_to_rgb9e5(s);
+				std::memcpy(texel, &bits, sizeof(bits));
+			}
+		}
+	}
+}
+
+uint16_t Packed_Image::float_to_half(float f) {
+	uint32_t bits;
+	std::memcpy(&bits, &f, sizeof(bits));
+	uint16_t sign = uint16_t((bits >> 16) & 0x8000);
+	bits &= 0x7fffffff;
+
+	if (bits > 0x7f800000) return sign | 0x7e00; //NaN
+	//too large (including infinity) => largest finite half:
+	if (bits >= 0x477ff000) return sign | 0x7bff;
+	//too small for a normal half => denormal (rounded to nearest, which may carry into the smallest normal):
+	if (bits < 0x38800000) {
+		return sign | uint16_t(std::lrint(std::abs(f) * 0x1p24f));
+	}
+	//rebias exponent and round mantissa to nearest even:
+	return sign | uint16_t((bits - 0x38000000 + 0xfff + ((bits >> 13) & 1)) >> 13);
+}
+
+uint32_t Packed_Image::spectrum_to_rgb9e5(Spectrum s) {
+	//following EXT_texture_shared_exponent:
+	constexpr int32_t N = 9, B = 15;
+	constexpr float max_value = float(0x1ff) / 512.0f * 65536.0f;
+	auto clamp = [&](float c) {
+		return c > 0.0f ? std::min(c, max_value) : 0.0f; //(also maps NaN to 0)
+	};
+	float r = clamp(s.r), g = clamp(s.g), b = clamp(s.b);
+	float max_rgb = std::max(r, std::max(g, b));
+
+	int32_t exponent = 0;
+	if (max_rgb > 0.0f) {
+		int32_t e;
+		std::frexp(max_rgb, &e); //max_rgb = m * 2^e, with m in [0.5,1)
+		exponent = std::max(-B - 1, e - 1) + 1 + B;
+	}
+	if (std::floor(max_rgb / std::ldexp(1.0f, exponent - B - N) + 0.5f) == float(1 << N)) exponent += 1;
+
+	float scale = std::ldexp(1.0f, -(exponent - B - N));
+	auto mantissa = [&](float c) {
+		return std::min(uint32_t(std::floor(c * scale + 0.5f)), uint32_t(0x1ff));
+	};
+	return mantissa(r) | (mantissa(g) << 9) | (mantissa(b) << 18) | (uint32_t(exponent) << 27);
+}
@@ -0,0 +1,105 @@
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+#include "../lib/spectrum.h"
+#include "hdr_image.h"
+
+/*
+ *
+ * Packed_Image stores a (read-only) copy of an HDR_Image for texture sampling:
+ *
+ *  - texels are stored in 4x4 tiles (tiles row-major, texels row-major within each tile),
+ *    so the 2x2 texels of a bilinear tap are usually in the same tile -- and the same cache line.
+ *  - texels can be stored at reduced precision, to fit more of a texture in cache:
+ *      f32:    three floats (12 bytes per texel) -- exactly the HDR_Image's values
+ *      f16:    three half floats (6 bytes per texel; magnitudes clamped to 65504)
+ *      rgb9e5: three 9-bit mantissas sharing a 5-bit exponent (4 bytes per texel, so a 4x4 tile is 64 bytes;
+ *              values clamped to [0,65408], and channels much dimmer than the brightest lose precision)
+ *
+ * Like HDR_Image, the origin is located in the bottom left.
+ *
+ */
+class Packed_Image {
+public:
+	enum class Encoding : uint8_t {
+		f32,
+		f16,
+		rgb9e5,
+	};
+
+	Packed_Image() = default;
+	Packed_Image(HDR_Image const &image, Encoding encoding);
+
+	Spectrum at(uint32_t x, uint32_t y) const {
+		switch (encoding) {
+		case Encoding::f32: return at< Encoding::f32 >(x, y);
+		case Encoding::f16: return at< Encoding::f16 >(x, y);
+		case Encoding::rgb9e5: return at< Encoding::rgb9e5 >(x, y);
+		}
+		return Spectrum{};
+	}
+	//(when the encoding is already known, e.g., to switch once for several lookups)
+	template< Encoding E >
+	Spectrum at(uint32_t x, uint32_t y) const {
+		assert(x < w && y < h);
+		assert(E == encoding);
+		if constexpr (E == Encoding::f32) return decode_f32(data.data() + size_t(index(x, y)) * 12);
+		else if constexpr (E == Encoding::f16) return decode_f16(data.data() + size_t(index(x, y)) * 6);
+		else return decode_rgb9e5(data.data() + size_t(index(x, y)) * 4);
+	}
+
+	size_t bytes() const {
+		return data.size();
+	}
+
+	uint32_t w = 0, h = 0;
+	Encoding encoding = Encoding::f32;
+
+	//tiled texel index:
+	uint32_t index(uint32_t x, uint32_t y) const {
+		return (((y >> 2) * tiles_w + (x >> 2)) << 4) | ((y & 3) << 2) | (x & 3);
+	}
+
+	//per-texel encoding helpers:
+	static Spectrum decode_f32(uint8_t const *texel) {
+		float c[3];
+		std::memcpy(c, texel, sizeof(c));
+		return Spectrum(c[0], c[1], c[2]);
+	}
+	static Spectrum decode_f16(uint8_t const *texel) {
+		uint16_t c[3];
+		std::memcpy(c, texel, sizeof(c));
+		return Spectrum(half_to_float(c[0]), half_to_float(c[1]), half_to_float(c[2]));
+	}
+	static Spectrum decode_rgb9e5(uint8_t const *texel) {
+		uint32_t bits;
+		std::memcpy(&bits, texel, sizeof(bits));
+		//2^(exponent - 15 - 9), built directly as a float:
+		uint32_t scale_bits = ((bits >> 27) + 103u) << 23;
+		float scale;
+		std::memcpy(&scale, &scale_bits, sizeof(scale));
+		return Spectrum(float(bits & 0x1ff) * scale, float((bits >> 9) & 0x1ff) * scale,
+		                float((bits >> 18) & 0x1ff) * scale);
+	}
+	static float half_to_float(uint16_t half) {
+		//move exponent and mantissa into place and rebias by multiplying (also handles denormals):
+		uint32_t bits = uint32_t(half & 0x7fff) << 13;
+		//(infinity and NaN keep an all-ones exponent)
+		if ((half & 0x7c00) == 0x7c00) bits |= 0x7f800000;
+		float f;
+		std::memcpy(&f, &bits, sizeof(f));
+		f *= 0x1p112f;
+		return (half & 0x8000) ? -f : f;
+	}
+	static uint16_t float_to_half(float f);
+	static uint32_t spectrum_to_rgb9e5(Spectrum s);
+
+private:
+	uint32_t tiles_w = 0;
+	uint32_t texel_bytes = 0;
+	std::vector<uint8_t> data;
+};
@@ -19,6 +19,9 @@ public:
 	void wait();
 	void clear();
 
+	//number of worker threads:
+	uint32_t size() const { return n_threads; }
+
 	template<class F, class... Args>
 	auto enqueue(F&& f, Args&&... args)
 		-> std::future<typename std::invoke_result<F, Args...>::type> {
@@ -0,0 +1,531 @@
+#include "test.h"
+
+// Actually include the *definitions* (not just the declarations):
+#include "rasterizer/pipeline.cpp"
+// (as in test.a1.task4.cpp, so Pipeline< > can be instantiated with the Copy program)
+
+#include "rasterizer/sample_pattern.h"
+#include "scene/camera.h"
+#include "util/rand.h"
+#include "util/thread_pool.h"
+
+//-------------------------------------------
+//checks that the ways Pipeline::run can split up and skip work never change what it draws:
+
+template< uint32_t flags >
+using CopyPipeline = Pipeline< PrimitiveType::Triangles, Programs::Copy, flags >;
+using CopyVertex = ::Vertex< Programs::Copy::VA >;
+
+//random triangles on the screen, a few large and many small, at random depths and w:
+// (kept inside the view volume, since the clipping functions are A1 extra credit)
+static std::vector< CopyVertex > random_triangles(uint32_t count, uint32_t seed) {
+	RNG rng(seed);
+	std::vector< CopyVertex > vertices;
+	vertices.reserve(count * 3);
+	for (uint32_t t = 0; t < count; ++t) {
+		float size = rng.coin_flip(0.05f) ? 1.5f : 0.15f;
+		Vec2 center(rng.unit() * 2.0f - 1.0f, rng.unit() * 2.0f - 1.0f);
+		Spectrum color(rng.unit(), rng.unit(), rng.unit());
+		float opacity = rng.unit();
+		for (uint32_t i = 0; i < 3; ++i) {
+			float w = 0.5f + 1.5f * rng.unit();
+			Vec2 at = hmax(hmin(center + size * Vec2(rng.unit() - 0.5f, rng.unit() - 0.5f), Vec2(1.0f)), Vec2(-1.0f));
+			float z = rng.unit() * 2.0f - 1.0f;
+			vertices.emplace_back(CopyVertex{{at.x * w, at.y * w, z * w, w, color.r, color.g, color.b, opacity}});
+		}
+	}
+	return vertices;
+}
+
+//framebuffer with a background that blending and depth testing will show through:
+static Framebuffer test_fb(uint32_t width, uint32_t height, uint32_t pattern) {
+	SamplePattern const *sample_pattern = SamplePattern::from_id(pattern);
+	if (!sample_pattern) throw Test::error("Sample pattern " + std::to_string(pattern) + " doesn't exist.");
+
+	Framebuffer fb(width, height, *sample_pattern);
+	for (uint32_t y = 0; y < height; ++y) {
+		for (uint32_t x = 0; x < width; ++x) {
+			for (uint32_t s = 0; s < fb.samples; ++s) {
+				fb.color_at(x, y, s) = Spectrum(x / float(width), y / float(height), 0.25f);
+				fb.depth_at(x, y, s) = 0.75f + 0.25f * ((x + y) % 2);
+			}
+		}
+	}
+	return fb;
+}
+
+//every sample of got is exactly the same as the same sample of expected:
+static void check_same(std::string const &desc, Framebuffer const &expected, Framebuffer const &got) {
+	for (uint32_t y = 0; y < expected.height; ++y) {
+		for (uint32_t x = 0; x < expected.width; ++x) {
+			for (uint32_t s = 0; s < expected.samples; ++s) {
+				if (got.color_at(x, y, s) != expected.color_at(x, y, s) || got.depth_at(x, y, s) != expected.depth_at(x, y, s)) {
+					throw Test::error(desc + ": sample " + std::to_string(s) + " of pixel (" + std::to_string(x) + ", " + std::to_string(y) + ") is "
+					                  + to_string(got.color_at(x, y, s)) + " at depth " + std::to_string(got.depth_at(x, y, s)) + ", expected "
+					                  + to_string(expected.color_at(x, y, s)) + " at depth " + std::to_string(expected.depth_at(x, y, s)) + ".");
+				}
+			}
+		}
+	}
+}
+
+//-------------------------------------------
+//runs on a thread pool match runs on one thread:
+
+template< uint32_t flags >
+static void check_pooled(Thread_Pool &pool, std::vector< CopyVertex > const &vertices, uint32_t pattern) {
+	std::string desc = "Flags " + std::to_string(flags) + ", pattern " + std::to_string(pattern);
+
+	Framebuffer single = test_fb(70, 46, pattern);
+	CopyPipeline< flags >::run(vertices, Programs::Copy::Parameters(), &single);
+
+	Framebuffer pooled = test_fb(70, 46, pattern);
+	pooled.thread_pool = &pool;
+	CopyPipeline< flags >::run(vertices, Programs::Copy::Parameters(), &pooled);
+
+	check_same(desc + " on " + std::to_string(pool.size()) + " threads", single, pooled);
+}
+
+Test test_a1_pipeline_pool("a1.pipeline.pool", []() {
+	//(enough triangles for several rounds of chunks on four threads)
+	std::vector< CopyVertex > vertices = random_triangles(2 * 8 * CopyPipeline< 0 >::ChunkPrimitives + 100, 1);
+
+	//one pool serves every run, as it does for the rasterizer:
+	Thread_Pool pool(4);
+	for (uint32_t pattern : {1u, 4u}) {
+		check_pooled< Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Smooth >(pool, vertices, pattern);
+		check_pooled< Pipeline_Blend_Over | Pipeline_Depth_Always | Pipeline_Interp_Correct >(pool, vertices, pattern);
+		check_pooled< Pipeline_Blend_Add | Pipeline_Depth_Less | Pipeline_Interp_Flat >(pool, vertices, pattern);
+		check_pooled< Pipeline_Blend_Over | Pipeline_Depth_Less | Pipeline_Interp_Correct | Pipeline_CullBackBit >(pool, vertices, pattern);
+		check_pooled< Pipeline_Blend_Over | Pipeline_Depth_Less | Pipeline_Interp_Smooth | Pipeline_DepthWriteDisableBit >(pool, vertices, pattern);
+	}
+
+	//small draws stay on one thread (and still match):
+	std::vector< CopyVertex > few(vertices.begin(), vertices.begin() + 3 * 10);
+	check_pooled< Pipeline_Blend_Over | Pipeline_Depth_Less | Pipeline_Interp_Smooth >(pool, few, 4);
+});
+
+//-------------------------------------------
+//rasterize_triangle_quads covers the same pixels, at the same depths, with the same attributes, as rasterize_triangle:
+
+using CopyClippedVertex = ::ClippedVertex< Programs::Copy::FA >;
+using CopyFragment = ::Fragment< Programs::Copy::FA, Programs::Copy::FD >;
+
+//random triangles in a 40x30 pixel area, with vertices often on pixel corners and centers, and edges
+// often shared with the previous triangle (so the top-left rule decides many pixels):
+static std::vector< CopyClippedVertex > random_clipped_triangles(uint32_t count, uint32_t seed) {
+	RNG rng(seed);
+	auto coordinate = [&](float max) {
+		float v = rng.unit() * max;
+		return rng.coin_flip(0.5f) ? std::round(v * 2.0f) / 2.0f : v;
+	};
+	std::vector< CopyClippedVertex > vertices;
+	vertices.reserve(count * 3);
+	for (uint32_t t = 0; t < count; ++t) {
+		for (uint32_t i = 0; i < 3; ++i) {
+			CopyClippedVertex v;
+			v.fb_position = Vec3(coordinate(40.0f), coordinate(30.0f), rng.unit());
+			v.inv_w = 0.5f + 1.5f * rng.unit();
+			for (float &a : v.attributes) a = rng.unit() * 2.0f - 1.0f;
+			vertices.emplace_back(v);
+		}
+		if (t > 0 && rng.coin_flip(0.3f)) {
+			size_t i = vertices.size() - 3;
+			vertices[i] = vertices[i - 2];
+			vertices[i + 1] = vertices[i - 3];
+		}
+	}
+	return vertices;
+}
+
+template< uint32_t flags >
+static void check_quads(std::vector< CopyClippedVertex > const &vertices) {
+	using P = CopyPipeline< flags >;
+	auto by_pixel = [](CopyFragment const &a, CopyFragment const &b) {
+		return std::make_pair(a.fb_position.y, a.fb_position.x) < std::make_pair(b.fb_position.y, b.fb_position.x);
+	};
+
+	for (uint32_t i = 0; i + 2 < vertices.size(); i += 3) {
+		std::string desc = "Flags " + std::to_string(flags) + ", triangle (" + to_string(vertices[i].fb_position) + ", "
+		                 + to_string(vertices[i + 1].fb_position) + ", " + to_string(vertices[i + 2].fb_position) + ")";
+
+		std::vector< CopyFragment > expected, got;
+		P::rasterize_triangle(vertices[i], vertices[i + 1], vertices[i + 2], [&](CopyFragment const &f) { expected.emplace_back(f); });
+		P::rasterize_triangle_quads(vertices[i], vertices[i + 1], vertices[i + 2], [&](CopyFragment const &f) { got.emplace_back(f); },
+			[](int32_t, int32_t) { return false; },
+			[](int32_t, int32_t, float const *, uint32_t covered) { return covered; });
+		std::sort(expected.begin(), expected.end(), by_pixel);
+		std::sort(got.begin(), got.end(), by_pixel);
+
+		if (got.size() != expected.size()) {
+			throw Test::error(desc + ": quads emitted " + std::to_string(got.size()) + " fragments, expected " + std::to_string(expected.size()) + ".");
+		}
+		for (uint32_t f = 0; f < got.size(); ++f) {
+			if (got[f].fb_position != expected[f].fb_position) {
+				throw Test::error(desc + ": quads emitted a fragment at " + to_string(got[f].fb_position) + ", expected " + to_string(expected[f].fb_position) + ".");
+			}
+			if (got[f].attributes != expected[f].attributes) {
+				throw Test::error(desc + ": quads emitted different attributes at " + to_string(got[f].fb_position) + ".");
+			}
+			//(derivatives come from neighbors in the quad, so only flat attributes -- with no derivatives -- match exactly)
+			if constexpr ((flags & PipelineMask_Interp) == Pipeline_Interp_Flat) {
+				if (got[f].derivatives != expected[f].derivatives) {
+					throw Test::error(desc + ": quads emitted nonzero derivatives for flat attributes at " + to_string(got[f].fb_position) + ".");
+				}
+			}
+		}
+	}
+}
+
+Test test_a1_pipeline_quads("a1.pipeline.quads", []() {
+	std::vector< CopyClippedVertex > vertices = random_clipped_triangles(2000, 2);
+	check_quads< Pipeline_Interp_Flat >(vertices);
+	check_quads< Pipeline_Interp_Smooth >(vertices);
+	check_quads< Pipeline_Interp_Correct >(vertices);
+
+	//(including triangles smaller than a pixel, or offset by sample positions)
+	std::vector< CopyClippedVertex > small = random_clipped_triangles(2000, 3);
+	for (auto &v : small) v.fb_position = Vec3(v.fb_position.x * 0.05f + 3.25f, v.fb_position.y * 0.05f + 2.75f, v.fb_position.z);
+	check_quads< Pipeline_Interp_Smooth >(small);
+});
+
+//-------------------------------------------
+//the std::function wrappers and the *_impl versions Pipeline::run calls emit the same fragments, in the same order:
+
+template< uint32_t flags >
+static void check_emit(std::vector< CopyClippedVertex > const &vertices) {
+	using P = CopyPipeline< flags >;
+	auto check = [&](std::string const &desc, std::vector< CopyFragment > const &expected, std::vector< CopyFragment > const &got) {
+		if (got.size() != expected.size()) {
+			throw Test::error(desc + ": _impl emitted " + std::to_string(got.size()) + " fragments, expected " + std::to_string(expected.size()) + ".");
+		}
+		for (uint32_t f = 0; f < got.size(); ++f) {
+			if (got[f].fb_position != expected[f].fb_position || got[f].attributes != expected[f].attributes || got[f].derivatives != expected[f].derivatives) {
+				throw Test::error(desc + ": fragment " + std::to_string(f) + " from _impl is at " + to_string(got[f].fb_position) + ", expected "
+				                  + to_string(expected[f].fb_position) + " (or its attributes or derivatives differ).");
+			}
+		}
+	};
+
+	for (uint32_t i = 0; i + 2 < vertices.size(); i += 3) {
+		std::string desc = "Flags " + std::to_string(flags) + ", triangle " + std::to_string(i / 3);
+		std::vector< CopyFragment > expected, got;
+		P::rasterize_triangle(vertices[i], vertices[i + 1], vertices[i + 2], [&](CopyFragment const &f) { expected.emplace_back(f); });
+		P::rasterize_triangle_impl(vertices[i], vertices[i + 1], vertices[i + 2], [&](CopyFragment const &f) { got.emplace_back(f); });
+		check(desc, expected, got);
+
+		//(rasterize_line is only for flat interpolation)
+		if constexpr ((flags & PipelineMask_Interp) == Pipeline_Interp_Flat) {
+			expected.clear();
+			got.clear();
+			P::rasterize_line(vertices[i], vertices[i + 1], [&](CopyFragment const &f) { expected.emplace_back(f); });
+			P::rasterize_line_impl(vertices[i], vertices[i + 1], [&](CopyFragment const &f) { got.emplace_back(f); });
+			check("Flags " + std::to_string(flags) + ", line " + std::to_string(i / 3), expected, got);
+		}
+	}
+}
+
+Test test_a1_pipeline_emit("a1.pipeline.emit", []() {
+	std::vector< CopyClippedVertex > vertices = random_clipped_triangles(2000, 9);
+	check_emit< Pipeline_Interp_Flat >(vertices);
+	check_emit< Pipeline_Interp_Smooth >(vertices);
+	check_emit< Pipeline_Interp_Correct >(vertices);
+});
+
+//-------------------------------------------
+//Depth_Less runs (which skip hidden triangles, blocks, and quads early) draw what a plain depth test would:
+
+//the same steps as Pipeline::run, but with rasterize_triangle and only the usual, late, depth test:
+// (replace blending, so triangles are drawn in order with nothing skipped)
+static Framebuffer reference_depth_less(std::vector< CopyVertex > const &vertices, uint32_t width, uint32_t height, uint32_t pattern) {
+	using P = CopyPipeline< Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Smooth >;
+	Framebuffer fb = test_fb(width, height, pattern);
+	std::vector< Vec3 > const &samples = fb.sample_pattern.centers_and_weights;
+	Vec3 const clip_to_fb_scale(width / 2.0f, height / 2.0f, 0.5f);
+
+	for (uint32_t i = 0; i + 2 < vertices.size(); i += 3) {
+		P::ClippedVertex clipped[3];
+		for (uint32_t j = 0; j < 3; ++j) {
+			P::ShadedVertex sv;
+			Programs::Copy::shade_vertex(Programs::Copy::Parameters(), vertices[i + j].attributes, &sv.clip_position, &sv.attributes);
+			float inv_w = 1.0f / sv.clip_position.w;
+			clipped[j].fb_position = clip_to_fb_scale * inv_w * sv.clip_position.xyz();
+			clipped[j].inv_w = inv_w;
+			clipped[j].attributes = sv.attributes;
+		}
+		for (uint32_t s = 0; s < samples.size(); ++s) {
+			Vec3 const clip_to_fb_offset(0.5f * width + (samples[s].x - 0.5f), 0.5f * height + (samples[s].y - 0.5f), 0.5f);
+			P::ClippedVertex v[3];
+			for (uint32_t j = 0; j < 3; ++j) {
+				v[j] = clipped[j];
+				v[j].fb_position += clip_to_fb_offset;
+			}
+			P::rasterize_triangle(v[0], v[1], v[2], [&](P::Fragment const &f) {
+				int32_t x = int32_t(std::floor(f.fb_position.x)), y = int32_t(std::floor(f.fb_position.y));
+				if (x < 0 || uint32_t(x) >= width || y < 0 || uint32_t(y) >= height) return;
+				float &depth = fb.depth_at(x, y, s);
+				if (f.fb_position.z >= depth) return;
+				depth = f.fb_position.z;
+				float opacity;
+				Programs::Copy::shade_fragment(Programs::Copy::Parameters(), f.attributes, f.derivatives, &fb.color_at(x, y, s), &opacity);
+			});
+		}
+	}
+	return fb;
+}
+
+Test test_a1_pipeline_early_depth("a1.pipeline.early_depth", []() {
+	using P = CopyPipeline< Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Smooth >;
+
+	//large occluders up front, then a mix of hidden, partly hidden, and visible triangles
+	// (on a framebuffer large enough that many triangles get hierarchical tests):
+	std::vector< CopyVertex > vertices;
+	auto quad = [&](float x0, float y0, float x1, float y1, float z, Spectrum color) {
+		float corners[6][2] = {{x0, y0}, {x1, y0}, {x1, y1}, {x0, y0}, {x1, y1}, {x0, y1}};
+		for (auto const &c : corners) vertices.emplace_back(CopyVertex{{c[0], c[1], z, 1.0f, color.r, color.g, color.b, 1.0f}});
+	};
+	quad(-1.0f, -1.0f, 0.1f, 1.0f, -0.6f, Spectrum(1.0f, 0.0f, 0.0f));
+	quad(-0.3f, -0.8f, 0.9f, 0.2f, 0.1f, Spectrum(0.0f, 1.0f, 0.0f));
+	std::vector< CopyVertex > more = random_triangles(3000, 5);
+	vertices.insert(vertices.end(), more.begin(), more.end());
+	//...and a second layer of occluders, over triangles that were visible when drawn:
+	quad(0.2f, 0.3f, 1.0f, 1.0f, -0.9f, Spectrum(0.0f, 0.0f, 1.0f));
+	more = random_triangles(1000, 6);
+	vertices.insert(vertices.end(), more.begin(), more.end());
+
+	Thread_Pool pool(4);
+	for (uint32_t pattern : {1u, 4u}) {
+		Framebuffer expected = reference_depth_less(vertices, 256, 192, pattern);
+		for (Thread_Pool *thread_pool : {(Thread_Pool *)nullptr, &pool}) {
+			Framebuffer got = test_fb(256, 192, pattern);
+			got.thread_pool = thread_pool;
+			P::run(vertices, Programs::Copy::Parameters(), &got);
+			check_same("Depth_Less, pattern " + std::to_string(pattern) + (thread_pool ? ", on a pool" : ""), expected, got);
+		}
+	}
+});
+
+//-------------------------------------------
+//Pipeline_CullBackBit drops exactly the clockwise triangles, and counts them:
+
+Test test_a1_pipeline_cull("a1.pipeline.cull", []() {
+	using Culled = CopyPipeline< Pipeline_Blend_Over | Pipeline_Depth_Less | Pipeline_Interp_Smooth | Pipeline_CullBackBit >;
+	using Unculled = CopyPipeline< Pipeline_Blend_Over | Pipeline_Depth_Less | Pipeline_Interp_Smooth >;
+
+	//random triangles (about half of them clockwise), less a few too close to edge-on to call:
+	std::vector< CopyVertex > random = random_triangles(1500, 7);
+	std::vector< CopyVertex > vertices, front;
+	uint32_t back = 0;
+	for (uint32_t i = 0; i + 2 < random.size(); i += 3) {
+		//(signed area on screen, in double precision; w is always positive here)
+		double p[3][2];
+		for (uint32_t j = 0; j < 3; ++j) {
+			auto const &a = random[i + j].attributes;
+			p[j][0] = double(a[0]) / double(a[3]);
+			p[j][1] = double(a[1]) / double(a[3]);
+		}
+		double area = (p[1][0] - p[0][0]) * (p[2][1] - p[0][1]) - (p[1][1] - p[0][1]) * (p[2][0] - p[0][0]);
+		if (std::abs(area) < 1e-4) continue;
+		vertices.insert(vertices.end(), random.begin() + i, random.begin() + i + 3);
+		if (area < 0.0) back += 1;
+		else front.insert(front.end(), random.begin() + i, random.begin() + i + 3);
+	}
+	if (back < 100 || front.size() / 3 < 100) throw Test::error("Test triangles aren't a mix of front and back faces.");
+
+	Thread_Pool pool(4);
+	for (uint32_t pattern : {1u, 4u}) {
+		for (Thread_Pool *thread_pool : {(Thread_Pool *)nullptr, &pool}) {
+			std::string desc = "Pattern " + std::to_string(pattern) + (thread_pool ? ", on a pool" : "");
+
+			Framebuffer culled = test_fb(70, 46, pattern);
+			culled.thread_pool = thread_pool;
+			PipelineStats stats;
+			Culled::run(vertices, Programs::Copy::Parameters(), &culled, &stats);
+			if (stats.backfacing_triangles != back) {
+				throw Test::error(desc + ": culled " + std::to_string(stats.backfacing_triangles) + " back-facing triangles, expected " + std::to_string(back) + ".");
+			}
+
+			//(same image as drawing only the front faces)
+			Framebuffer expected = test_fb(70, 46, pattern);
+			Unculled::run(front, Programs::Copy::Parameters(), &expected);
+			check_same(desc, expected, culled);
+
+			//counts add up over runs, and only culling runs count:
+			Culled::run(vertices, Programs::Copy::Parameters(), &culled, &stats);
+			Unculled::run(vertices, Programs::Copy::Parameters(), &culled, &stats);
+			if (stats.backfacing_triangles != 2 * back) {
+				throw Test::error(desc + ": counted " + std::to_string(stats.backfacing_triangles) + " back-facing triangles over two culled runs, expected " + std::to_string(2 * back) + ".");
+			}
+		}
+	}
+});
+
+//-------------------------------------------
+//indexed runs draw the same as non-indexed runs of the vertices their indices pick out:
+
+template< uint32_t flags >
+static void check_indexed(Thread_Pool *thread_pool, std::vector< CopyVertex > const &vertices, std::vector< uint32_t > const &indices, uint32_t pattern) {
+	std::string desc = "Flags " + std::to_string(flags) + ", pattern " + std::to_string(pattern) + (thread_pool ? ", on a pool" : "");
+
+	std::vector< CopyVertex > expanded;
+	expanded.reserve(indices.size());
+	for (uint32_t i : indices) expanded.emplace_back(vertices[i]);
+
+	Framebuffer expected = test_fb(70, 46, pattern);
+	expected.thread_pool = thread_pool;
+	PipelineStats expected_stats;
+	CopyPipeline< flags >::run(expanded, Programs::Copy::Parameters(), &expected, &expected_stats);
+
+	Framebuffer got = test_fb(70, 46, pattern);
+	got.thread_pool = thread_pool;
+	PipelineStats got_stats;
+	CopyPipeline< flags >::run(vertices, indices, Programs::Copy::Parameters(), &got, &got_stats);
+
+	check_same(desc, expected, got);
+	if (got_stats.backfacing_triangles != expected_stats.backfacing_triangles) {
+		throw Test::error(desc + ": indexed run culled " + std::to_string(got_stats.backfacing_triangles) + " back-facing triangles, expected " + std::to_string(expected_stats.backfacing_triangles) + ".");
+	}
+}
+
+Test test_a1_pipeline_indexed("a1.pipeline.indexed", []() {
+	//a grid of shared vertices (with a few no triangle uses), split into triangles of random orientation,
+	// some of them repeated:
+	constexpr uint32_t N = 40;
+	RNG rng(8);
+	std::vector< CopyVertex > vertices;
+	for (uint32_t y = 0; y <= N; ++y) {
+		for (uint32_t x = 0; x <= N; ++x) {
+			float w = 0.5f + 1.5f * rng.unit();
+			float z = rng.unit() * 2.0f - 1.0f;
+			Vec2 at = Vec2(float(x), float(y)) / float(N) * 2.0f - Vec2(1.0f);
+			vertices.emplace_back(CopyVertex{{at.x * w, at.y * w, z * w, w, rng.unit(), rng.unit(), rng.unit(), rng.unit()}});
+		}
+	}
+	std::vector< uint32_t > indices;
+	for (uint32_t y = 0; y < N; ++y) {
+		for (uint32_t x = 0; x < N; ++x) {
+			if (rng.coin_flip(0.05f)) continue;
+			uint32_t a = y * (N + 1) + x, b = a + 1, c = a + (N + 1), d = c + 1;
+			uint32_t const ccw[6] = {a, b, d, a, d, c}, cw[6] = {a, d, b, a, c, d};
+			uint32_t const *quad = rng.coin_flip(0.5f) ? ccw : cw;
+			indices.insert(indices.end(), quad, quad + 6);
+			if (rng.coin_flip(0.1f)) indices.insert(indices.end(), quad + 3, quad + 6);
+		}
+	}
+
+	Thread_Pool pool(4);
+	for (uint32_t pattern : {1u, 4u}) {
+		for (Thread_Pool *thread_pool : {(Thread_Pool *)nullptr, &pool}) {
+			check_indexed< Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Smooth >(thread_pool, vertices, indices, pattern);
+			check_indexed< Pipeline_Blend_Over | Pipeline_Depth_Less | Pipeline_Interp_Correct | Pipeline_CullBackBit >(thread_pool, vertices, indices, pattern);
+			check_indexed< Pipeline_Blend_Add | Pipeline_Depth_Always | Pipeline_Interp_Flat >(thread_pool, vertices, indices, pattern);
+		}
+	}
+
+	//indices past the end of vertices are an error:
+	bool threw = false;
+	try {
+		std::vector< uint32_t > bad{0, 1, uint32_t(vertices.size())};
+		Framebuffer fb = test_fb(70, 46, 1);
+		CopyPipeline< Pipeline_Blend_Replace | Pipeline_Depth_Less | Pipeline_Interp_Smooth >::run(vertices, bad, Programs::Copy::Parameters(), &fb);
+	} catch (std::runtime_error const &) {
+		threw = true;
+	}
+	if (!threw) throw Test::error("Indexed run with an out-of-range index didn't throw.");
+});
+
+//-------------------------------------------
+//scissored runs draw what unscissored runs do inside the scissor rectangle, and leave everything outside it alone:
+
+Test test_a1_pipeline_scissor("a1.pipeline.scissor", []() {
+	using P = CopyPipeline< Pipeline_Blend_Over | Pipeline_Depth_Less | Pipeline_Interp_Smooth >;
+	//(enough triangles for several rounds of chunks on four threads)
+	std::vector< CopyVertex > vertices = random_triangles(2 * 8 * P::ChunkPrimitives + 100, 3);
+	uint32_t const x_begin = 13, x_end = 51, y_begin = 7, y_end = 30;
+
+	Thread_Pool pool(4);
+	for (uint32_t pattern : {1u, 4u}) {
+		Framebuffer full = test_fb(70, 46, pattern);
+		P::run(vertices, Programs::Copy::Parameters(), &full);
+		Framebuffer const untouched = test_fb(70, 46, pattern);
+
+		//expected: the full run inside the rectangle, the background outside it:
+		Framebuffer expected = test_fb(70, 46, pattern);
+		uint32_t drawn = 0;
+		for (uint32_t y = y_begin; y < y_end; ++y) {
+			for (uint32_t x = x_begin; x < x_end; ++x) {
+				for (uint32_t s = 0; s < expected.samples; ++s) {
+					expected.color_at(x, y, s) = full.color_at(x, y, s);
+					expected.depth_at(x, y, s) = full.depth_at(x, y, s);
+					if (full.color_at(x, y, s) != untouched.color_at(x, y, s)) drawn += 1;
+				}
+			}
+		}
+		//(otherwise a run that drew nothing would pass)
+		if (drawn == 0) throw Test::error("Test triangles don't cover the scissor rectangle.");
+
+		for (Thread_Pool *thread_pool : {(Thread_Pool *)nullptr, &pool}) {
+			Framebuffer got = test_fb(70, 46, pattern);
+			got.thread_pool = thread_pool;
+			got.set_scissor(x_begin, x_end, y_begin, y_end);
+			if (!got.scissored()) throw Test::error("Framebuffer with a scissor rectangle isn't scissored.");
+			P::run(vertices, Programs::Copy::Parameters(), &got);
+			check_same("Scissored, pattern " + std::to_string(pattern) + (thread_pool ? ", on a pool" : ""), expected, got);
+		}
+	}
+
+	//scissor rectangles are clamped to the framebuffer:
+	Framebuffer fb = test_fb(70, 46, 1);
+	fb.set_scissor(0, 100, 0, 1000);
+	if (fb.scissored()) throw Test::error("Scissor rectangle covering the whole framebuffer counts as scissored.");
+	fb.set_scissor(60, 200, 40, 10);
+	if (fb.scissor_x_begin != 60 || fb.scissor_x_end != 70 || fb.scissor_y_begin != 10 || fb.scissor_y_end != 10) {
+		throw Test::error("Scissor [60,200)x[40,10) on a 70x46 framebuffer became [" + std::to_string(fb.scissor_x_begin) + "," + std::to_string(fb.scissor_x_end) + ")x["
+		                  + std::to_string(fb.scissor_y_begin) + "," + std::to_string(fb.scissor_y_end) + "), expected [60,70)x[10,10).");
+	}
+	//...and an empty one draws nothing:
+	P::run(vertices, Programs::Copy::Parameters(), &fb);
+	check_same("Empty scissor", test_fb(70, 46, 1), fb);
+});
+
+//-------------------------------------------
+//crop windows (which become the rasterizer's scissor rectangle) are clamped to the film, and given from the top-left:
+
+static void check_rect(std::string const &desc, Camera::Film_Rect got, Camera::Film_Rect expected) {
+	auto str = [](Camera::Film_Rect const &r) {
+		return "[" + std::to_string(r.x_begin) + "," + std::to_string(r.x_end) + ")x[" + std::to_string(r.y_begin) + "," + std::to_string(r.y_end) + ")";
+	};
+	if (got != expected) throw Test::error(desc + " gave " + str(got) + ", expected " + str(expected) + ".");
+}
+
+Test test_a1_pipeline_crop("a1.pipeline.crop", []() {
+	Camera camera;
+	camera.film.width = 64;
+	camera.film.height = 48;
+	check_rect("No crop window", camera.crop_rect(), {0, 64, 0, 48});
+	if (camera.cropped()) throw Test::error("Camera with no crop window is cropped.");
+
+	//windows are clamped to the film (with sums that can't wrap around):
+	camera.film.crop_x = 60;
+	camera.film.crop_y = 40;
+	camera.film.crop_width = 10;
+	camera.film.crop_height = 20;
+	check_rect("Crop window past the top-right corner", camera.crop_rect(), {60, 64, 40, 48});
+	camera.film.crop_x = 10;
+	camera.film.crop_width = std::numeric_limits< uint32_t >::max();
+	check_rect("Crop window of huge width", camera.crop_rect(), {10, 64, 40, 48});
+	camera.film.crop_x = 100;
+	check_rect("Crop window right of the film", camera.crop_rect(), {64, 64, 40, 48});
+	camera.film.crop_height = 0;
+	check_rect("Crop window of zero height", camera.crop_rect(), {0, 64, 0, 48});
+
+	//windows from the top-left are flipped to count from the bottom-left:
+	camera.crop_from_top_left(10, 5, 20, 8);
+	check_rect("Crop window of 20x8 at (10,5) from the top-left", camera.crop_rect(), {10, 30, 35, 43});
+	if (!camera.cropped()) throw Test::error("Camera with a crop window isn't cropped.");
+	camera.crop_from_top_left(50, 40, 100, 100);
+	check_rect("Crop window of 100x100 at (50,40) from the top-left", camera.crop_rect(), {50, 64, 0, 8});
+	camera.crop_from_top_left(0, 0, 64, 48);
+	check_rect("Crop window covering the film", camera.crop_rect(), {0, 64, 0, 48});
+	if (camera.cropped()) throw Test::error("Camera with a crop window covering the film is cropped.");
+});
@@ -0,0 +1,177 @@
+#include "test.h"
+
+#include "scene/texture.h"
+#include "util/rand.h"
+
+#include <cmath>
+
+//-------------------------------------------
+//check packed texture storage (used by --texture-storage) against the row-major images it copies:
+
+static HDR_Image random_image(uint32_t w, uint32_t h, float scale, uint32_t seed) {
+	HDR_Image image(w, h);
+	RNG rng(seed);
+	for (uint32_t y = 0; y < h; ++y) {
+		for (uint32_t x = 0; x < w; ++x) {
+			image.at(x, y) = scale * Spectrum(rng.unit(), rng.unit(), rng.unit());
+		}
+	}
+	return image;
+}
+
+Test test_a1_task6_packed_f16("a1.task6.packed.f16", []() {
+	//values that halves hold exactly:
+	for (float f : {0.0f, 1.0f, -2.0f, 0.5f, 0.1875f, 65504.0f, -65504.0f, 0x1p-14f, 0x1p-24f, 3.0f * 0x1p-24f}) {
+		float got = Packed_Image::half_to_float(Packed_Image::float_to_half(f));
+		if (got != f) {
+			throw Test::error("Half of " + std::to_string(f) + " decodes to " + std::to_string(got) + ".");
+		}
+	}
+
+	//every finite half decodes and encodes back to itself:
+	for (uint32_t h = 0; h < 0x10000; ++h) {
+		if ((h & 0x7c00) == 0x7c00) continue; //(infinities and NaNs)
+		uint16_t again = Packed_Image::float_to_half(Packed_Image::half_to_float(uint16_t(h)));
+		if (again != h) {
+			throw Test::error("Half " + std::to_string(h) + " round-trips to " + std::to_string(again) + ".");
+		}
+	}
+
+	//values between halves round to nearest (so lose at most half a unit in the last place):
+	RNG rng(1);
+	for (uint32_t n = 0; n < 100000; ++n) {
+		float f = std::ldexp(rng.unit() + 1.0f, rng.integer(-14, 16)) * (rng.coin_flip(0.5f) ? -1.0f : 1.0f);
+		float got = Packed_Image::half_to_float(Packed_Image::float_to_half(f));
+		if (std::abs(got - f) > std::abs(f) * 0x1p-11f) {
+			throw Test::error("Half of " + std::to_string(f) + " decodes to " + std::to_string(got) + ", which is not the nearest half.");
+		}
+	}
+
+	//out-of-range values clamp, and NaN stays NaN:
+	if (Packed_Image::half_to_float(Packed_Image::float_to_half(1e6f)) != 65504.0f
+	 || Packed_Image::half_to_float(Packed_Image::float_to_half(-INFINITY)) != -65504.0f) {
+		throw Test::error("Half of a too-large value doesn't clamp to the largest half.");
+	}
+	if (!std::isnan(Packed_Image::half_to_float(Packed_Image::float_to_half(NAN)))) {
+		throw Test::error("Half of NaN isn't NaN.");
+	}
+});
+
+Test test_a1_task6_packed_rgb9e5("a1.task6.packed.rgb9e5", []() {
+	auto round_trip = [](Spectrum s) {
+		uint32_t bits = Packed_Image::spectrum_to_rgb9e5(s);
+		return Packed_Image::decode_rgb9e5(reinterpret_cast< uint8_t const * >(&bits));
+	};
+
+	//values that share an exponent with few enough mantissa bits are exact:
+	for (Spectrum s : {Spectrum(0.0f), Spectrum(1.0f), Spectrum(0.5f, 0.25f, 0.125f), Spectrum(511.0f, 0.0f, 1.0f), Spectrum(65408.0f)}) {
+		Spectrum got = round_trip(s);
+		if (got != s) {
+			throw Test::error("rgb9e5 of " + to_string(s) + " decodes to " + to_string(got) + ".");
+		}
+	}
+
+	//otherwise, every channel is within half a step of the shared exponent's 9-bit mantissa:
+	// (steps are never smaller than 2^-24, the step of the smallest exponent)
+	RNG rng(2);
+	for (uint32_t n = 0; n < 100000; ++n) {
+		float scale = std::ldexp(1.0f, rng.integer(-14, 15));
+		Spectrum s = scale * Spectrum(rng.unit(), rng.unit(), rng.unit());
+		Spectrum got = round_trip(s);
+		float max = std::max(s.r, std::max(s.g, s.b));
+		for (uint32_t c = 0; c < 3; ++c) {
+			if (std::abs(got[c] - s[c]) > std::max(max * 0x1p-9f, 0x1p-25f)) {
+				throw Test::error("rgb9e5 of " + to_string(s) + " decodes to " + to_string(got) + ".");
+			}
+		}
+	}
+
+	//negative values and NaN become zero, and too-large values clamp:
+	if (round_trip(Spectrum(-1.0f, NAN, 2.0f)) != Spectrum(0.0f, 0.0f, 2.0f)) {
+		throw Test::error("rgb9e5 doesn't map negative values and NaN to zero.");
+	}
+	if (round_trip(Spectrum(1e9f, 0.0f, 0.0f)) != Spectrum(65408.0f, 0.0f, 0.0f)) {
+		throw Test::error("rgb9e5 doesn't clamp too-large values.");
+	}
+});
+
+Test test_a1_task6_packed_layout("a1.task6.packed.layout", []() {
+	//odd sizes, so edge tiles are partly padding:
+	HDR_Image image = random_image(13, 7, 4.0f, 3);
+	Packed_Image packed(image, Packed_Image::Encoding::f32);
+	if (packed.w != image.w || packed.h != image.h || packed.bytes() != size_t(4 * 2) * 16 * 12) {
+		throw Test::error("Packed 13x7 image is " + std::to_string(packed.w) + "x" + std::to_string(packed.h) + " in " + std::to_string(packed.bytes()) + " bytes.");
+	}
+
+	//every texel has its own slot, within its 4x4 tile:
+	std::vector< bool > used(4 * 2 * 16, false);
+	for (uint32_t y = 0; y < image.h; ++y) {
+		for (uint32_t x = 0; x < image.w; ++x) {
+			uint32_t i = packed.index(x, y);
+			if (i >= used.size() || used[i]) throw Test::error("Texel (" + std::to_string(x) + ", " + std::to_string(y) + ") has a bad or repeated index.");
+			used[i] = true;
+			if (i / 16 != (y / 4) * 4 + (x / 4) || i % 16 != (y % 4) * 4 + (x % 4)) {
+				throw Test::error("Texel (" + std::to_string(x) + ", " + std::to_string(y) + ") isn't in its 4x4 tile.");
+			}
+			if (packed.at(x, y) != image.at(x, y)) {
+				throw Test::error("Texel (" + std::to_string(x) + ", " + std::to_string(y) + ") reads back as " + to_string(packed.at(x, y)) + ".");
+			}
+		}
+	}
+
+	//smaller encodings:
+	if (Packed_Image(image, Packed_Image::Encoding::f16).bytes() != packed.bytes() / 2
+	 || Packed_Image(image, Packed_Image::Encoding::rgb9e5).bytes() != packed.bytes() / 3) {
+		throw Test::error("f16 or rgb9e5 images aren't a half or a third the size of f32 images.");
+	}
+});
+
+Test test_a1_task6_packed_sample("a1.task6.packed.sample", []() {
+	using Storage = Textures::Image::Storage;
+	using Sampler = Textures::Image::Sampler;
+	HDR_Image image = random_image(37, 20, 2.0f, 4);
+
+	//(relative to the data range)
+	std::pair< Storage, float > storages[] = {{Storage::tiled, 0.0f}, {Storage::tiled_f16, 2.0f * 0x1p-11f}, {Storage::tiled_rgb9e5, 2.0f * 0x1p-9f}};
+	RNG rng(5);
+	for (Sampler sampler : {Sampler::nearest, Sampler::bilinear, Sampler::trilinear}) {
+		Textures::Image rows(sampler, image, Storage::rows);
+		for (auto [storage, tolerance] : storages) {
+			Textures::Image packed(sampler, image, storage);
+			if (!packed.levels.empty() || packed.packed_levels.size() != rows.levels.size()) {
+				throw Test::error("Packed image should keep (only) packed copies of its mipmap levels.");
+			}
+			for (uint32_t n = 0; n < 2000; ++n) {
+				//(including uvs outside [0,1] and lods past the last level)
+				Vec2 uv(rng.unit() * 1.2f - 0.1f, rng.unit() * 1.2f - 0.1f);
+				float lod = rng.unit() * 8.0f - 1.0f;
+				Spectrum expected = rows.evaluate(uv, lod);
+				Spectrum got = packed.evaluate(uv, lod);
+				for (uint32_t c = 0; c < 3; ++c) {
+					if (std::abs(got[c] - expected[c]) > tolerance) {
+						throw Test::error("Packed storage " + std::to_string(int(storage)) + " sampled " + to_string(got) + " at " + to_string(uv) + " (lod " + std::to_string(lod) + "), but rows sampled " + to_string(expected) + ".");
+					}
+				}
+			}
+		}
+	}
+
+	//storage can be changed after construction (e.g., for --texture-storage), and back:
+	Textures::Image texture(Sampler::trilinear, image, Storage::rows);
+	texture.set_storage(Storage::tiled);
+	if (texture.packed.w != image.w || texture.evaluate(Vec2(0.3f, 0.6f), 1.5f) != Textures::Image(Sampler::trilinear, image, Storage::tiled).evaluate(Vec2(0.3f, 0.6f), 1.5f)) {
+		throw Test::error("Changing storage to tiled didn't re-pack the texture.");
+	}
+	texture.set_storage(Storage::rows);
+	if (texture.packed.w != 0 || texture.levels.empty()) {
+		throw Test::error("Changing storage back to rows didn't restore the mipmap levels.");
+	}
+
+	//1x1 images have no levels to blend:
+	HDR_Image one(1, 1, std::vector< Spectrum >{Spectrum(0.25f, 0.5f, 0.75f)});
+	for (Storage storage : {Storage::rows, Storage::tiled}) {
+		if (Textures::Image(Sampler::trilinear, one, storage).evaluate(Vec2(0.5f, 0.5f), 3.0f) != one.at(0, 0)) {
+			throw Test::error("Trilinear sampling of a 1x1 image doesn't return its texel.");
+		}
+	}
+});
@@ -0,0 +1,47 @@
+#include "test.h"
+
+#include "rasterizer/framebuffer.h"
+#include "rasterizer/sample_pattern.h"
+
+//-------------------------------------------------
+//framebuffer storage follows the tile layout documented with Framebuffer::index:
+
+Test test_a1_task7_index_tiles("a1.task7.index.tiles", []() {
+	constexpr uint32_t T = Framebuffer::TileSize;
+	SamplePattern const five(SamplePattern::CustomBit | 1235, "five samples", std::vector<Vec3>(5, Vec3(0.5f, 0.5f, 0.2f)));
+
+	//(sizes with and without partial tiles on the right and top edges)
+	std::pair< uint32_t, uint32_t > sizes[] = {{2, 2}, {8, 8}, {16, 8}, {10, 6}, {14, 22}, {70, 46}, {64, 66}};
+	for (SamplePattern const *pattern : {SamplePattern::from_id(1), SamplePattern::from_id(4), &five}) {
+		for (auto [width, height] : sizes) {
+			Framebuffer fb(width, height, *pattern);
+			std::string desc = std::to_string(width) + "x" + std::to_string(height) + "x" + std::to_string(fb.samples) + " framebuffer";
+
+			//walk the layout -- rows of tiles from the bottom, each tile's sample planes in turn, each plane row by row --
+			// counting up storage slots, which should be exactly the ones index() gives:
+			uint32_t next = 0;
+			for (uint32_t tile_y = 0; tile_y < height; tile_y += T) {
+				for (uint32_t tile_x = 0; tile_x < width; tile_x += T) {
+					uint32_t tile_width = std::min(T, width - tile_x), tile_height = std::min(T, height - tile_y);
+					for (uint32_t s = 0; s < fb.samples; ++s) {
+						for (uint32_t y = tile_y; y < tile_y + tile_height; ++y) {
+							for (uint32_t x = tile_x; x < tile_x + tile_width; ++x) {
+								if (fb.index(x, y, s) != next) {
+									throw Test::error(desc + ": index(" + std::to_string(x) + ", " + std::to_string(y) + ", " + std::to_string(s) + ") is "
+									                  + std::to_string(fb.index(x, y, s)) + ", but the tile layout puts it at " + std::to_string(next) + ".");
+								}
+								next += 1;
+							}
+						}
+					}
+				}
+			}
+
+			//...which is every slot, once (no padding):
+			if (next != fb.colors.size() || next != fb.depths.size()) {
+				throw Test::error(desc + " has " + std::to_string(fb.colors.size()) + " color and " + std::to_string(fb.depths.size())
+				                  + " depth slots for " + std::to_string(next) + " samples.");
+			}
+		}
+	}
+});
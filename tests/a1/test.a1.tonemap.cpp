@@ -0,0 +1,113 @@
+#include "test.h"
+
+#include "util/hdr_image.h"
+#include "util/rand.h"
+#include "util/thread_pool.h"
+
+#include <cmath>
+#include <limits>
+
+//-------------------------------------------------
+//tonemap_to (vectorized, and split over a thread pool) must match tonemap_channel byte-for-byte:
+
+//channel values that are hard to get right at exposure e:
+static std::vector< float > tricky_values(float e) {
+	std::vector< float > values;
+	//values near v, a few ulps either way:
+	auto around = [&](float v, uint32_t ulps) {
+		values.emplace_back(v);
+		float below = v, above = v;
+		for (uint32_t i = 0; i < ulps; ++i) {
+			below = std::nextafter(below, -std::numeric_limits< float >::infinity());
+			above = std::nextafter(above, std::numeric_limits< float >::infinity());
+			values.emplace_back(below);
+			values.emplace_back(above);
+		}
+	};
+	//channel value that tonemaps to linear value t:
+	auto from_linear = [&](double t) {
+		return float(-std::log1p(-t) / double(e));
+	};
+
+	//zero (and tiny values):
+	values.insert(values.end(), {0.0f, -0.0f, 1e-40f, 1e-20f});
+
+	//the sRGB knee:
+	around(from_linear(0.0031308), 8);
+
+	//each rounding boundary (where the 8-bit value is exactly halfway between two bytes):
+	for (uint32_t b = 0; b < 255; ++b) {
+		double srgb = (b + 0.5) / 255.0;
+		double t = srgb <= 0.04045 ? srgb / 12.92 : std::pow((srgb + 0.055) / 1.055, 2.4);
+		around(from_linear(t), 4);
+	}
+
+	//past the range the vectorized exp handles:
+	around(80.0f / e, 4);
+	values.insert(values.end(), {81.0f / e, 1000.0f / e, 1e30f, std::numeric_limits< float >::infinity()});
+
+	//negatives and NaN:
+	values.insert(values.end(), {-1e-30f, -0.001f, -0.5f, -3.0f, -1e30f, -std::numeric_limits< float >::infinity()});
+	values.insert(values.end(), {std::numeric_limits< float >::quiet_NaN(), -std::numeric_limits< float >::quiet_NaN()});
+
+	//and some ordinary values:
+	RNG rng(17);
+	for (uint32_t i = 0; i < 100; ++i) {
+		values.emplace_back(rng.unit() * 4.0f / e);
+	}
+	return values;
+}
+
+Test test_a1_tonemap_matches_scalar("a1.tonemap.matches_scalar", []() {
+	Thread_Pool pool(4);
+
+	//(sizes are not multiples of four pixels; the largest is split into several ranges for the pool)
+	std::pair< uint32_t, uint32_t > sizes[] = {{1, 1}, {3, 1}, {5, 7}, {31, 9}, {257, 259}};
+	for (float e : {1.0f, 0.37f, 5.5f}) {
+		std::vector< float > values = tricky_values(e);
+		for (auto [w, h] : sizes) {
+			//channels cycle through the values, starting a bit further along for each size,
+			// so values land in every position of a vector and in the scalar tail:
+			std::vector< Spectrum > pixels(w * h);
+			size_t next = w + h;
+			for (auto &pixel : pixels) {
+				for (uint32_t c = 0; c < 3; ++c) {
+					pixel.data[c] = values[next++ % values.size()];
+				}
+			}
+			HDR_Image image(w, h, pixels);
+
+			for (Thread_Pool *thread_pool : {(Thread_Pool *)nullptr, &pool}) {
+				std::vector< uint8_t > data;
+				image.tonemap_to(data, e, thread_pool);
+				std::string desc = std::to_string(w) + "x" + std::to_string(h) + " image at exposure " + std::to_string(e) + (thread_pool ? " (with a thread pool)" : "");
+				if (data.size() != size_t(w) * h * 4) {
+					throw Test::error(desc + " tonemapped to " + std::to_string(data.size()) + " bytes.");
+				}
+				for (uint32_t i = 0; i < w * h; ++i) {
+					for (uint32_t c = 0; c < 4; ++c) {
+						uint8_t expected = c < 3 ? HDR_Image::tonemap_channel(pixels[i].data[c], e) : 255;
+						if (data[4 * i + c] != expected) {
+							throw Test::error(desc + ": pixel " + std::to_string(i) + " channel " + std::to_string(c) + " (value " + std::to_string(pixels[i].data[c]) + ") is " + std::to_string(data[4 * i + c]) + ", expected " + std::to_string(expected) + ".");
+						}
+					}
+				}
+			}
+		}
+	}
+});
+
+Test test_a1_tonemap_channel("a1.tonemap.channel", []() {
+	//fixed points of the curve, and values with no sensible brightness:
+	float inf = std::numeric_limits< float >::infinity();
+	std::pair< float, uint8_t > expect[] = {
+		{0.0f, 0}, {-0.0f, 0}, {inf, 255}, {1e30f, 255},
+		{-1.0f, 0}, {-inf, 0}, {std::numeric_limits< float >::quiet_NaN(), 0},
+	};
+	for (auto [v, expected] : expect) {
+		uint8_t got = HDR_Image::tonemap_channel(v, 1.0f);
+		if (got != expected) {
+			throw Test::error("Value " + std::to_string(v) + " tonemapped to " + std::to_string(got) + ", expected " + std::to_string(expected) + ".");
+		}
+	}
+});
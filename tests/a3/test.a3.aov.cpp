@@ -0,0 +1,89 @@
+#include "test.h"
+#include "pathtracer/aov.h"
+
+using namespace PT;
+
+Test test_a3_aov_parse("a3.aov.parse", []() {
+	auto expect = [](std::string const &list, uint32_t mask) {
+		uint32_t got = AOV::parse(list);
+		if (got != mask) {
+			throw Test::error("Parsing '" + list + "' gave mask " + std::to_string(got) + ", expected " + std::to_string(mask) + ".");
+		}
+	};
+	expect("", 0);
+	expect("depth", AOV::Depth);
+	expect("normal,albedo", AOV::Normal | AOV::Albedo);
+	expect("indirect,,direct,", AOV::Direct | AOV::Indirect);
+	expect("samples,depth,samples", AOV::Samples | AOV::Depth);
+	expect("all", AOV::All);
+	expect("depth,all", AOV::All);
+
+	for (std::string bad : {"Depth", "depth,normals", " depth", "everything"}) {
+		bool threw = false;
+		try {
+			AOV::parse(bad);
+		} catch (std::runtime_error const &) {
+			threw = true;
+		}
+		if (!threw) throw Test::error("Parsing '" + bad + "' didn't throw.");
+	}
+
+	//to_string lists channels in a fixed order, and parses back to the same mask:
+	if (AOV::to_string(AOV::Albedo | AOV::Depth) != "depth,albedo") {
+		throw Test::error("Mask of albedo and depth printed as '" + AOV::to_string(AOV::Albedo | AOV::Depth) + "'.");
+	}
+	for (uint32_t mask = 0; mask <= AOV::All; ++mask) {
+		if (AOV::parse(AOV::to_string(mask)) != mask) {
+			throw Test::error("Mask " + std::to_string(mask) + " printed as '" + AOV::to_string(mask) + "', which doesn't parse back.");
+		}
+	}
+});
+
+Test test_a3_aov_layout("a3.aov.layout", []() {
+	//every combination of channels gets a dense, non-overlapping layout in a fixed order:
+	for (uint32_t mask = 0; mask <= AOV::All; ++mask) {
+		AOV_Layout layout(mask);
+		if (layout.mask != (mask & ~uint32_t(AOV::Samples))) {
+			throw Test::error("Layout of mask " + std::to_string(mask) + " has mask " + std::to_string(layout.mask) + ".");
+		}
+		uint32_t stride = 0;
+		auto check = [&](AOV::Channel channel, uint32_t offset, uint32_t size) {
+			if (!(mask & channel)) return;
+			if (offset != stride) {
+				throw Test::error("Layout of '" + AOV::to_string(mask) + "' puts '" + AOV::to_string(channel) + "' at " + std::to_string(offset) + ", expected " + std::to_string(stride) + ".");
+			}
+			stride += size;
+		};
+		check(AOV::Depth, layout.depth, 1);
+		check(AOV::Normal, layout.normal, 3);
+		check(AOV::Albedo, layout.albedo, 3);
+		check(AOV::Direct, layout.direct, 3);
+		check(AOV::Indirect, layout.indirect, 3);
+		if (layout.stride != stride) {
+			throw Test::error("Layout of '" + AOV::to_string(mask) + "' has stride " + std::to_string(layout.stride) + ", expected " + std::to_string(stride) + ".");
+		}
+	}
+
+	//add() writes each channel to its own place (and divides light by pdf):
+	AOV_Layout layout(AOV::Depth | AOV::Albedo | AOV::Indirect | AOV::Samples);
+	Sample_AOVs sample;
+	sample.depth = 2.0f;
+	sample.normal = Vec3(1.0f, 0.0f, 0.0f);
+	sample.albedo = Spectrum(0.1f, 0.2f, 0.3f);
+	sample.direct = Spectrum(5.0f);
+	sample.indirect = Spectrum(1.0f, 2.0f, 3.0f);
+	std::vector< float > sums(layout.stride, 0.0f);
+	layout.add(sums.data(), sample, 0.5f);
+	layout.add(sums.data(), sample, 0.5f);
+	std::vector< float > expected{4.0f, 0.2f, 0.4f, 0.6f, 4.0f, 8.0f, 12.0f};
+	for (uint32_t i = 0; i < expected.size(); ++i) {
+		if (Test::differs(sums.at(i), expected[i])) {
+			throw Test::error("Sum " + std::to_string(i) + " is " + std::to_string(sums[i]) + ", expected " + std::to_string(expected[i]) + ".");
+		}
+	}
+
+	//invalid light (e.g., from a zero pdf) is skipped:
+	sample.indirect = Spectrum(1.0f);
+	layout.add(sums.data(), sample, 0.0f);
+	if (Test::differs(sums[4], 4.0f)) throw Test::error("Invalid indirect light was accumulated.");
+});
@@ -0,0 +1,186 @@
+#include "test.h"
+#include "pathtracer/pathtracer.h"
+#include "scene/env_light.h"
+#include "util/rand.h"
+
+#include <chrono>
+#include <cstring>
+#include <thread>
+
+using namespace PT;
+
+//-------------------------------------------------
+//Pathtracers sharing a thread pool: batches, and cancelling one render while others run.
+
+//a scene lit only by a noisy environment map, so every direction (and so every camera) sees something different:
+static void sky_scene(Scene &scene) {
+	HDR_Image image(32, 16);
+	RNG rng(23);
+	for (uint32_t i = 0; i < image.w * image.h; ++i) {
+		image.at(i) = Spectrum(rng.unit(), rng.unit(), rng.unit());
+	}
+	auto texture = std::make_shared<Texture>(Texture{Textures::Image{Textures::Image::Sampler::bilinear, image}});
+	scene.textures.emplace("sky", texture);
+	Environment_Lights::Sphere sphere;
+	sphere.radiance = texture;
+	scene.env_lights.emplace("sky", std::make_shared<Environment_Light>(Environment_Light{sphere}));
+}
+
+static std::shared_ptr<Instance::Camera> add_camera(Scene &scene, std::string const &name, Vec3 euler, uint32_t size, uint32_t samples) {
+	auto camera = std::make_shared<Camera>();
+	camera->aspect_ratio = 1.0f;
+	camera->film.width = camera->film.height = size;
+	camera->film.samples = samples;
+	camera->film.max_ray_depth = 1;
+	auto transform = std::make_shared<Transform>(Vec3{0.0f}, euler, Vec3{1.0f});
+	scene.cameras.emplace(name, camera);
+	scene.transforms.emplace(name, transform);
+	auto instance = std::make_shared<Instance::Camera>();
+	instance->camera = camera;
+	instance->transform = transform;
+	scene.instances.cameras.emplace(name, instance);
+	return instance;
+}
+
+//collects what a render reports:
+struct Reports {
+	std::mutex mut;
+	uint32_t count = 0;
+	bool finished = false;
+	HDR_Image final;
+
+	std::function<void(Pathtracer::Render_Report &&)> callback() {
+		return [this](Pathtracer::Render_Report &&report) {
+			std::lock_guard<std::mutex> lock(mut);
+			count += 1;
+			if (report.first == 1.0f) {
+				finished = true;
+				final = std::move(report.second);
+			}
+		};
+	}
+	uint32_t reports() {
+		std::lock_guard<std::mutex> lock(mut);
+		return count;
+	}
+};
+
+static void wait_for(Pathtracer &pathtracer) {
+	while (pathtracer.in_progress()) std::this_thread::sleep_for(std::chrono::milliseconds(5));
+}
+
+static void expect_same(HDR_Image const &a, HDR_Image const &b, std::string const &what) {
+	if (a.w != b.w || a.h != b.h) {
+		throw Test::error(what + ": images are " + std::to_string(a.w) + "x" + std::to_string(a.h) + " and " + std::to_string(b.w) + "x" + std::to_string(b.h) + ".");
+	}
+	for (uint32_t i = 0; i < a.w * a.h; ++i) {
+		if (std::memcmp(&a.at(i), &b.at(i), sizeof(Spectrum)) != 0) {
+			throw Test::error(what + ": pixel " + std::to_string(i) + " differs.");
+		}
+	}
+}
+
+//(tests set the fixed seed, and put it back when done)
+struct Fixed_Seed {
+	explicit Fixed_Seed(uint32_t seed) : old(RNG::fixed_seed) { RNG::fixed_seed = seed; }
+	~Fixed_Seed() { RNG::fixed_seed = old; }
+	uint32_t old;
+};
+
+Test test_a3_batch_matches_separate("a3.batch.matches_separate", []() {
+	Fixed_Seed seed(0x1234);
+	Scene scene;
+	sky_scene(scene);
+	std::shared_ptr<Instance::Camera> cameras[] = {
+		add_camera(scene, "front", Vec3{0.0f, 0.0f, 0.0f}, 24, 8),
+		add_camera(scene, "side", Vec3{0.0f, 90.0f, 0.0f}, 24, 8),
+		add_camera(scene, "up", Vec3{90.0f, 0.0f, 0.0f}, 24, 8),
+	};
+	Thread_Pool pool(4);
+	auto session = std::make_shared<Render_Session const>(scene, true, &pool);
+
+	//each camera on its own:
+	std::vector< HDR_Image > separate;
+	for (auto &camera : cameras) {
+		Pathtracer pathtracer(pool);
+		Reports reports;
+		bool quit = false;
+		pathtracer.render(session, camera, reports.callback(), &quit);
+		wait_for(pathtracer);
+		if (!reports.finished) throw Test::error("Separate render didn't finish.");
+		separate.emplace_back(std::move(reports.final));
+	}
+	//(otherwise a batch that mixed up its cameras would pass)
+	for (uint32_t i = 1; i < separate.size(); ++i) {
+		bool differs = false;
+		for (uint32_t p = 0; p < separate[0].w * separate[0].h; ++p) {
+			if (separate[0].at(p) != separate[i].at(p)) differs = true;
+		}
+		if (!differs) throw Test::error("Cameras " + std::to_string(0) + " and " + std::to_string(i) + " see the same image.");
+	}
+
+	//all cameras at once:
+	std::vector< std::unique_ptr< Pathtracer > > pathtracers;
+	std::vector< Reports > reports(std::size(cameras));
+	bool quit[std::size(cameras)] = {};
+	std::vector< Pathtracer::Batch_Item > items;
+	for (uint32_t i = 0; i < std::size(cameras); ++i) {
+		pathtracers.emplace_back(std::make_unique< Pathtracer >(pool));
+		items.emplace_back(Pathtracer::Batch_Item{pathtracers.back().get(), cameras[i], reports[i].callback(), &quit[i]});
+	}
+	Pathtracer::render_batch(session, std::move(items));
+	for (uint32_t i = 0; i < std::size(cameras); ++i) {
+		wait_for(*pathtracers[i]);
+		if (!reports[i].finished) throw Test::error("Batched render " + std::to_string(i) + " didn't finish.");
+		expect_same(reports[i].final, separate[i], "Batched render " + std::to_string(i) + " vs. separate render");
+	}
+});
+
+Test test_a3_batch_cancel("a3.batch.cancel", []() {
+	Fixed_Seed seed(0x5678);
+	Scene scene;
+	sky_scene(scene);
+	//(a long render to cancel, and a short one that should finish regardless)
+	auto long_camera = add_camera(scene, "long", Vec3{0.0f, 0.0f, 0.0f}, 128, 512);
+	auto short_camera = add_camera(scene, "short", Vec3{0.0f, 45.0f, 0.0f}, 32, 16);
+	Thread_Pool pool(2);
+	auto session = std::make_shared<Render_Session const>(scene, true, &pool);
+
+	HDR_Image expected;
+	{
+		Pathtracer pathtracer(pool);
+		Reports reports;
+		bool quit = false;
+		pathtracer.render(session, short_camera, reports.callback(), &quit);
+		wait_for(pathtracer);
+		expected = std::move(reports.final);
+	}
+
+	Reports long_reports, short_reports;
+	bool long_quit = false, short_quit = false;
+	auto long_pathtracer = std::make_unique< Pathtracer >(pool);
+	Pathtracer short_pathtracer(pool);
+	std::vector< Pathtracer::Batch_Item > items;
+	items.emplace_back(Pathtracer::Batch_Item{long_pathtracer.get(), long_camera, long_reports.callback(), &long_quit});
+	items.emplace_back(Pathtracer::Batch_Item{&short_pathtracer, short_camera, short_reports.callback(), &short_quit});
+	Pathtracer::render_batch(session, std::move(items));
+
+	//cancel the long render (by destroying its Pathtracer) once it has started:
+	while (long_reports.reports() == 0) std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	long_pathtracer.reset();
+
+	//...which must have waited for its tiles: none of them report afterward,
+	uint32_t reported = long_reports.reports();
+	wait_for(short_pathtracer);
+	std::this_thread::sleep_for(std::chrono::milliseconds(20));
+	if (long_reports.reports() != reported) {
+		throw Test::error("Cancelled render reported " + std::to_string(long_reports.reports() - reported) + " more tiles after it was cancelled.");
+	}
+	if (long_reports.finished) {
+		throw Test::error("Long render finished before it was cancelled, so cancelling wasn't tested.");
+	}
+
+	//...while the other render's tiles kept running to the same result as on its own:
+	if (!short_reports.finished) throw Test::error("Render sharing the pool didn't finish after the other was cancelled.");
+	expect_same(short_reports.final, expected, "Render sharing the pool with a cancelled one vs. alone");
+});
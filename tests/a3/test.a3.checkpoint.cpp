@@ -0,0 +1,206 @@
+#include "test.h"
+#include "pathtracer/pathtracer.h"
+#include "util/rand.h"
+
+#include <filesystem>
+#include <fstream>
+
+using namespace PT;
+using Checkpoint = Pathtracer::Checkpoint;
+
+//a 6x4 film split into four 3x2 tiles of 2 samples each, with random sums in every pixel:
+static Checkpoint test_checkpoint(uint32_t aov_mask) {
+	Checkpoint checkpoint;
+	checkpoint.width = 6;
+	checkpoint.height = 4;
+	checkpoint.samples = 2;
+	checkpoint.max_ray_depth = 5;
+	checkpoint.plan = Pathtracer::Tile_Plan{3, 2, 2, 4, 4, 0};
+	for (uint32_t i = 0; i < 4; ++i) {
+		Pathtracer::Tile tile;
+		tile.seed = 1000 + i;
+		tile.x_begin = (i % 2) * 3;
+		tile.x_end = tile.x_begin + 3;
+		tile.y_begin = (i / 2) * 2;
+		tile.y_end = tile.y_begin + 2;
+		tile.s_begin = 0;
+		tile.s_end = 2;
+		tile.index = i;
+		checkpoint.tiles.emplace_back(tile);
+		checkpoint.done.emplace_back(uint8_t(i % 2));
+	}
+	RNG rng(5);
+	uint32_t pixels = checkpoint.width * checkpoint.height;
+	for (uint32_t i = 0; i < pixels; ++i) {
+		//(includes negative and > 32-bit values, which must survive byte order conversion)
+		checkpoint.accumulator.push_back({int64_t(rng.integer(0, 1u << 30)) << 10, -int64_t(rng.integer(0, 1000)), int64_t(i)});
+		checkpoint.accumulator_samples.push_back(rng.integer(0, 3));
+	}
+	checkpoint.aov_mask = aov_mask;
+	uint32_t stride = AOV_Layout(aov_mask).stride;
+	for (uint32_t i = 0; i < pixels * stride; ++i) {
+		checkpoint.aov_accumulator.push_back(int64_t(rng.integer(0, 1u << 20)) - (1 << 19));
+	}
+	if (stride) checkpoint.aov_samples = checkpoint.accumulator_samples;
+	return checkpoint;
+}
+
+static void check_same(Checkpoint const &a, Checkpoint const &b) {
+	if (a.width != b.width || a.height != b.height || a.samples != b.samples || a.max_ray_depth != b.max_ray_depth) {
+		throw Test::error("Loaded checkpoint has a different film.");
+	}
+	if (a.plan.tile_width != b.plan.tile_width || a.plan.tile_height != b.plan.tile_height || a.plan.tile_samples != b.plan.tile_samples
+	 || a.plan.threads != b.plan.threads || a.plan.tiles != b.plan.tiles || a.plan.split_tiles != b.plan.split_tiles) {
+		throw Test::error("Loaded checkpoint has a different tile plan.");
+	}
+	if (a.tiles.size() != b.tiles.size()) throw Test::error("Loaded checkpoint has a different number of tiles.");
+	for (uint32_t i = 0; i < a.tiles.size(); ++i) {
+		Pathtracer::Tile const &s = a.tiles[i];
+		Pathtracer::Tile const &t = b.tiles[i];
+		if (s.seed != t.seed || s.x_begin != t.x_begin || s.x_end != t.x_end || s.y_begin != t.y_begin
+		 || s.y_end != t.y_end || s.s_begin != t.s_begin || s.s_end != t.s_end || s.index != t.index) {
+			throw Test::error("Loaded checkpoint has a different tile " + std::to_string(i) + ".");
+		}
+	}
+	if (a.done != b.done) throw Test::error("Loaded checkpoint has different tiles done.");
+	if (a.accumulator != b.accumulator) throw Test::error("Loaded checkpoint has a different accumulator.");
+	if (a.accumulator_samples != b.accumulator_samples) throw Test::error("Loaded checkpoint has different sample counts.");
+	if (a.aov_mask != b.aov_mask) throw Test::error("Loaded checkpoint has a different AOV mask.");
+	if (a.aov_accumulator != b.aov_accumulator) throw Test::error("Loaded checkpoint has a different AOV accumulator.");
+	if (a.aov_samples != b.aov_samples) throw Test::error("Loaded checkpoint has different AOV sample counts.");
+}
+
+static std::string test_file(std::string const &name) {
+	return (std::filesystem::temp_directory_path() / ("s3d-test-" + name + ".s3ck")).string();
+}
+
+static std::vector< char > read_bytes(std::string const &filename) {
+	std::ifstream in(filename, std::ios::binary);
+	return std::vector< char >(std::istreambuf_iterator< char >(in), std::istreambuf_iterator< char >());
+}
+
+static void write_bytes(std::string const &filename, std::vector< char > const &bytes) {
+	std::ofstream out(filename, std::ios::binary);
+	out.write(bytes.data(), bytes.size());
+}
+
+static bool load_throws(std::string const &filename) {
+	try {
+		Checkpoint::load(filename);
+	} catch (std::runtime_error const &) {
+		return true;
+	}
+	return false;
+}
+
+Test test_a3_checkpoint_round_trip("a3.checkpoint.round_trip", []() {
+	std::string file = test_file("round-trip");
+	for (uint32_t mask : {0u, uint32_t(AOV::Albedo | AOV::Normal), uint32_t(AOV::All)}) {
+		Checkpoint checkpoint = test_checkpoint(mask);
+		checkpoint.save(file);
+		check_same(checkpoint, Checkpoint::load(file));
+	}
+
+	//fields are stored little-endian, whatever the machine:
+	Checkpoint checkpoint = test_checkpoint(0);
+	checkpoint.save(file);
+	std::vector< char > bytes = read_bytes(file);
+	if (bytes.size() < 12 || std::string(bytes.data(), 4) != "s3ck" || bytes[4] != 6 || bytes[5] != 0 || bytes[8] != 4 || bytes[9] != 0) {
+		throw Test::error("Checkpoint does not start with magic number and little-endian width and height.");
+	}
+	std::filesystem::remove(file);
+});
+
+Test test_a3_checkpoint_reject("a3.checkpoint.reject", []() {
+	std::string file = test_file("reject");
+	test_checkpoint(AOV::Depth).save(file);
+	std::vector< char > bytes = read_bytes(file);
+
+	//truncations are caught wherever they fall (not just between fields):
+	// (except right before the optional AOV block, which is a valid checkpoint without AOVs)
+	size_t without_aovs = bytes.size() - (4 + 6 * 4 * (8 + 4));
+	for (size_t size = 0; size < bytes.size(); ++size) {
+		if (size == without_aovs) continue;
+		write_bytes(file, std::vector< char >(bytes.begin(), bytes.begin() + size));
+		if (!load_throws(file)) {
+			throw Test::error("Loaded checkpoint truncated to " + std::to_string(size) + " of " + std::to_string(bytes.size()) + " bytes.");
+		}
+	}
+
+	auto corrupt = [&](std::string const &what, size_t at, char value) {
+		std::vector< char > copy = bytes;
+		copy.at(at) = value;
+		write_bytes(file, copy);
+		if (!load_throws(file)) throw Test::error("Loaded checkpoint with " + what + ".");
+	};
+	corrupt("a bad magic number", 0, 'x');
+	corrupt("a huge width", 4 + 3, char(0x7f));
+	corrupt("a huge tile count", 4 + 4 * 4 + 3, char(0x7f));
+	//(first tile's x_end, after the header and plan)
+	corrupt("a tile outside the film", 4 + 5 * 4 + 6 * 4 + 2 * 4, char(50));
+
+	write_bytes(file, std::vector< char >(bytes.begin(), bytes.begin() + without_aovs));
+	if (Checkpoint::load(file).aov_mask != 0) throw Test::error("Checkpoint cut before its AOVs still has AOVs.");
+
+	std::vector< char > trailing = bytes;
+	trailing.push_back(0);
+	write_bytes(file, trailing);
+	if (!load_throws(file)) throw Test::error("Loaded checkpoint with trailing data.");
+
+	std::filesystem::remove(file);
+	if (!load_throws(file)) throw Test::error("Loaded checkpoint that does not exist.");
+});
+
+Test test_a3_checkpoint_merge("a3.checkpoint.merge", []() {
+	//two shards of one render, each with the tiles the other is missing:
+	Checkpoint a = test_checkpoint(AOV::Albedo);
+	Checkpoint b = test_checkpoint(AOV::Albedo);
+	for (uint32_t i = 0; i < b.done.size(); ++i) b.done[i] = !a.done[i];
+
+	Checkpoint merged = a;
+	merged.merge(b);
+	if (merged.tiles_done() != uint32_t(merged.tiles.size())) {
+		throw Test::error("Merged checkpoint has " + std::to_string(merged.tiles_done()) + " of " + std::to_string(merged.tiles.size()) + " tiles done.");
+	}
+	for (size_t i = 0; i < merged.accumulator.size(); ++i) {
+		for (uint32_t c = 0; c < 3; ++c) {
+			if (merged.accumulator[i][c] != a.accumulator[i][c] + b.accumulator[i][c]) {
+				throw Test::error("Merged accumulator is not the sum of the shards' accumulators.");
+			}
+		}
+		if (merged.accumulator_samples[i] != a.accumulator_samples[i] + b.accumulator_samples[i]) {
+			throw Test::error("Merged sample counts are not the sum of the shards' sample counts.");
+		}
+		if (merged.aov_samples[i] != a.aov_samples[i] + b.aov_samples[i]) {
+			throw Test::error("Merged AOV sample counts are not the sum of the shards' sample counts.");
+		}
+	}
+	for (size_t i = 0; i < merged.aov_accumulator.size(); ++i) {
+		if (merged.aov_accumulator[i] != a.aov_accumulator[i] + b.aov_accumulator[i]) {
+			throw Test::error("Merged AOV accumulator is not the sum of the shards' accumulators.");
+		}
+	}
+
+	auto merge_throws = [](Checkpoint into, Checkpoint const &other) {
+		try {
+			into.merge(other);
+		} catch (std::runtime_error const &) {
+			return true;
+		}
+		return false;
+	};
+	if (!merge_throws(merged, b)) throw Test::error("Merged checkpoints that both contain the same tiles.");
+	Checkpoint overlap = b;
+	overlap.done[1] = 1; //(also done in a)
+	if (!merge_throws(a, overlap)) throw Test::error("Merged checkpoints that both contain tile 1.");
+
+	Checkpoint reseeded = b;
+	reseeded.tiles[2].seed += 1;
+	if (!merge_throws(a, reseeded)) throw Test::error("Merged checkpoints with different tile seeds.");
+	Checkpoint resized = b;
+	resized.samples = 4;
+	if (!merge_throws(a, resized)) throw Test::error("Merged checkpoints of different films.");
+	Checkpoint other_aovs = test_checkpoint(AOV::Normal);
+	for (uint32_t i = 0; i < other_aovs.done.size(); ++i) other_aovs.done[i] = !a.done[i];
+	if (!merge_throws(a, other_aovs)) throw Test::error("Merged checkpoints that record different AOVs.");
+});
@@ -0,0 +1,184 @@
+#include "test.h"
+#include "pathtracer/denoiser.h"
+#include "util/rand.h"
+#include "util/thread_pool.h"
+
+#include <chrono>
+#include <cstring>
+
+using namespace PT;
+
+//guide images for a w x h film where every pixel hits a surface facing the camera at distance 2:
+struct Guides {
+	Guides(uint32_t w, uint32_t h)
+		: albedo(w, h, Spectrum(0.5f)), normal(w, h, Spectrum(0.0f, 0.0f, 1.0f)), depth(w, h, Spectrum(2.0f, 0.0f, 0.0f)) {
+	}
+	HDR_Image albedo, normal, depth;
+};
+
+static HDR_Image noisy_image(uint32_t w, uint32_t h, uint32_t seed) {
+	HDR_Image image(w, h);
+	RNG rng(seed);
+	for (uint32_t i = 0; i < w * h; ++i) {
+		image.at(i) = Spectrum(rng.unit(), rng.unit(), rng.unit()) * 4.0f;
+	}
+	return image;
+}
+
+static void expect_close(HDR_Image const &got, HDR_Image const &expected, float tolerance, std::string const &what) {
+	for (uint32_t y = 0; y < got.h; ++y) {
+		for (uint32_t x = 0; x < got.w; ++x) {
+			Spectrum g = got.at(x, y), e = expected.at(x, y);
+			float error = std::max({std::abs(g.r - e.r), std::abs(g.g - e.g), std::abs(g.b - e.b)});
+			if (!(error <= tolerance * std::max(1.0f, e.luma()))) {
+				throw Test::error(what + ": pixel (" + std::to_string(x) + ", " + std::to_string(y) + ") is " + std::to_string(g.r) + ", " + std::to_string(g.g) + ", " + std::to_string(g.b) + ", expected " + std::to_string(e.r) + ", " + std::to_string(e.g) + ", " + std::to_string(e.b) + ".");
+			}
+		}
+	}
+}
+
+Test test_a3_denoiser_constant("a3.denoiser.constant", []() {
+	Guides guides(37, 23);
+	HDR_Image color(37, 23, Spectrum(0.25f, 1.5f, 3.0f));
+	Denoiser denoiser;
+	HDR_Image result = denoiser.denoise(color, guides.albedo, guides.normal, guides.depth);
+	expect_close(result, color, 1e-5f, "Constant image");
+});
+
+Test test_a3_denoiser_hit_miss("a3.denoiser.hit_miss", []() {
+	//left half hits the scene, right half misses (all-zero guides):
+	uint32_t w = 32, h = 16;
+	Guides guides(w, h);
+	HDR_Image color(w, h);
+	for (uint32_t y = 0; y < h; ++y) {
+		for (uint32_t x = 0; x < w; ++x) {
+			if (x < w / 2) {
+				color.at(x, y) = Spectrum(0.25f);
+			} else {
+				//(same luma as the hits once they're divided by albedo, so only the hit/miss test keeps them apart)
+				color.at(x, y) = Spectrum(1.0f, (0.5f - 0.2126f - 0.0722f) / 0.7152f, 1.0f);
+				guides.albedo.at(x, y) = guides.normal.at(x, y) = guides.depth.at(x, y) = Spectrum(0.0f);
+			}
+		}
+	}
+	Denoiser denoiser;
+	HDR_Image result = denoiser.denoise(color, guides.albedo, guides.normal, guides.depth);
+	//(each side is constant on its own, so any mixing across the boundary shows up)
+	expect_close(result, color, 1e-5f, "Hit/miss boundary");
+});
+
+Test test_a3_denoiser_edges("a3.denoiser.edges", []() {
+	uint32_t w = 32, h = 16;
+	Denoiser denoiser;
+
+	//a crease: left half faces +x, right half faces +z:
+	{
+		Guides guides(w, h);
+		HDR_Image color(w, h);
+		for (uint32_t y = 0; y < h; ++y) {
+			for (uint32_t x = 0; x < w; ++x) {
+				bool left = x < w / 2;
+				color.at(x, y) = Spectrum(left ? 0.2f : 0.8f);
+				if (left) guides.normal.at(x, y) = Spectrum(1.0f, 0.0f, 0.0f);
+			}
+		}
+		HDR_Image result = denoiser.denoise(color, guides.albedo, guides.normal, guides.depth);
+		expect_close(result, color, 1e-3f, "Normal discontinuity");
+	}
+
+	//an occlusion edge: left half is ten times closer than the right half:
+	{
+		Guides guides(w, h);
+		HDR_Image color(w, h);
+		for (uint32_t y = 0; y < h; ++y) {
+			for (uint32_t x = 0; x < w; ++x) {
+				bool left = x < w / 2;
+				color.at(x, y) = Spectrum(left ? 0.2f : 0.8f);
+				guides.depth.at(x, y) = Spectrum(left ? 1.0f : 10.0f, 0.0f, 0.0f);
+			}
+		}
+		HDR_Image result = denoiser.denoise(color, guides.albedo, guides.normal, guides.depth);
+		expect_close(result, color, 1e-3f, "Depth discontinuity");
+	}
+
+	//...while without either edge, the same step is blurred:
+	{
+		Guides guides(w, h);
+		HDR_Image color(w, h);
+		for (uint32_t y = 0; y < h; ++y) {
+			for (uint32_t x = 0; x < w; ++x) {
+				color.at(x, y) = Spectrum(x < w / 2 ? 0.2f : 0.8f);
+			}
+		}
+		HDR_Image result = denoiser.denoise(color, guides.albedo, guides.normal, guides.depth);
+		float left = result.at(w / 2 - 1, h / 2).r, right = result.at(w / 2, h / 2).r;
+		if (!(left > 0.21f && right < 0.79f)) {
+			throw Test::error("Step with no guide edge stayed sharp (" + std::to_string(left) + " | " + std::to_string(right) + "), so the edge checks prove nothing.");
+		}
+	}
+});
+
+Test test_a3_denoiser_albedo("a3.denoiser.albedo", []() {
+	//a checkerboard texture under constant lighting demodulates to a constant, so it comes back exactly:
+	uint32_t w = 24, h = 20;
+	Guides guides(w, h);
+	HDR_Image color(w, h);
+	Spectrum light(2.0f, 1.5f, 1.0f);
+	for (uint32_t y = 0; y < h; ++y) {
+		for (uint32_t x = 0; x < w; ++x) {
+			Spectrum albedo = ((x / 2 + y / 2) % 2) ? Spectrum(0.9f, 0.1f, 0.4f) : Spectrum(0.05f, 0.6f, 0.3f);
+			guides.albedo.at(x, y) = albedo;
+			color.at(x, y) = albedo * light;
+		}
+	}
+	//(including some black-albedo pixels, which are filtered undivided)
+	for (uint32_t x = 0; x < w; ++x) {
+		guides.albedo.at(x, 0) = Spectrum(0.0f);
+		color.at(x, 0) = light;
+	}
+	Denoiser denoiser;
+	HDR_Image result = denoiser.denoise(color, guides.albedo, guides.normal, guides.depth);
+	expect_close(result, color, 1e-4f, "Albedo demodulation");
+});
+
+Test test_a3_denoiser_threads("a3.denoiser.threads", []() {
+	//bands split the rows between the pool's threads, but every pixel is filtered the same way:
+	uint32_t w = 41, h = 29;
+	Guides guides(w, h);
+	RNG rng(11);
+	for (uint32_t i = 0; i < w * h; ++i) {
+		guides.depth.at(i).r = 1.0f + rng.unit();
+		guides.albedo.at(i) = Spectrum(rng.unit(), rng.unit(), rng.unit());
+		if (rng.coin_flip(0.1f)) guides.normal.at(i) = Spectrum(0.0f);
+	}
+	HDR_Image color = noisy_image(w, h, 5);
+
+	Denoiser denoiser;
+	Thread_Pool pool(4);
+	HDR_Image a = denoiser.denoise(color, guides.albedo, guides.normal, guides.depth);
+	HDR_Image b = denoiser.denoise(color, guides.albedo, guides.normal, guides.depth, &pool);
+	for (uint32_t i = 0; i < w * h; ++i) {
+		if (std::memcmp(&a.at(i), &b.at(i), sizeof(Spectrum)) != 0) {
+			throw Test::error("Pixel " + std::to_string(i) + " differs between one thread and a pool of 4.");
+		}
+	}
+
+	//renders denoise on their pool's workers, so denoising from every worker at once must still finish:
+	// (as when renders sharing a pool all finish together)
+	Thread_Pool shared(2);
+	std::vector< std::future< HDR_Image > > results;
+	for (uint32_t i = 0; i < shared.size(); ++i) {
+		results.emplace_back(shared.enqueue([&]() {
+			return denoiser.denoise(color, guides.albedo, guides.normal, guides.depth, &shared);
+		}));
+	}
+	for (auto &result : results) {
+		if (result.wait_for(std::chrono::seconds(30)) != std::future_status::ready) {
+			throw Test::error("Denoising from every worker of a pool didn't finish.");
+		}
+		HDR_Image c = result.get();
+		if (std::memcmp(&a.at(0), &c.at(0), sizeof(Spectrum) * w * h) != 0) {
+			throw Test::error("Denoising from a pool's worker gave a different image.");
+		}
+	}
+});
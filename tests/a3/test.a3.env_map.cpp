@@ -0,0 +1,183 @@
+#include "test.h"
+#include "pathtracer/env_map.h"
+#include "pathtracer/samplers.h"
+#include "scene/env_light.h"
+#include "scene/shape.h"
+#include "util/rand.h"
+
+#include <cmath>
+
+//a small image light with a bright spot, so importance sampling has something to find:
+static std::shared_ptr<Texture> test_texture(Textures::Image::Sampler sampler) {
+	HDR_Image image(12, 6);
+	RNG rng(3);
+	for (uint32_t y = 0; y < image.h; ++y) {
+		for (uint32_t x = 0; x < image.w; ++x) {
+			image.at(x, y) = Spectrum(rng.unit(), rng.unit(), rng.unit());
+		}
+	}
+	image.at(7, 4) = Spectrum(20.0f, 15.0f, 10.0f);
+	return std::make_shared<Texture>(Texture{Textures::Image{sampler, image, Textures::Image::Storage::rows}});
+}
+
+static Environment_Light sphere_light(std::shared_ptr<Texture> const &texture) {
+	Environment_Lights::Sphere sphere;
+	sphere.radiance = texture;
+	return Environment_Light{sphere};
+}
+
+static Vec3 random_dir(RNG &rng) {
+	Vec3 dir;
+	do {
+		dir = Vec3(rng.unit() * 2.0f - 1.0f, rng.unit() * 2.0f - 1.0f, rng.unit() * 2.0f - 1.0f);
+	} while (dir.norm_squared() > 1.0f || dir.norm_squared() < 1e-4f);
+	return dir.unit();
+}
+
+Test test_a3_env_map_alias_table("a3.env_map.alias_table", []() {
+	std::vector<float> weights{0.0f, 1.0f, 2.0f, 3.0f, 0.0f, 4.0f};
+	Samplers::Alias_Table table(weights);
+	if (table.size() != weights.size()) {
+		throw Test::error("Alias table has " + std::to_string(table.size()) + " entries for " + std::to_string(weights.size()) + " weights.");
+	}
+	for (uint32_t i = 0; i < weights.size(); ++i) {
+		if (Test::differs(table.probability(i), weights[i] / 10.0f)) {
+			throw Test::error("Index " + std::to_string(i) + " has probability " + std::to_string(table.probability(i)) + ", expected " + std::to_string(weights[i] / 10.0f) + ".");
+		}
+	}
+
+	RNG rng(7);
+	constexpr uint32_t N = 200000;
+	std::vector<uint32_t> counts(weights.size(), 0);
+	for (uint32_t n = 0; n < N; ++n) {
+		uint32_t i = table.sample(rng);
+		if (i >= weights.size()) throw Test::error("Alias table sampled out-of-range index " + std::to_string(i) + ".");
+		counts[i] += 1;
+	}
+	for (uint32_t i = 0; i < weights.size(); ++i) {
+		if (weights[i] == 0.0f && counts[i] != 0) {
+			throw Test::error("Index " + std::to_string(i) + " has zero weight but was sampled.");
+		}
+		float frequency = counts[i] / float(N);
+		if (std::abs(frequency - table.probability(i)) > 0.01f) {
+			throw Test::error("Index " + std::to_string(i) + " was sampled with frequency " + std::to_string(frequency) + ", expected " + std::to_string(table.probability(i)) + ".");
+		}
+	}
+
+	Samplers::Alias_Table zeros(std::vector<float>(4, 0.0f));
+	for (uint32_t i = 0; i < 4; ++i) {
+		if (Test::differs(zeros.probability(i), 0.25f)) {
+			throw Test::error("All-zero weights should give uniform probabilities.");
+		}
+	}
+});
+
+Test test_a3_env_map_layout("a3.env_map.layout", []() {
+	auto texture = test_texture(Textures::Image::Sampler::bilinear);
+	Environment_Light light = sphere_light(texture);
+	PT::Environment_Map map(std::vector<Environment_Light const *>{&light});
+
+	if (map.w != 12 || map.h != 6) {
+		throw Test::error("Map is " + std::to_string(map.w) + "x" + std::to_string(map.h) + ", expected the light's 12x6.");
+	}
+
+	//the map is laid out like Shapes::Sphere::uv -- texel centers map back to their own texels:
+	for (uint32_t y = 0; y < map.h; ++y) {
+		for (uint32_t x = 0; x < map.w; ++x) {
+			float theta = PI_F * (y + 0.5f) / map.h;
+			float phi = 2.0f * PI_F * (x + 0.5f) / map.w;
+			Vec3 dir(std::sin(theta) * std::cos(phi), -std::cos(theta), std::sin(theta) * std::sin(phi));
+			Vec2 uv = Shapes::Sphere::uv(dir);
+			if (uint32_t(uv.x * map.w) != x || uint32_t(uv.y * map.h) != y) {
+				throw Test::error("Center of texel (" + std::to_string(x) + ", " + std::to_string(y) + ") has uv " + to_string(uv) + ", which is outside that texel.");
+			}
+		}
+	}
+
+	//...and evaluates like the light it came from, everywhere (including between texel centers):
+	RNG rng(11);
+	for (uint32_t n = 0; n < 1000; ++n) {
+		Vec3 dir = random_dir(rng);
+		if (Test::differs(map.evaluate(dir), light.evaluate(dir))) {
+			throw Test::error("Map evaluates " + to_string(map.evaluate(dir)) + " in direction " + to_string(dir) + ", but the light evaluates " + to_string(light.evaluate(dir)) + ".");
+		}
+	}
+});
+
+Test test_a3_env_map_pdf("a3.env_map.pdf", []() {
+	auto texture = test_texture(Textures::Image::Sampler::nearest);
+	Environment_Light light = sphere_light(texture);
+	PT::Environment_Map map(std::vector<Environment_Light const *>{&light});
+
+	//pdf of a direction is the probability of its texel, spread over the texel's solid angle:
+	RNG rng(13);
+	for (uint32_t n = 0; n < 1000; ++n) {
+		Vec3 dir = map.sample(rng);
+		if (!dir.valid() || Test::differs(dir.norm(), 1.0f)) {
+			throw Test::error("Map sampled invalid direction " + to_string(dir) + ".");
+		}
+		Vec2 uv = Shapes::Sphere::uv(dir);
+		uint32_t x = std::min(uint32_t(uv.x * map.w), map.w - 1);
+		uint32_t y = std::min(uint32_t(uv.y * map.h), map.h - 1);
+		float sin_theta = std::sqrt(dir.x * dir.x + dir.z * dir.z);
+		float expected = map.cells.probability(y * map.w + x) * float(map.w * map.h) / (2.0f * PI_F * PI_F * sin_theta);
+		float pdf = map.pdf(dir);
+		if (!(pdf > 0.0f) || std::abs(pdf - expected) > 1e-3f * expected) {
+			throw Test::error("Sampled direction " + to_string(dir) + " has pdf " + std::to_string(pdf) + ", expected " + std::to_string(expected) + ".");
+		}
+	}
+
+	//the bright texel should be sampled far more often than its share of the sphere:
+	uint32_t bright = 0;
+	constexpr uint32_t N = 20000;
+	for (uint32_t n = 0; n < N; ++n) {
+		Vec2 uv = Shapes::Sphere::uv(map.sample(rng));
+		if (uint32_t(uv.x * map.w) == 7 && uint32_t(uv.y * map.h) == 4) bright += 1;
+	}
+	if (bright < N / 4) {
+		throw Test::error("Bright texel was only sampled " + std::to_string(bright) + " times in " + std::to_string(N) + ".");
+	}
+
+	//the pdf integrates to one over the sphere (estimated with uniform directions):
+	double sum = 0.0;
+	constexpr uint32_t M = 200000;
+	for (uint32_t n = 0; n < M; ++n) {
+		sum += map.pdf(random_dir(rng));
+	}
+	float integral = float(sum / M * 4.0 * PI_D);
+	if (std::abs(integral - 1.0f) > 0.03f) {
+		throw Test::error("Map pdf integrates to " + std::to_string(integral) + " over the sphere.");
+	}
+});
+
+Test test_a3_env_map_hemisphere_rows("a3.env_map.hemisphere_rows", []() {
+	//a hemisphere's horizon must fall between rows, whatever order the lights come in:
+	auto sky = std::make_shared<Texture>(Texture{Textures::Constant{Spectrum(1.0f, 2.0f, 3.0f)}});
+	Environment_Lights::Hemisphere hemisphere;
+	hemisphere.radiance = sky;
+	Environment_Light hemisphere_light{hemisphere};
+
+	//(an image light of odd height)
+	HDR_Image image(10, 7, Spectrum(0.5f));
+	auto texture = std::make_shared<Texture>(Texture{Textures::Image{Textures::Image::Sampler::nearest, image, Textures::Image::Storage::rows}});
+	Environment_Light image_light = sphere_light(texture);
+
+	PT::Environment_Map first(std::vector<Environment_Light const *>{&hemisphere_light, &image_light});
+	PT::Environment_Map last(std::vector<Environment_Light const *>{&image_light, &hemisphere_light});
+	for (PT::Environment_Map const *map : {&first, &last}) {
+		std::string order = (map == &first ? "hemisphere first" : "hemisphere last");
+		if (map->w != 10 || map->h != 8) {
+			throw Test::error("Map (" + order + ") is " + std::to_string(map->w) + "x" + std::to_string(map->h) + ", expected 10x8.");
+		}
+		//every texel is either entirely above or entirely below the horizon:
+		for (uint32_t y = 0; y < map->h; ++y) {
+			Spectrum expected = Spectrum(0.5f) + (y >= map->h / 2 ? Spectrum(1.0f, 2.0f, 3.0f) : Spectrum(0.0f));
+			for (uint32_t x = 0; x < map->w; ++x) {
+				Spectrum got = map->radiance.image.at(x, y);
+				if (Test::differs(got, expected)) {
+					throw Test::error("Texel (" + std::to_string(x) + ", " + std::to_string(y) + ") of map (" + order + ") is " + to_string(got) + ", expected " + to_string(expected) + ".");
+				}
+			}
+		}
+	}
+});
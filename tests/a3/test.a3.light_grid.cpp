@@ -0,0 +1,116 @@
+#include "test.h"
+#include "pathtracer/light_grid.h"
+#include "util/rand.h"
+
+using namespace PT;
+
+static Delta_Light spot_light(float inner_angle, float outer_angle) {
+	Delta_Lights::Spot spot;
+	spot.inner_angle = inner_angle;
+	spot.outer_angle = outer_angle;
+	return Delta_Light{spot};
+}
+
+static Vec3 random_point(RNG &rng, BBox const &box) {
+	return box.min + (box.max - box.min) * Vec3(rng.unit(), rng.unit(), rng.unit());
+}
+
+static BBox random_box(RNG &rng, BBox const &bounds, float max_size) {
+	Vec3 a = random_point(rng, bounds);
+	Vec3 size = Vec3(rng.unit(), rng.unit(), rng.unit()) * max_size;
+	return BBox(a, a + size);
+}
+
+//does any of a grid of points in box get light from light?
+static bool lit_somewhere(Light_Instance const &light, BBox const &box) {
+	constexpr uint32_t N = 6;
+	for (uint32_t z = 0; z <= N; ++z) {
+		for (uint32_t y = 0; y <= N; ++y) {
+			for (uint32_t x = 0; x <= N; ++x) {
+				Vec3 p = box.min + (box.max - box.min) * Vec3(float(x), float(y), float(z)) / float(N);
+				if (light.incoming(p).radiance.luma() > 0.0f) return true;
+			}
+		}
+	}
+	return false;
+}
+
+Test test_a3_light_grid_reaches("a3.light_grid.reaches", []() {
+	Delta_Light point{Delta_Lights::Point{}};
+	Delta_Light narrow = spot_light(10.0f, 20.0f);
+	Delta_Light wide = spot_light(200.0f, 300.0f);
+	std::vector< Light_Instance > lights{
+		Light_Instance(&point, Mat4::translate(Vec3(1.0f, 2.0f, 3.0f))),
+		Light_Instance(&narrow, Mat4::I),
+		Light_Instance(&narrow, Mat4::translate(Vec3(-2.0f, 1.0f, 0.5f)) * Mat4::euler(Vec3(30.0f, 0.0f, 100.0f))),
+		Light_Instance(&wide, Mat4::translate(Vec3(0.0f, -3.0f, 0.0f))),
+	};
+
+	//reaches() is conservative -- never false for a box with a lit point in it -- but does cull:
+	BBox scene(Vec3(-5.0f), Vec3(5.0f));
+	RNG rng(17);
+	std::vector< uint32_t > culled(lights.size(), 0);
+	for (uint32_t n = 0; n < 2000; ++n) {
+		BBox box = random_box(rng, scene, 2.0f);
+		for (uint32_t i = 0; i < lights.size(); ++i) {
+			if (lights[i].reaches(box)) continue;
+			culled[i] += 1;
+			if (lit_somewhere(lights[i], box)) {
+				throw Test::error("Light " + std::to_string(i) + " lights part of a box it does not reach, from " + to_string(box.min) + " to " + to_string(box.max) + ".");
+			}
+		}
+	}
+	if (culled[0] != 0 || culled[3] != 0) {
+		throw Test::error("Point light and spot light wider than a hemisphere should reach every box.");
+	}
+	if (culled[1] < 1000 || culled[2] < 1000) {
+		throw Test::error("Narrow spot lights only culled " + std::to_string(culled[1]) + " and " + std::to_string(culled[2]) + " of 2000 boxes.");
+	}
+	//(boxes around the light itself are always reached)
+	if (!lights[1].reaches(BBox(Vec3(-0.1f), Vec3(0.1f)))) {
+		throw Test::error("Spot light doesn't reach a box around itself.");
+	}
+});
+
+Test test_a3_light_grid_lights_at("a3.light_grid.lights_at", []() {
+	Delta_Light narrow = spot_light(10.0f, 20.0f);
+	Delta_Light point{Delta_Lights::Point{}};
+	std::vector< Light_Instance > lights;
+	RNG rng(19);
+	for (uint32_t i = 0; i < 8; ++i) {
+		Vec3 at = Vec3(rng.unit(), rng.unit(), rng.unit()) * 8.0f - Vec3(4.0f);
+		Vec3 angles = Vec3(rng.unit(), rng.unit(), rng.unit()) * 360.0f;
+		lights.emplace_back(&narrow, Mat4::translate(at) * Mat4::euler(angles));
+	}
+	lights.emplace_back(&point, Mat4::I);
+
+	BBox scene(Vec3(-4.0f, -3.0f, -2.0f), Vec3(4.0f, 3.0f, 2.0f));
+	Light_Grid grid(lights, scene);
+	if (grid.dim_x == 0) throw Test::error("Scene with spot lights didn't get a grid.");
+	if (grid.cell_lights.size() >= size_t(grid.dim_x) * grid.dim_y * grid.dim_z * lights.size()) {
+		throw Test::error("Grid didn't cull any lights from any cell.");
+	}
+
+	//every light that lights a point is listed at that point:
+	for (uint32_t n = 0; n < 20000; ++n) {
+		Vec3 p = random_point(rng, scene);
+		Light_Grid::Range listed = grid.lights_at(p);
+		for (uint32_t i = 0; i < lights.size(); ++i) {
+			if (lights[i].incoming(p).radiance.luma() == 0.0f) continue;
+			if (std::find(listed.begin(), listed.end(), i) == listed.end()) {
+				throw Test::error("Light " + std::to_string(i) + " lights " + to_string(p) + " but isn't listed there.");
+			}
+		}
+	}
+
+	//points outside the grid get every light:
+	if (grid.lights_at(Vec3(100.0f, 0.0f, 0.0f)).size() != lights.size()) {
+		throw Test::error("Point outside the grid doesn't get every light.");
+	}
+
+	//without spot lights there's no grid at all:
+	Light_Grid no_spots(std::vector< Light_Instance >{Light_Instance(&point, Mat4::I)}, scene);
+	if (no_spots.dim_x != 0 || no_spots.lights_at(Vec3(0.0f)).size() != 1) {
+		throw Test::error("Scene without spot lights got a grid.");
+	}
+});
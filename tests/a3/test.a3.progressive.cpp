@@ -0,0 +1,97 @@
+#include "test.h"
+#include "pathtracer/session.h"
+
+#include <cmath>
+
+using namespace PT;
+
+//run a schedule to the end, with every pass leaving the same image on the film, returning pass sizes:
+static std::vector< uint32_t > run_passes(Pass_Schedule &schedule, HDR_Image const &image) {
+	std::vector< uint32_t > passes;
+	while (!schedule.done()) {
+		uint32_t pass = schedule.next_pass();
+		if (pass == 0 || passes.size() > 64) throw Test::error("Schedule that isn't done asked for a pass of " + std::to_string(pass) + " samples.");
+		passes.emplace_back(pass);
+		schedule.finish_pass(image);
+	}
+	return passes;
+}
+
+static std::string passes_string(std::vector< uint32_t > const &passes) {
+	std::string str;
+	for (uint32_t p : passes) str += (str == "" ? "" : ", ") + std::to_string(p);
+	return "[" + str + "]";
+}
+
+Test test_a3_progressive_passes("a3.progressive.passes", []() {
+	//each pass doubles the samples so far, and the last takes whatever is left:
+	std::pair< uint32_t, std::vector< uint32_t > > expect[] = {
+		{0, {}},
+		{1, {1}},
+		{2, {1, 1}},
+		{16, {1, 1, 2, 4, 8}},
+		{100, {1, 1, 2, 4, 8, 16, 32, 36}},
+	};
+	//(with no threshold, noise doesn't stop the schedule -- even when the image never changes)
+	HDR_Image image(4, 3, Spectrum(0.5f));
+	for (auto const &[max_samples, passes] : expect) {
+		Pass_Schedule schedule(max_samples);
+		std::vector< uint32_t > got = run_passes(schedule, image);
+		if (got != passes) {
+			throw Test::error("Schedule for " + std::to_string(max_samples) + " samples took passes " + passes_string(got) + ", expected " + passes_string(passes) + ".");
+		}
+		if (schedule.samples != max_samples || schedule.next_pass() != 0) {
+			throw Test::error("Finished schedule for " + std::to_string(max_samples) + " samples took " + std::to_string(schedule.samples) + " and asks for " + std::to_string(schedule.next_pass()) + " more.");
+		}
+	}
+});
+
+Test test_a3_progressive_noise("a3.progressive.noise", []() {
+	//the first pass has nothing to compare against:
+	Pass_Schedule schedule(256, 0.05f);
+	HDR_Image image(8, 8, Spectrum(1.0f));
+	schedule.finish_pass(image);
+	if (schedule.noise != std::numeric_limits< float >::infinity() || schedule.done()) {
+		throw Test::error("Schedule estimated noise " + std::to_string(schedule.noise) + " after one pass.");
+	}
+
+	//changes above the threshold keep going:
+	HDR_Image brighter(8, 8, Spectrum(1.1f));
+	schedule.finish_pass(brighter);
+	//(relative change of each pixel: 0.1 / (1.05 + 0.01))
+	if (Test::differs(schedule.noise, 0.1f / 1.06f)) {
+		throw Test::error("Changing every pixel by 10% gave noise " + std::to_string(schedule.noise) + ", expected " + std::to_string(0.1f / 1.06f) + ".");
+	}
+	if (schedule.converged() || schedule.done()) throw Test::error("Schedule stopped with noise above the threshold.");
+
+	//...and changes below it stop before all samples are taken:
+	schedule.finish_pass(brighter);
+	if (schedule.noise != 0.0f || !schedule.converged() || !schedule.done()) {
+		throw Test::error("Schedule didn't stop after a pass that changed nothing (noise " + std::to_string(schedule.noise) + ").");
+	}
+	if (schedule.samples != 4) {
+		throw Test::error("Schedule stopped after " + std::to_string(schedule.samples) + " samples, expected 4.");
+	}
+});
+
+Test test_a3_progressive_relative_change("a3.progressive.relative_change", []() {
+	//RMS over pixels, relative to each pixel's brightness:
+	HDR_Image a(2, 1), b(2, 1);
+	a.at(0) = Spectrum(3.0f);
+	b.at(0) = Spectrum(3.0f);
+	a.at(1) = Spectrum(1.0f);
+	b.at(1) = Spectrum(1.0f, 1.0f, 0.0f); //(luma 1 - 0.0722)
+	float lb = 1.0f - 0.0722f;
+	float d = (1.0f - lb) / (0.5f * (1.0f + lb) + 1e-2f);
+	float expected = std::sqrt(d * d / 2.0f);
+	float got = Pass_Schedule::relative_change(a, b);
+	if (Test::differs(got, expected) || Test::differs(Pass_Schedule::relative_change(b, a), expected)) {
+		throw Test::error("Relative change is " + std::to_string(got) + ", expected " + std::to_string(expected) + ".");
+	}
+
+	//images of different sizes (e.g., the film was resized) can't be compared:
+	if (Pass_Schedule::relative_change(a, HDR_Image(1, 2)) != std::numeric_limits< float >::infinity()
+	    || Pass_Schedule::relative_change(HDR_Image(), HDR_Image()) != std::numeric_limits< float >::infinity()) {
+		throw Test::error("Images that can't be compared have a finite relative change.");
+	}
+});
@@ -0,0 +1,144 @@
+#include "test.h"
+#include "pathtracer/stats.h"
+
+#include <cmath>
+#include <thread>
+#include <tuple>
+
+using namespace PT;
+
+//count n of each kind of event on this thread:
+static void count_events(uint32_t n) {
+	for (uint32_t i = 0; i < n; ++i) {
+		Stats::camera_ray();
+		Stats::traced_ray();
+		Stats::traced_ray();
+		Stats::shadow_ray();
+		Stats::visit_node();
+		Stats::primitive_test();
+		Stats::path_vertex();
+	}
+}
+
+Test test_a3_stats_counters("a3.stats.counters", []() {
+	if constexpr (!COLLECT_STATS) throw Test::ignored("Render statistics are compiled out.");
+
+	//each thread counts into its own stats (and nowhere, when it has none):
+	Render_Stats a, b;
+	count_events(3);
+	Stats::local = &a;
+	count_events(5);
+	bool started_with_stats = false;
+	std::thread other([&]() {
+		started_with_stats = (Stats::local != nullptr);
+		count_events(2);
+		Stats::local = &b;
+		count_events(7);
+		Stats::local = nullptr;
+	});
+	other.join();
+	Stats::local = nullptr;
+	count_events(11);
+	if (started_with_stats) throw Test::error("New thread started with stats to count into.");
+
+	for (auto [stats, n, name] : {std::make_tuple(&a, 5ull, "this thread"), std::make_tuple(&b, 7ull, "the other thread")}) {
+		if (stats->camera_rays != n || stats->traced_rays != 2 * n || stats->shadow_rays != n || stats->bvh_nodes != n
+		    || stats->primitive_tests != n || stats->path_vertices != n) {
+			throw Test::error(std::string("Stats of ") + name + " counted " + std::to_string(stats->camera_rays) + " camera rays, "
+			                  + std::to_string(stats->traced_rays) + " traced rays, " + std::to_string(stats->shadow_rays) + " shadow rays, "
+			                  + std::to_string(stats->bvh_nodes) + " nodes, " + std::to_string(stats->primitive_tests) + " tests, and "
+			                  + std::to_string(stats->path_vertices) + " vertices, expected " + std::to_string(n) + " of each (twice as many traced rays).");
+		}
+	}
+	if (a.indirect_rays() != 5 || a.average_path_length() != 1.0) {
+		throw Test::error("Stats have " + std::to_string(a.indirect_rays()) + " indirect rays and average path length " + std::to_string(a.average_path_length()) + ", expected 5 and 1.");
+	}
+});
+
+Test test_a3_stats_merge("a3.stats.merge", []() {
+	//tiles land in power-of-two buckets of microseconds:
+	Render_Stats a;
+	a.camera_rays = 10;
+	a.traced_rays = 25;
+	a.path_vertices = 30;
+	a.plan.tiles = 4;
+	a.add_tile(0.5e-6); //(under a microsecond counts as one)
+	a.add_tile(3e-6);
+	a.add_tile(1e-3);
+
+	//(on another thread, so busy times are kept per thread)
+	Render_Stats b;
+	std::thread other([&]() {
+		b.camera_rays = 6;
+		b.traced_rays = 9;
+		b.shadow_rays = 4;
+		b.path_vertices = 2;
+		b.plan.tiles = 100;
+		b.add_tile(2.5e-6);
+		b.add_tile(1e9); //(past the last bucket goes in the last bucket)
+	});
+	other.join();
+
+	a += b;
+	if (a.camera_rays != 16 || a.traced_rays != 34 || a.shadow_rays != 4 || a.path_vertices != 32 || a.tiles != 5) {
+		throw Test::error("Merged stats have " + std::to_string(a.camera_rays) + " camera rays, " + std::to_string(a.traced_rays) + " traced rays, "
+		                  + std::to_string(a.shadow_rays) + " shadow rays, " + std::to_string(a.path_vertices) + " vertices, and "
+		                  + std::to_string(a.tiles) + " tiles, expected 16, 34, 4, 32, and 5.");
+	}
+	if (a.plan.tiles != 4) throw Test::error("Merging stats changed the tile plan.");
+
+	std::array< uint32_t, 32 > expected{};
+	expected[0] = 1;
+	expected[1] = 2;
+	expected[9] = 1;
+	expected[31] = 1;
+	for (uint32_t i = 0; i < expected.size(); ++i) {
+		if (a.tile_histogram[i] != expected[i]) {
+			throw Test::error("Merged tile histogram has " + std::to_string(a.tile_histogram[i]) + " tiles in bucket " + std::to_string(i) + ", expected " + std::to_string(expected[i]) + ".");
+		}
+	}
+
+	if (a.thread_busy.size() != 2) {
+		throw Test::error("Merged stats have busy times for " + std::to_string(a.thread_busy.size()) + " threads, expected 2.");
+	}
+	if (a.thread_busy[std::this_thread::get_id()] != 0.5e-6 + 3e-6 + 1e-3) {
+		throw Test::error("This thread was busy for " + std::to_string(a.thread_busy[std::this_thread::get_id()]) + "s, expected 0.0010035s.");
+	}
+	a.seconds = 1e9;
+	if (std::abs(a.utilization() - (1e9 + 2.5e-6 + 0.5e-6 + 3e-6 + 1e-3) / 2e9) > 1e-9) {
+		throw Test::error("Merged stats have utilization " + std::to_string(a.utilization()) + ", expected about 0.5.");
+	}
+});
+
+Test test_a3_stats_json("a3.stats.json", []() {
+	Render_Stats stats;
+	stats.seconds = 2.5;
+	stats.camera_rays = 8;
+	stats.traced_rays = 20;
+	stats.shadow_rays = 3;
+	stats.bvh_nodes = 40;
+	stats.primitive_tests = 50;
+	stats.path_vertices = 16;
+	stats.plan.tiles = 7;
+	stats.plan.tile_width = 32;
+	stats.plan.tile_height = 16;
+	stats.plan.tile_samples = 64;
+	stats.plan.split_tiles = 2;
+	stats.plan.threads = 4;
+	stats.add_tile(3e-6);
+
+	std::string json = stats.to_json();
+	for (std::string expect : {
+		"\"seconds\": 2.5,", "\"camera_rays\": 8,", "\"indirect_rays\": 12,", "\"shadow_rays\": 3,", "\"bvh_nodes\": 40,",
+		"\"primitive_tests\": 50,", "\"average_path_length\": 2,", "\"tiles\": 1,",
+		"\"tile_plan\": {\"tiles\": 7, \"tile_width\": 32, \"tile_height\": 16, \"tile_samples\": 64, \"split_tiles\": 2, \"threads\": 4},",
+		"\"tile_histogram_us\": [0, 1, 0,", "\"utilization\": ", "\"thread_busy_seconds\": [3e-06]",
+	}) {
+		if (json.find(expect) == std::string::npos) {
+			throw Test::error("Statistics JSON doesn't contain '" + expect + "':\n" + json);
+		}
+	}
+	if (json.front() != '{' || json.find_last_of('}') == std::string::npos) {
+		throw Test::error("Statistics JSON isn't an object:\n" + json);
+	}
+});
@@ -0,0 +1,105 @@
+#include "test.h"
+#include "geometry/indexed.h"
+#include "lib/ray.h"
+#include "pathtracer/instance.h"
+#include "pathtracer/tri_mesh.h"
+#include "scene/texture.h"
+
+//a 2x2 square in the z = 0 plane, with uvs covering [0,1]^2 (so half a uv unit per unit of distance):
+static PT::Tri_Mesh square_mesh() {
+	std::vector<Indexed_Mesh::Vert> verts{
+		Indexed_Mesh::Vert{Vec3{-1.0f, -1.0f, 0.0f}, Vec3{0, 0, 1}, Vec2{0.0f, 0.0f}, 0},
+		Indexed_Mesh::Vert{Vec3{ 1.0f, -1.0f, 0.0f}, Vec3{0, 0, 1}, Vec2{1.0f, 0.0f}, 1},
+		Indexed_Mesh::Vert{Vec3{ 1.0f,  1.0f, 0.0f}, Vec3{0, 0, 1}, Vec2{1.0f, 1.0f}, 2},
+		Indexed_Mesh::Vert{Vec3{-1.0f,  1.0f, 0.0f}, Vec3{0, 0, 1}, Vec2{0.0f, 1.0f}, 3},
+	};
+	std::vector<Indexed_Mesh::Index> inds{0, 1, 2, 0, 2, 3};
+	return PT::Tri_Mesh(Indexed_Mesh(std::move(verts), std::move(inds)), false);
+}
+
+Test test_a3_texture_lod_image("a3.texture_lod.image", []() {
+	//(the larger dimension sets the texel size)
+	Textures::Image image(Textures::Image::Sampler::trilinear, HDR_Image(64, 32, Spectrum(0.5f)));
+	float w = 64.0f;
+	std::pair< float, float > expect[] = {
+		{0.0f, 0.0f},     //no footprint => base level
+		{0.5f / w, 0.0f}, //less than a texel => clamped to the base level
+		{1.0f / w, 0.0f}, //one texel
+		{4.0f / w, 2.0f}, //four texels => two levels down
+		{64.0f / w, 6.0f},
+	};
+	for (auto [footprint, level] : expect) {
+		float got = image.lod(footprint);
+		if (Test::differs(got, level)) {
+			throw Test::error("Footprint of " + std::to_string(footprint * w) + " texels gave level " + std::to_string(got) + ", expected " + std::to_string(level) + ".");
+		}
+	}
+	if (image.lod(std::numeric_limits< float >::quiet_NaN()) != 0.0f) {
+		throw Test::error("NaN footprint didn't give the base level.");
+	}
+});
+
+Test test_a3_texture_lod_ray_cone("a3.texture_lod.ray_cone", []() {
+	Ray ray(Vec3{1.0f, 2.0f, 3.0f}, Vec3{0.0f, 0.0f, -1.0f});
+	ray.cone_width = 0.1f;
+	ray.cone_spread = 0.01f;
+
+	//a uniform scale scales the width (a length), but not the spread (an angle):
+	Ray scaled = ray;
+	scaled.transform(Mat4::translate(Vec3{4.0f, 5.0f, 6.0f}) * Mat4::scale(Vec3{3.0f}));
+	if (Test::differs(scaled.cone_width, 0.3f) || Test::differs(scaled.cone_spread, 0.01f)) {
+		throw Test::error("Scaling by 3 gave a cone of width " + std::to_string(scaled.cone_width) + " and spread " + std::to_string(scaled.cone_spread) + ", expected 0.3 and 0.01.");
+	}
+
+	//...and transforming back undoes it:
+	scaled.transform((Mat4::translate(Vec3{4.0f, 5.0f, 6.0f}) * Mat4::scale(Vec3{3.0f})).inverse());
+	if (Test::differs(scaled.cone_width, ray.cone_width)) {
+		throw Test::error("Scaling by 3 and back gave a cone of width " + std::to_string(scaled.cone_width) + ".");
+	}
+
+	//rigid transforms leave the cone alone:
+	Ray rotated = ray;
+	rotated.transform(Mat4::translate(Vec3{-2.0f, 0.0f, 1.0f}) * Mat4::angle_axis(37.0f, Vec3{1.0f, 1.0f, 0.0f}.unit()));
+	if (Test::differs(rotated.cone_width, ray.cone_width) || Test::differs(rotated.cone_spread, ray.cone_spread)) {
+		throw Test::error("A rigid transform changed the cone to width " + std::to_string(rotated.cone_width) + " and spread " + std::to_string(rotated.cone_spread) + ".");
+	}
+});
+
+Test test_a3_texture_lod_uv_scale("a3.texture_lod.uv_scale", []() {
+	PT::Tri_Mesh mesh = square_mesh();
+	if (Test::differs(mesh.uv_scale(), 0.5f)) {
+		throw Test::error("Square mesh has uv scale " + std::to_string(mesh.uv_scale()) + ", expected 0.5.");
+	}
+
+	//instances divide by their (average) scale:
+	std::pair< Mat4, float > expect[] = {
+		{Mat4::I, 0.5f},
+		{Mat4::scale(Vec3{4.0f}), 0.125f},
+		{Mat4::translate(Vec3{1.0f, 2.0f, 3.0f}) * Mat4::angle_axis(60.0f, Vec3{0.0f, 1.0f, 0.0f}), 0.5f},
+		{Mat4::scale(Vec3{1.0f, 8.0f, 1.0f}), 0.25f}, //(cube root of the volume scale)
+	};
+	for (auto const &[T, uv_scale] : expect) {
+		PT::Instance instance(&mesh, nullptr, T);
+		if (Test::differs(instance.uv_scale(), uv_scale)) {
+			throw Test::error("Instance of square mesh has uv scale " + std::to_string(instance.uv_scale()) + ", expected " + std::to_string(uv_scale) + ".");
+		}
+	}
+});
+
+Test test_a3_texture_lod_uv_scale_hit("a3.texture_lod.uv_scale.hit", []() {
+	PT::Tri_Mesh mesh = square_mesh();
+	PT::Instance instance(&mesh, nullptr, Mat4::scale(Vec3{2.0f}));
+
+	Ray ray(Vec3{0.5f, 0.5f, 5.0f}, Vec3{0.0f, 0.0f, -1.0f});
+	PT::Trace trace = instance.hit(ray);
+	if (!trace.hit) {
+		//(needs triangle intersection, A3T2)
+		throw Test::ignored("Ray didn't hit the square, so the traced uv scale can't be checked.");
+	}
+	if (Test::differs(trace.uv_scale, 0.25f)) {
+		throw Test::error("Hit on square scaled by 2 has uv scale " + std::to_string(trace.uv_scale) + ", expected 0.25.");
+	}
+	if (Test::differs(trace.distance, 5.0f)) {
+		throw Test::error("Hit on square scaled by 2 is at distance " + std::to_string(trace.distance) + ", expected 5.");
+	}
+});
@@ -0,0 +1,142 @@
+#include "test.h"
+#include "pathtracer/pathtracer.h"
+
+using namespace PT;
+
+//interleave bits of x and y (x in the low bit):
+static uint64_t morton(uint32_t x, uint32_t y) {
+	uint64_t ret = 0;
+	for (uint32_t b = 0; b < 32; ++b) {
+		ret |= uint64_t((x >> b) & 1) << (2 * b);
+		ret |= uint64_t((y >> b) & 1) << (2 * b + 1);
+	}
+	return ret;
+}
+
+//plan and make tiles for the rect, and check that every pixel gets every sample exactly once:
+static std::vector< Pathtracer::Tile > check_tiles(Camera::Film_Rect rect, uint32_t samples, uint32_t threads, Pathtracer::Tile_Plan *plan_) {
+	Pathtracer::Tile_Plan plan = Pathtracer::plan_tiles(rect.width(), rect.height(), samples, threads);
+	std::string desc = std::to_string(rect.width()) + "x" + std::to_string(rect.height()) + "x" + std::to_string(samples)
+	                 + " on " + std::to_string(threads) + " threads";
+
+	if (plan.threads != threads) throw Test::error("Plan for " + desc + " is for " + std::to_string(plan.threads) + " threads.");
+	if (plan.tile_width == 0 || plan.tile_width > rect.width() || plan.tile_height == 0 || plan.tile_height > rect.height()) {
+		throw Test::error("Plan for " + desc + " has " + std::to_string(plan.tile_width) + "x" + std::to_string(plan.tile_height) + " tiles.");
+	}
+	if ((plan.tile_width % 8 != 0 && plan.tile_width != rect.width()) || (plan.tile_height % 8 != 0 && plan.tile_height != rect.height())) {
+		throw Test::error("Plan for " + desc + " has tiles that aren't a multiple of 8 pixels on a side.");
+	}
+	if (plan.tile_samples == 0 || plan.tile_samples > std::max(samples, 1u)) {
+		throw Test::error("Plan for " + desc + " has " + std::to_string(plan.tile_samples) + " samples per tile.");
+	}
+
+	std::vector< Pathtracer::Tile > tiles = Pathtracer::make_tiles(plan, rect, samples);
+	if (plan.tiles != tiles.size()) {
+		throw Test::error("Plan for " + desc + " says " + std::to_string(plan.tiles) + " tiles, but made " + std::to_string(tiles.size()) + ".");
+	}
+
+	std::vector< uint32_t > counts(size_t(rect.width()) * rect.height() * samples, 0);
+	uint32_t small = 0;
+	for (auto const &t : tiles) {
+		if (t.x_begin < rect.x_begin || t.x_end > rect.x_end || t.y_begin < rect.y_begin || t.y_end > rect.y_end || t.s_end > samples
+		 || t.x_begin >= t.x_end || t.y_begin >= t.y_end || t.s_begin >= t.s_end) {
+			throw Test::error("Tile for " + desc + " is empty or outside the rect.");
+		}
+		if (t.x_end - t.x_begin > plan.tile_width || t.y_end - t.y_begin > plan.tile_height || t.s_end - t.s_begin > plan.tile_samples) {
+			throw Test::error("Tile for " + desc + " is larger than planned.");
+		}
+		if (t.x_end - t.x_begin <= plan.tile_width / 2 && t.y_end - t.y_begin <= plan.tile_height / 2
+		 && t.x_end < rect.x_end && t.y_end < rect.y_end) {
+			small += 1;
+		}
+		for (uint32_t y = t.y_begin; y < t.y_end; ++y) {
+			for (uint32_t x = t.x_begin; x < t.x_end; ++x) {
+				for (uint32_t s = t.s_begin; s < t.s_end; ++s) {
+					counts[((y - rect.y_begin) * size_t(rect.width()) + (x - rect.x_begin)) * samples + s] += 1;
+				}
+			}
+		}
+	}
+	for (uint32_t c : counts) {
+		if (c != 1) throw Test::error("Tiles for " + desc + " trace a sample " + std::to_string(c) + " times.");
+	}
+	if (small > plan.split_tiles) {
+		throw Test::error("Tiles for " + desc + " include " + std::to_string(small) + " quarter tiles, but only " + std::to_string(plan.split_tiles) + " were split.");
+	}
+
+	if (plan_) *plan_ = plan;
+	return tiles;
+}
+
+Test test_a3_tiles_plan("a3.tiles.plan", []() {
+	for (uint32_t threads : {1u, 4u, 16u}) {
+		check_tiles(Camera::Film_Rect{0, 320, 0, 240}, 16, threads, nullptr);
+		check_tiles(Camera::Film_Rect{0, 7, 0, 5}, 3, threads, nullptr);
+		check_tiles(Camera::Film_Rect{0, 1, 0, 1}, 1, threads, nullptr);
+		check_tiles(Camera::Film_Rect{0, 100, 0, 30}, 300, threads, nullptr);
+		//(crop windows)
+		check_tiles(Camera::Film_Rect{13, 90, 40, 41}, 5, threads, nullptr);
+		check_tiles(Camera::Film_Rect{100, 357, 3, 200}, 2, threads, nullptr);
+	}
+
+	//more threads means more, smaller, tiles:
+	Pathtracer::Tile_Plan few, many;
+	check_tiles(Camera::Film_Rect{0, 640, 0, 480}, 4, 1, &few);
+	check_tiles(Camera::Film_Rect{0, 640, 0, 480}, 4, 32, &many);
+	if (many.tiles <= few.tiles || many.tile_width * many.tile_height > few.tile_width * few.tile_height) {
+		throw Test::error("Planning for 32 threads made " + std::to_string(many.tiles) + " tiles, vs " + std::to_string(few.tiles) + " for one thread.");
+	}
+
+	//small images split samples to make enough tiles:
+	Pathtracer::Tile_Plan small;
+	check_tiles(Camera::Film_Rect{0, 16, 0, 16}, 64, 8, &small);
+	if (small.tile_samples >= 64) {
+		throw Test::error("Planning a 16x16 image for 8 threads didn't split its samples.");
+	}
+
+	//the plan is reported in render statistics:
+	Render_Stats stats;
+	stats.plan = small;
+	std::string json = stats.to_json();
+	std::string expected = "\"tile_plan\": {\"tiles\": " + std::to_string(small.tiles) + ", \"tile_width\": 16, \"tile_height\": 16";
+	if (json.find(expected) == std::string::npos) {
+		throw Test::error("Statistics JSON doesn't include the tile plan:\n" + json);
+	}
+});
+
+Test test_a3_tiles_morton("a3.tiles.morton", []() {
+	//(three threads, so the image gets 16x16 tiles and the last six tiles are split)
+	Camera::Film_Rect rect{8, 8 + 16 * 8, 24, 24 + 16 * 5};
+	Pathtracer::Tile_Plan plan;
+	std::vector< Pathtracer::Tile > tiles = check_tiles(rect, 2, 3, &plan);
+	if (plan.tile_width != 16 || plan.tile_height != 16 || plan.tile_samples != 1) {
+		throw Test::error("Expected 16x16x1 tiles, got " + std::to_string(plan.tile_width) + "x" + std::to_string(plan.tile_height) + "x" + std::to_string(plan.tile_samples) + ".");
+	}
+
+	//each sample slice visits the 8x5 grid of tiles along a Morton curve:
+	constexpr uint32_t grid = 8 * 5;
+	for (uint32_t i = 0; i + 1 < grid; ++i) {
+		Pathtracer::Tile const &a = tiles[i];
+		Pathtracer::Tile const &b = tiles[i + 1];
+		if (a.s_begin != 0 || b.s_begin != 0) throw Test::error("Second sample slice started before the first finished.");
+		uint64_t ma = morton((a.x_begin - rect.x_begin) / 16, (a.y_begin - rect.y_begin) / 16);
+		uint64_t mb = morton((b.x_begin - rect.x_begin) / 16, (b.y_begin - rect.y_begin) / 16);
+		if (ma >= mb) {
+			throw Test::error("Tile " + std::to_string(i + 1) + " at (" + std::to_string(b.x_begin) + ", " + std::to_string(b.y_begin)
+			                  + ") is not after tile " + std::to_string(i) + " on the Morton curve.");
+		}
+	}
+	//(first four tiles are the top-left 2x2 block, in Z order)
+	uint32_t z[4][2] = {{0, 0}, {16, 0}, {0, 16}, {16, 16}};
+	for (uint32_t i = 0; i < 4; ++i) {
+		if (tiles[i].x_begin != rect.x_begin + z[i][0] || tiles[i].y_begin != rect.y_begin + z[i][1]) {
+			throw Test::error("Tile " + std::to_string(i) + " is at (" + std::to_string(tiles[i].x_begin) + ", " + std::to_string(tiles[i].y_begin) + ").");
+		}
+	}
+	if (tiles[grid].s_begin != 1 || tiles[grid].x_begin != rect.x_begin || tiles[grid].y_begin != rect.y_begin) {
+		throw Test::error("Second sample slice doesn't start back at the first tile.");
+	}
+	if (plan.split_tiles != 24 || plan.tiles != 2 * grid - 6 + 24) {
+		throw Test::error("Expected the last six tiles to be split into quarters; got " + std::to_string(plan.split_tiles) + " split of " + std::to_string(plan.tiles) + ".");
+	}
+});